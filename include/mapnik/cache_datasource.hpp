@@ -0,0 +1,95 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_CACHE_DATASOURCE_HPP
+#define MAPNIK_CACHE_DATASOURCE_HPP
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/query.hpp>
+
+// stl
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
+
+namespace mapnik {
+
+// Wraps another datasource and keeps the features of recent queries in
+// memory. A query lying within the bbox of a cached one, with the same
+// property names, variables, filters, scale denominator and resolution, is
+// answered from the cache without asking the wrapped datasource again,
+// which suits neighbouring tiles and metatile seeding. The least recently
+// used results are dropped once their estimated size exceeds max_size
+// bytes. Raster datasources are passed through.
+class MAPNIK_DECL cache_datasource : public datasource
+{
+public:
+    explicit cache_datasource(datasource_ptr const& ds,
+                              std::size_t max_size = 64 * 1024 * 1024);
+    static const char * name();
+    virtual ~cache_datasource();
+    virtual datasource::datasource_t type() const;
+    virtual featureset_ptr features(query const& q) const;
+    virtual featureset_ptr features_at_point(coord2d const& pt, double tol = 0) const;
+    virtual box2d<double> envelope() const;
+    virtual boost::optional<datasource_geometry_t> get_geometry_type() const;
+    virtual layer_descriptor get_descriptor() const;
+    //
+    datasource_ptr const& wrapped() const;
+    // estimated size of the cached features in bytes
+    std::size_t size() const;
+    void clear();
+private:
+    struct key_type
+    {
+        double scale_denominator;
+        query::resolution_type resolution;
+        std::set<std::string> names;
+        attributes vars;
+        std::vector<std::string> filters;
+        bool operator==(key_type const& rhs) const;
+    };
+    struct entry;
+    using entry_ptr = std::shared_ptr<entry const>;
+
+    static key_type make_key(query const& q);
+
+    datasource_ptr ds_;
+    std::size_t max_size_;
+    // most recently used first
+    mutable std::list<entry_ptr> entries_;
+    mutable std::size_t size_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex mutex_;
+#endif
+};
+
+}
+
+#endif // MAPNIK_CACHE_DATASOURCE_HPP
@@ -0,0 +1,153 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_EXPRESSION_PROGRAM_HPP
+#define MAPNIK_EXPRESSION_PROGRAM_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/feature.hpp>
+
+// stl
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mapnik {
+
+struct regex_match_node;
+struct regex_replace_node;
+struct unary_function_call;
+struct binary_function_call;
+
+namespace detail {
+
+enum class expr_opcode : std::uint8_t
+{
+    push_const,         // a: constant
+    push_attr,          // a: attribute name
+    push_global,        // a: global attribute name
+    push_geometry_type,
+    negate,
+    logical_not,
+    to_bool,
+    plus,
+    minus,
+    mult,
+    div,
+    mod,
+    compare,            // cmp: comparison, both operands on the stack
+    compare_attr_const, // cmp: comparison, a: attribute name, b: constant, reversed: constant on the left
+    jump_if_false,      // a: target, pushes false when jumping
+    jump_if_true,       // a: target, pushes true when jumping
+    regex_match,        // a: node
+    regex_replace,      // a: node
+    unary_call,         // a: node
+    binary_call,        // a: node
+    evaluate_tree       // a: node, evaluated by the recursive evaluator
+};
+
+enum class expr_comparison : std::uint8_t
+{
+    less,
+    less_equal,
+    greater,
+    greater_equal,
+    equal_to,
+    not_equal_to
+};
+
+struct expr_instruction
+{
+    expr_opcode op;
+    expr_comparison cmp;
+    bool reversed;
+    std::uint32_t a;
+    std::uint32_t b;
+};
+
+struct expression_compiler;
+
+}
+
+// Flat stack machine code for an expression, compiled once from the
+// expr_node tree and evaluated per feature without walking the tree.
+// Comparisons between an attribute and a literal are fused into a single
+// instruction with typed fast paths for integers, doubles and strings.
+// Results are identical to the evaluate<> visitor, which is still used for
+// expressions too deep for the fixed size evaluation stack.
+class MAPNIK_DECL expression_program
+{
+public:
+    static constexpr std::size_t max_stack_size = 32;
+
+    // Attribute slots of a program resolved against one feature context.
+    // Owned by the caller and reused across the features of a featureset,
+    // it is rebound when a feature with another context shows up or when
+    // the context grew since it was bound.
+    struct binding
+    {
+        context_ptr ctx;
+        std::size_t ctx_size = 0;
+        std::vector<std::size_t> slots;
+    };
+
+    expression_program();
+    explicit expression_program(expression_ptr const& expr);
+
+    value evaluate(feature_impl const& feature, attributes const& vars) const;
+    bool to_bool(feature_impl const& feature, attributes const& vars) const;
+    // Same as above, reading attributes by slot index instead of by name
+    value evaluate(feature_impl const& feature, attributes const& vars, binding & slots) const;
+    bool to_bool(feature_impl const& feature, attributes const& vars, binding & slots) const;
+
+    expression_ptr const& expression() const { return expr_; }
+    std::vector<detail::expr_instruction> const& code() const { return code_; }
+    // true when the expression is evaluated by the tree evaluator
+    bool fallback() const { return !tree_nodes_.empty(); }
+
+private:
+    friend struct detail::expression_compiler;
+    template <typename Attributes>
+    bool to_bool_impl(feature_impl const& feature, attributes const& vars, Attributes const& attrs) const;
+    template <typename Stack, typename Attributes>
+    void run(Stack & stack, feature_impl const& feature, attributes const& vars, Attributes const& attrs) const;
+    void bind(binding & slots, feature_impl const& feature) const;
+
+    expression_ptr expr_;
+    std::vector<detail::expr_instruction> code_;
+    std::vector<value> constants_;
+    std::vector<std::string> attributes_;
+    std::vector<std::string> globals_;
+    std::vector<regex_match_node const*> regex_match_nodes_;
+    std::vector<regex_replace_node const*> regex_replace_nodes_;
+    std::vector<unary_function_call const*> unary_calls_;
+    std::vector<binary_function_call const*> binary_calls_;
+    std::vector<expr_node const*> tree_nodes_;
+};
+
+}
+
+#endif // MAPNIK_EXPRESSION_PROGRAM_HPP
@@ -0,0 +1,55 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_EXPRESSION_SQL_HPP
+#define MAPNIK_EXPRESSION_SQL_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <string>
+
+namespace mapnik
+{
+
+class query;
+class layer_descriptor;
+
+// How string literals are written: standard SQL ones take backslashes
+// as they are, PostgreSQL escape strings (E'...') whatever the server's
+// standard_conforming_strings is.
+enum class sql_dialect { standard, postgresql };
+
+// Translates the filters of a query into an SQL condition for a WHERE
+// clause. The condition holds for every feature matching a filter but may
+// also hold for others, filters are still evaluated when rendering.
+// Comparisons of a column from the descriptor with a literal or a query
+// variable are translated, anything else makes the condition weaker or,
+// where that isn't possible, the translation fail and return false.
+MAPNIK_DECL bool to_sql_condition(query const& q,
+                                  layer_descriptor const& desc,
+                                  std::string & sql,
+                                  sql_dialect dialect = sql_dialect::standard);
+}
+
+#endif // MAPNIK_EXPRESSION_SQL_HPP
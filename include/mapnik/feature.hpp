@@ -33,6 +33,7 @@
 //
 #include <mapnik/feature_kv_iterator.hpp>
 #include <mapnik/util/noncopyable.hpp>
+#include <mapnik/feature_arena.hpp>
 
 // stl
 #include <memory>
@@ -80,6 +81,7 @@ public:
     }
 
     inline size_type size() const { return mapping_.size(); }
+    inline const_iterator find(key_type const& name) const { return mapping_.find(name); }
     inline const_iterator begin() const { return mapping_.begin();}
     inline const_iterator end() const { return mapping_.end();}
 
@@ -108,8 +110,20 @@ public:
         geom_(geometry::geometry_empty()),
         raster_() {}
 
+    // attribute values allocated from arena, which must outlive the feature
+    feature_impl(context_ptr const& ctx, mapnik::value_integer id, feature_arena * arena)
+        : id_(id),
+        ctx_(ctx),
+        data_(ctx_->mapping_.size(), value_type(), arena_allocator<value_type>(arena)),
+        geom_(geometry::geometry_empty()),
+        raster_() {}
+
     inline mapnik::value_integer id() const { return id_;}
 
+    // true if the attribute values live in an arena, which the feature
+    // keeps alive
+    inline bool in_arena() const { return data_.get_allocator().arena() != nullptr; }
+
     inline void set_id(mapnik::value_integer id) { id_ = id;}
 
     template <typename T>
@@ -148,7 +162,7 @@ public:
         }
         else
         {
-            cont_type::size_type index = ctx_->push(key);
+            storage_type::size_type index = ctx_->push(key);
             if (index == data_.size())
                 data_.push_back(std::move(val));
         }
@@ -180,14 +194,23 @@ public:
         return data_.size();
     }
 
-    inline cont_type const& get_data() const
+    // copy of the attribute values; the feature itself may keep
+    // them in an arena
+    inline cont_type get_data() const
     {
-        return data_;
+        return cont_type(data_.begin(), data_.end());
     }
 
     inline void set_data(cont_type const& data)
     {
-        data_ = data;
+        data_.assign(data.begin(), data.end());
+    }
+
+    // copies the attribute values into another feature without the
+    // intermediate vector get_data() would hand out
+    inline void copy_data_to(feature_impl & other) const
+    {
+        other.data_.assign(data_.begin(), data_.end());
     }
 
     inline context_ptr context() const
@@ -195,6 +218,11 @@ public:
         return ctx_;
     }
 
+    inline context_type const& get_context() const
+    {
+        return *ctx_;
+    }
+
     inline void set_geometry(geometry::geometry<double> && geom)
     {
         geom_ = std::move(geom);
@@ -259,9 +287,12 @@ public:
     }
 
 private:
+    // attribute values live in the featureset's arena when it has one
+    using storage_type = std::vector<value_type, arena_allocator<value_type> >;
+
     mapnik::value_integer id_;
     context_ptr ctx_;
-    cont_type data_;
+    storage_type data_;
     geometry::geometry<double> geom_;
     raster_ptr raster_;
 };
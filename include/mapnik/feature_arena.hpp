@@ -0,0 +1,167 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_FEATURE_ARENA_HPP
+#define MAPNIK_FEATURE_ARENA_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace mapnik {
+
+// Bump allocator for the features of one featureset. Memory comes from
+// large blocks, each counting the allocations still alive in it; a block
+// is released as soon as it is no longer being filled and its last
+// allocation is gone, so long scans don't accumulate memory.
+// Allocation is not thread safe and belongs to the thread filling the
+// features, deallocation may happen on any thread.
+class MAPNIK_DECL feature_arena : private util::noncopyable
+{
+public:
+    explicit feature_arena(std::size_t block_size = 64 * 1024);
+    ~feature_arena();
+
+    void * allocate(std::size_t size, std::size_t alignment);
+    static void deallocate(void * ptr);
+
+    // blocks allocated over the arena's lifetime
+    std::size_t blocks_allocated() const { return blocks_allocated_; }
+
+private:
+    struct block;
+    block * new_block(std::size_t size);
+    static void release(block * b);
+
+    std::size_t block_size_;
+    block * current_;
+    std::size_t blocks_allocated_;
+};
+
+using feature_arena_ptr = std::shared_ptr<feature_arena>;
+
+// Allocates from an arena, or from the heap when it has none. Copies of
+// a container go to the heap so they can outlive the arena.
+template <typename T>
+class arena_allocator
+{
+public:
+    using value_type = T;
+
+    arena_allocator() noexcept
+        : arena_(nullptr) {}
+
+    explicit arena_allocator(feature_arena * arena) noexcept
+        : arena_(arena) {}
+
+    template <typename U>
+    arena_allocator(arena_allocator<U> const& other) noexcept
+        : arena_(other.arena()) {}
+
+    T * allocate(std::size_t n)
+    {
+        if (!arena_) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T * ptr, std::size_t) noexcept
+    {
+        if (!arena_) ::operator delete(ptr);
+        else feature_arena::deallocate(ptr);
+    }
+
+    arena_allocator select_on_container_copy_construction() const
+    {
+        return arena_allocator();
+    }
+
+    feature_arena * arena() const noexcept { return arena_; }
+
+private:
+    feature_arena * arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(arena_allocator<T> const& lhs, arena_allocator<U> const& rhs)
+{
+    return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(arena_allocator<T> const& lhs, arena_allocator<U> const& rhs)
+{
+    return lhs.arena() != rhs.arena();
+}
+
+// Allocator for std::allocate_shared keeping the arena alive for as long
+// as the object, so that everything the object allocated from the arena
+// may still be freed into it.
+template <typename T>
+class arena_owner_allocator
+{
+public:
+    using value_type = T;
+
+    explicit arena_owner_allocator(feature_arena_ptr const& arena) noexcept
+        : arena_(arena) {}
+
+    template <typename U>
+    arena_owner_allocator(arena_owner_allocator<U> const& other) noexcept
+        : arena_(other.arena()) {}
+
+    T * allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T * ptr, std::size_t) noexcept
+    {
+        feature_arena::deallocate(ptr);
+    }
+
+    feature_arena_ptr const& arena() const noexcept { return arena_; }
+
+private:
+    feature_arena_ptr arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(arena_owner_allocator<T> const& lhs, arena_owner_allocator<U> const& rhs)
+{
+    return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(arena_owner_allocator<T> const& lhs, arena_owner_allocator<U> const& rhs)
+{
+    return lhs.arena() != rhs.arena();
+}
+
+}
+
+#endif // MAPNIK_FEATURE_ARENA_HPP
@@ -40,6 +40,13 @@ struct feature_factory
         //return boost::allocate_shared<feature_impl>(boost::fast_pool_allocator<feature_impl>(),fid);
         return std::make_shared<feature_impl>(ctx,fid);
     }
+
+    // feature and attribute values allocated from arena, kept alive by the feature
+    static std::shared_ptr<feature_impl> create (context_ptr const& ctx, mapnik::value_integer fid, feature_arena_ptr const& arena)
+    {
+        if (!arena) return create(ctx, fid);
+        return std::allocate_shared<feature_impl>(arena_owner_allocator<feature_impl>(arena), ctx, fid, arena.get());
+    }
 };
 }
 
@@ -30,6 +30,7 @@
 #include <mapnik/feature_style_processor_context.hpp>
 
 // stl
+#include <cstddef>
 #include <set>
 #include <string>
 
@@ -37,11 +38,15 @@ namespace mapnik
 {
 
 class Map;
+class request;
 class layer;
 class projection;
 class proj_transform;
 class feature_type_style;
 class rule_cache;
+class prefetch_pool;
+struct render_stats;
+struct style_stats;
 struct layer_rendering_material;
 
 enum eAttributeCollectionPolicy
@@ -62,6 +67,12 @@ public:
      */
     void apply(double scale_denom_override=0.0);
 
+    /*!
+     * \brief apply renderer to all map layers, using the size, extent and
+     *        buffer size of the request instead of the map's.
+     */
+    void apply(request const& req, double scale_denom_override=0.0);
+
     /*!
      * \brief apply renderer to a single layer, providing pre-populated set of query attribute names.
      */
@@ -83,6 +94,22 @@ public:
                         int buffer_size,
                         std::set<std::string>& names);
 
+    /*!
+     * \brief query all layers up front on num_threads background threads,
+     *        buffering their features while earlier layers are rendered.
+     *        Zero (the default) queries each layer on the rendering thread.
+     */
+    void set_prefetch_threads(std::size_t num_threads);
+    std::size_t prefetch_threads() const;
+
+    /*!
+     * \brief collect per layer and per style statistics into stats
+     *        while rendering, nullptr (the default) disables collection.
+     *        The object must outlive the calls to apply().
+     */
+    void set_stats(render_stats * stats);
+    render_stats * stats() const;
+
 private:
     /*!
      * \brief renders a featureset with the given styles.
@@ -91,13 +118,15 @@ private:
                       feature_type_style const* style,
                       rule_cache const& rules,
                       featureset_ptr features,
-                      proj_transform const& prj_trans);
+                      proj_transform const& prj_trans,
+                      style_stats * stats);
 
     /*!
      * \brief prepare features for rendering asynchronously.
      */
     void prepare_layer(layer_rendering_material & mat,
                        feature_style_context_map & ctx_map,
+                       prefetch_pool * prefetch,
                        Processor & p,
                        double scale,
                        double scale_denom,
@@ -113,6 +142,8 @@ private:
     void render_material(layer_rendering_material & mat, Processor & p );
 
     Map const& m_;
+    std::size_t prefetch_threads_;
+    render_stats * stats_;
 };
 }
 
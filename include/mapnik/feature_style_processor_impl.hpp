@@ -31,7 +31,9 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/feature_style_processor.hpp>
 #include <mapnik/query.hpp>
+#include <mapnik/request.hpp>
 #include <mapnik/datasource.hpp>
+#include <mapnik/featureset_prefetch.hpp>
 #include <mapnik/feature_type_style.hpp>
 #include <mapnik/box2d.hpp>
 #include <mapnik/layer.hpp>
@@ -45,10 +47,14 @@
 #include <mapnik/util/featureset_buffer.hpp>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/symbolizer_dispatch.hpp>
+#include <mapnik/symbolizer_utils.hpp>
+#include <mapnik/render_stats.hpp>
+#include <mapnik/timer.hpp>
 
 // stl
 #include <vector>
 #include <stdexcept>
+#include <exception>
 
 namespace mapnik
 {
@@ -63,6 +69,7 @@ struct layer_rendering_material
     std::vector<feature_type_style const*> active_styles_;
     std::vector<featureset_ptr> featureset_ptr_list_;
     std::vector<rule_cache> rule_caches_;
+    layer_stats stats_;
 
     layer_rendering_material(layer const& lay, projection const& dest)
         :
@@ -73,10 +80,84 @@ struct layer_rendering_material
 
 using layer_rendering_material_ptr = std::shared_ptr<layer_rendering_material>;
 
+namespace detail {
+
+inline double elapsed_ms(double start)
+{
+    return (time_now() - start) * 1000.0;
+}
+
+template <typename Processor>
+void render_rule(Processor & p,
+                 rule const& r,
+                 feature_impl & feature,
+                 proj_transform const& prj_trans,
+                 style_stats * stats)
+{
+    rule::symbolizers const& symbols = r.get_symbolizers();
+    if (!stats)
+    {
+        if (!p.process(symbols, feature, prj_trans))
+        {
+            for (symbolizer const& sym : symbols)
+            {
+                util::apply_visitor(symbolizer_dispatch<Processor>(p, feature, prj_trans), sym);
+            }
+        }
+        return;
+    }
+    double start = time_now();
+    if (p.process(symbols, feature, prj_trans))
+    {
+        // the processor rendered the whole list at once
+        stats->symbolizer_times["batch"] += elapsed_ms(start);
+        return;
+    }
+    for (symbolizer const& sym : symbols)
+    {
+        start = time_now();
+        util::apply_visitor(symbolizer_dispatch<Processor>(p, feature, prj_trans), sym);
+        stats->symbolizer_times[symbolizer_name(sym)] += elapsed_ms(start);
+    }
+}
+
+inline void add_style_stats(layer_stats & stats, std::string const& name)
+{
+    stats.styles.push_back(style_stats());
+    stats.styles.back().name = name;
+}
+
+// stats of the i-th active style, nullptr when not collecting
+inline style_stats * style_stats_at(layer_rendering_material & mat, std::size_t i)
+{
+    return i < mat.stats_.styles.size() ? &mat.stats_.styles[i] : nullptr;
+}
+
+template <typename Processor>
+void end_style(Processor & p,
+               feature_type_style const& style,
+               double start,
+               style_stats * stats)
+{
+    if (!stats)
+    {
+        p.end_style_processing(style);
+        return;
+    }
+    double compositing_start = time_now();
+    p.end_style_processing(style);
+    stats->compositing_time += elapsed_ms(compositing_start);
+    stats->render_time += elapsed_ms(start);
+}
+
+}
+
 
 template <typename Processor>
 feature_style_processor<Processor>::feature_style_processor(Map const& m, double scale_factor)
-    : m_(m)
+    : m_(m),
+      prefetch_threads_(0),
+      stats_(nullptr)
 {
     // https://github.com/mapnik/mapnik/issues/1100
     if (scale_factor <= 0)
@@ -85,15 +166,47 @@ feature_style_processor<Processor>::feature_style_processor(Map const& m, double
     }
 }
 
+template <typename Processor>
+void feature_style_processor<Processor>::set_prefetch_threads(std::size_t num_threads)
+{
+    prefetch_threads_ = num_threads;
+}
+
+template <typename Processor>
+std::size_t feature_style_processor<Processor>::prefetch_threads() const
+{
+    return prefetch_threads_;
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::set_stats(render_stats * stats)
+{
+    stats_ = stats;
+}
+
+template <typename Processor>
+render_stats * feature_style_processor<Processor>::stats() const
+{
+    return stats_;
+}
+
 template <typename Processor>
 void feature_style_processor<Processor>::apply(double scale_denom)
+{
+    request req(m_.width(), m_.height(), m_.get_current_extent());
+    req.set_buffer_size(m_.buffer_size());
+    apply(req, scale_denom);
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::apply(request const& req, double scale_denom)
 {
     Processor & p = static_cast<Processor&>(*this);
     p.start_map_processing(m_);
 
     projection proj(m_.srs(),true);
     if (scale_denom <= 0.0)
-        scale_denom = mapnik::scale_denominator(m_.scale(),proj.is_geographic());
+        scale_denom = mapnik::scale_denominator(req.scale(),proj.is_geographic());
     scale_denom *= p.scale_factor(); // FIXME - we might want to comment this out
 
     // Asynchronous query supports:
@@ -102,6 +215,16 @@ void feature_style_processor<Processor>::apply(double scale_denom)
     // in a second time, we fetch the results and
     // do the actual rendering
 
+    // Optional prefetching: layer queries are run by a pool of
+    // worker threads while earlier layers are being rendered.
+    // Declared before the materials so that pending work is
+    // abandoned once they are gone.
+    std::unique_ptr<prefetch_pool> prefetch;
+    if (prefetch_threads_ > 0)
+    {
+        prefetch.reset(new prefetch_pool(prefetch_threads_));
+    }
+
     std::vector<layer_rendering_material_ptr> mat_list;
 
     // Define processing context map used by datasources
@@ -117,13 +240,14 @@ void feature_style_processor<Processor>::apply(double scale_denom)
 
             prepare_layer(*mat,
                           ctx_map,
+                          prefetch.get(),
                           p,
-                          m_.scale(),
+                          req.scale(),
                           scale_denom,
-                          m_.width(),
-                          m_.height(),
-                          m_.get_current_extent(),
-                          m_.buffer_size(),
+                          req.width(),
+                          req.height(),
+                          req.extent(),
+                          req.buffer_size(),
                           names);
 
             // Store active material
@@ -140,6 +264,9 @@ void feature_style_processor<Processor>::apply(double scale_denom)
         {
             render_material(*mat,p);
         }
+        // Release the featuresets right away: a prefetch worker blocked
+        // on a queue that was not read to the end moves on to the next layer.
+        mat->featureset_ptr_list_.clear();
     }
 
     p.end_map_processing(m_);
@@ -193,6 +320,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
 
     prepare_layer(mat,
                   ctx_map,
+                  nullptr,
                   p,
                   scale,
                   scale_denom,
@@ -211,6 +339,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
 template <typename Processor>
 void feature_style_processor<Processor>::prepare_layer(layer_rendering_material & mat,
                                                        feature_style_context_map & ctx_map,
+                                                       prefetch_pool * prefetch,
                                                        Processor & p,
                                                        double scale,
                                                        double scale_denom,
@@ -242,6 +371,10 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
 
     processor_context_ptr current_ctx = ds->get_context(ctx_map);
     proj_transform prj_trans(mat.proj0_,mat.proj1_);
+    if (stats_)
+    {
+        mat.stats_.name = lay.name();
+    }
 
     box2d<double> query_ext = extent; // unbuffered
     box2d<double> buffered_query_ext(query_ext);  // buffered
@@ -320,6 +453,7 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
                 {
                     // we'll have to handle compositing ops
                     active_styles.push_back(&(*style));
+                    if (stats_) detail::add_style_stats(mat.stats_, style_name);
                 }
             }
         }
@@ -382,8 +516,10 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
         }
         if (active_rules)
         {
+            rc.build_index();
             rule_caches.push_back(std::move(rc));
             active_styles.push_back(&(*style));
+            if (stats_) detail::add_style_stats(mat.stats_, style_name);
         }
     }
 
@@ -418,6 +554,38 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
     }
     q.set_filter_factor(collector.get_filter_factor());
 
+    // Features matching none of the active rules are never rendered unless
+    // an else rule catches them, hand the rule filters to the datasource.
+    std::vector<expression_ptr> filters;
+    for (rule_cache const& rc : rule_caches)
+    {
+        if (!rc.get_else_rules().empty())
+        {
+            filters.clear();
+            break;
+        }
+        bool unfiltered = false;
+        for (rule const* r : rc.get_if_rules())
+        {
+            expression_ptr const& filter = r->get_filter();
+            if (!filter || (filter->is<value_bool>() && filter->get<value_bool>()))
+            {
+                unfiltered = true;
+                break;
+            }
+            filters.push_back(filter);
+        }
+        if (unfiltered)
+        {
+            filters.clear();
+            break;
+        }
+    }
+    for (expression_ptr const& filter : filters)
+    {
+        q.add_filter(filter);
+    }
+
     // Also query the group by attribute
     std::string const& group_by = lay.group_by();
     if (!group_by.empty())
@@ -428,16 +596,61 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
     bool cache_features = lay.cache_features() && active_styles.size() > 1;
 
     std::vector<featureset_ptr> & featureset_ptr_list = mat.featureset_ptr_list_;
-    if (!group_by.empty() || cache_features)
+    std::size_t num_queries = (!group_by.empty() || cache_features) ? 1 : active_styles.size();
+
+    // Datasources handing out a processor context already run
+    // their queries asynchronously, leave them alone.
+    if (prefetch && !current_ctx)
     {
-        featureset_ptr_list.push_back(ds->features_with_context(q,current_ctx));
+        std::vector<prefetch_queue_ptr> targets;
+        for (std::size_t i = 0; i < num_queries; ++i)
+        {
+            prefetch_featureset_ptr features = std::make_shared<prefetch_featureset>();
+            featureset_ptr_list.push_back(features);
+            targets.push_back(features->queue());
+        }
+        // Queries for the same layer run one after another, in the
+        // order the styles will consume them. push() blocks while a
+        // queue is full and fails once its featureset is gone.
+        // The query time is measured here and merged into the layer
+        // stats once the featuresets were consumed.
+        bool timed = stats_ != nullptr;
+        prefetch->post([ds, q, targets, timed]()
+        {
+            for (prefetch_queue_ptr const& target : targets)
+            {
+                std::exception_ptr error;
+                try
+                {
+                    if (target->closed()) return;
+                    double start = timed ? time_now() : 0.0;
+                    featureset_ptr features = ds->features_with_context(q, processor_context_ptr());
+                    if (timed) target->add_query_time(detail::elapsed_ms(start));
+                    if (features)
+                    {
+                        feature_ptr feature;
+                        while ((feature = features->next()))
+                        {
+                            if (!target->push(feature)) return;
+                        }
+                    }
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                target->done(error);
+            }
+        });
     }
     else
     {
-        for(std::size_t i = 0; i < active_styles.size(); ++i)
+        double start = stats_ ? time_now() : 0.0;
+        for (std::size_t i = 0; i < num_queries; ++i)
         {
             featureset_ptr_list.push_back(ds->features_with_context(q,current_ctx));
         }
+        if (stats_) mat.stats_.query_time += detail::elapsed_ms(start);
     }
 }
 
@@ -448,14 +661,22 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
 {
     std::vector<feature_type_style const*> & active_styles = mat.active_styles_;
     std::vector<featureset_ptr> & featureset_ptr_list = mat.featureset_ptr_list_;
+    double start = stats_ ? time_now() : 0.0;
     if (featureset_ptr_list.empty())
     {
         // The datasource wasn't queried because of early return
         // but we have to apply compositing operations on styles
+        std::size_t i = 0;
         for (feature_type_style const* style : active_styles)
         {
+            double style_start = stats_ ? time_now() : 0.0;
             p.start_style_processing(*style);
-            p.end_style_processing(*style);
+            detail::end_style(p, *style, style_start, detail::style_stats_at(mat, i++));
+        }
+        if (stats_)
+        {
+            mat.stats_.render_time += detail::elapsed_ms(start);
+            stats_->layers.push_back(std::move(mat.stats_));
         }
         return;
     }
@@ -497,7 +718,8 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
                         render_style(p, style,
                                      rule_caches[i],
                                      cache,
-                                     prj_trans);
+                                     prj_trans,
+                                     detail::style_stats_at(mat, i));
                         ++i;
                     }
                     cache->clear();
@@ -510,7 +732,7 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
             for (feature_type_style const* style : active_styles)
             {
                 cache->prepare();
-                render_style(p, style, rule_caches[i], cache, prj_trans);
+                render_style(p, style, rule_caches[i], cache, prj_trans, detail::style_stats_at(mat, i));
                 ++i;
             }
             cache->clear();
@@ -536,7 +758,8 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
             cache->prepare();
             render_style(p, style,
                          rule_caches[i],
-                         cache, prj_trans);
+                         cache, prj_trans,
+                         detail::style_stats_at(mat, i));
             ++i;
         }
     }
@@ -551,11 +774,26 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
             render_style(p, style,
                          rule_caches[i],
                          features,
-                         prj_trans);
+                         prj_trans,
+                         detail::style_stats_at(mat, i));
             ++i;
         }
     }
+    if (!stats_)
+    {
+        p.end_layer_processing(mat.lay_);
+        return;
+    }
+    double compositing_start = time_now();
     p.end_layer_processing(mat.lay_);
+    mat.stats_.compositing_time += detail::elapsed_ms(compositing_start);
+    mat.stats_.render_time += detail::elapsed_ms(start);
+    for (featureset_ptr const& features : featureset_ptr_list)
+    {
+        prefetch_featureset const* prefetched = dynamic_cast<prefetch_featureset const*>(features.get());
+        if (prefetched) mat.stats_.query_time += prefetched->queue()->query_time();
+    }
+    stats_->layers.push_back(std::move(mat.stats_));
 }
 
 template <typename Processor>
@@ -564,38 +802,45 @@ void feature_style_processor<Processor>::render_style(
     feature_type_style const* style,
     rule_cache const& rc,
     featureset_ptr features,
-    proj_transform const& prj_trans)
+    proj_transform const& prj_trans,
+    style_stats * stats)
 {
+    double start = stats ? time_now() : 0.0;
     p.start_style_processing(*style);
     if (!features)
     {
-        p.end_style_processing(*style);
+        detail::end_style(p, *style, start, stats);
         return;
     }
     mapnik::attributes vars = p.variables();
+    rule_cache::rule_ptrs const& if_rules = rc.get_if_rules();
+    // filter attributes resolved to slots once per feature context
+    std::vector<expression_program::binding> bindings(if_rules.size());
     feature_ptr feature;
     bool was_painted = false;
     while ((feature = features->next()))
     {
+        if (stats)
+        {
+            if (stats->features_fetched++ == 0)
+            {
+                stats->first_feature_time += detail::elapsed_ms(start);
+            }
+        }
+        bool painted = false;
         bool do_else = true;
         bool do_also = false;
-        for (rule const* r : rc.get_if_rules() )
+        // rules skipped by the index can't match this feature
+        for (std::size_t i : rc.candidates(*feature))
         {
-            expression_ptr const& expr = r->get_filter();
-            value_type result = util::apply_visitor(evaluate<feature_impl,value_type,attributes>(*feature,vars),*expr);
-            if (result.to_bool())
+            rule const* r = if_rules[i];
+            if (stats) ++stats->filters_evaluated;
+            if (r->get_filter_program().to_bool(*feature,vars,bindings[i]))
             {
-                was_painted = true;
+                painted = true;
                 do_else=false;
                 do_also=true;
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                if(!p.process(symbols,*feature,prj_trans))
-                {
-                    for (symbolizer const& sym : symbols)
-                    {
-                        util::apply_visitor(symbolizer_dispatch<Processor>(p,*feature,prj_trans),sym);
-                    }
-                }
+                detail::render_rule(p, *r, *feature, prj_trans, stats);
                 if (style->get_filter_mode() == FILTER_FIRST)
                 {
                     // Stop iterating over rules and proceed with next feature.
@@ -608,35 +853,25 @@ void feature_style_processor<Processor>::render_style(
         {
             for( rule const* r : rc.get_else_rules() )
             {
-                was_painted = true;
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                if(!p.process(symbols,*feature,prj_trans))
-                {
-                    for (symbolizer const& sym : symbols)
-                    {
-                        util::apply_visitor(symbolizer_dispatch<Processor>(p,*feature,prj_trans),sym);
-                    }
-                }
+                painted = true;
+                detail::render_rule(p, *r, *feature, prj_trans, stats);
             }
         }
         if (do_also)
         {
             for( rule const* r : rc.get_also_rules() )
             {
-                was_painted = true;
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                if(!p.process(symbols,*feature,prj_trans))
-                {
-                    for (symbolizer const& sym : symbols)
-                    {
-                        util::apply_visitor(symbolizer_dispatch<Processor>(p,*feature,prj_trans),sym);
-                    }
-                }
+                detail::render_rule(p, *r, *feature, prj_trans, stats);
             }
         }
+        if (painted)
+        {
+            was_painted = true;
+            if (stats) ++stats->features_painted;
+        }
     }
     p.painted(p.painted() | was_painted);
-    p.end_style_processing(*style);
+    detail::end_style(p, *style, start, stats);
 }
 
 }
@@ -0,0 +1,135 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_FEATURESET_PREFETCH_HPP
+#define MAPNIK_FEATURESET_PREFETCH_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace mapnik {
+
+// Bounded queue shared by a producer (usually a prefetch_pool worker) and
+// the prefetch_featureset reading from it. push() blocks while the queue is
+// full and returns false once the consumer has gone away, so a producer
+// never buffers more than `capacity` features ahead of the renderer.
+// Without MAPNIK_THREADSAFE there is no concurrent consumer and the
+// capacity is not enforced.
+class MAPNIK_DECL prefetch_queue : private util::noncopyable
+{
+public:
+    static constexpr std::size_t default_capacity = 1024;
+
+    explicit prefetch_queue(std::size_t capacity = default_capacity);
+
+    // producer side
+    bool push(feature_ptr const& feature);
+    void done(std::exception_ptr error = std::exception_ptr());
+    bool closed() const;
+    // milliseconds the producer spent in the datasource query
+    void add_query_time(double ms);
+
+    // consumer side
+    feature_ptr pop();
+    void close();
+    double query_time() const;
+
+private:
+    std::deque<feature_ptr> features_;
+    std::exception_ptr error_;
+    double query_time_;
+    std::size_t capacity_;
+    bool done_;
+    bool closed_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+#endif
+};
+
+using prefetch_queue_ptr = std::shared_ptr<prefetch_queue>;
+
+// Featureset reading from a prefetch_queue. next() blocks until a feature
+// is available or the producer signals completion. Errors raised by the
+// producer are rethrown from next() on the consuming thread. Producers hold
+// the queue rather than the featureset; destroying the featureset closes
+// the queue, which wakes up and stops a producer blocked on a full queue.
+class MAPNIK_DECL prefetch_featureset : public Featureset
+{
+public:
+    explicit prefetch_featureset(std::size_t capacity = prefetch_queue::default_capacity);
+    virtual ~prefetch_featureset();
+
+    feature_ptr next();
+
+    prefetch_queue_ptr const& queue() const;
+
+private:
+    prefetch_queue_ptr queue_;
+};
+
+using prefetch_featureset_ptr = std::shared_ptr<prefetch_featureset>;
+
+// Fixed size set of worker threads running posted tasks in FIFO order.
+// The destructor waits for running tasks and discards the ones not started yet.
+// Without MAPNIK_THREADSAFE tasks are run synchronously by post().
+class MAPNIK_DECL prefetch_pool : private util::noncopyable
+{
+public:
+    using task_type = std::function<void()>;
+
+    explicit prefetch_pool(std::size_t num_threads);
+    ~prefetch_pool();
+
+    void post(task_type task);
+    std::size_t size() const;
+
+private:
+#ifdef MAPNIK_THREADSAFE
+    void run();
+    std::vector<std::thread> workers_;
+    std::deque<task_type> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_;
+#endif
+    std::size_t num_threads_;
+};
+
+}
+
+#endif // MAPNIK_FEATURESET_PREFETCH_HPP
@@ -22,6 +22,7 @@
 
 #include <mapnik/geometry_envelope.hpp>
 #include <mapnik/geometry.hpp>
+#include <mapnik/geometry_flat.hpp>
 #include <mapnik/box2d.hpp>
 
 namespace mapnik { namespace geometry {
@@ -126,6 +127,33 @@ struct geometry_envelope
         }
     }
 
+    template <typename T>
+    void operator() (mapnik::geometry::flat_geometry<T> const& geom) const
+    {
+        // exterior rings only for polygons
+        bool polygon = geom.part_type() == mapnik::geometry::geometry_types::Polygon;
+        for (std::size_t part = 0; part < geom.num_parts(); ++part)
+        {
+            std::size_t rings_end = polygon ? std::min(geom.part_begin(part) + 1, geom.part_end(part))
+                                            : geom.part_end(part);
+            for (std::size_t ring = geom.part_begin(part); ring < rings_end; ++ring)
+            {
+                for (std::size_t i = geom.ring_begin(ring); i < geom.ring_end(ring); ++i)
+                {
+                    auto const& pt = geom[i];
+                    if (!bbox.valid())
+                    {
+                        bbox.init(pt.x, pt.y, pt.x, pt.y);
+                    }
+                    else
+                    {
+                        bbox.expand_to_include(pt.x, pt.y);
+                    }
+                }
+            }
+        }
+    }
+
     template <typename T>
     void operator() (mapnik::geometry::geometry_collection<T> const& collection) const
     {
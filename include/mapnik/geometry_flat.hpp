@@ -0,0 +1,326 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_GEOMETRY_FLAT_HPP
+#define MAPNIK_GEOMETRY_FLAT_HPP
+
+// mapnik
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry_types.hpp>
+
+// stl
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace mapnik { namespace geometry {
+
+// Homogeneous geometry stored as one coordinate buffer plus offset arrays:
+// a geometry is a list of parts (the members of a multi geometry), a part
+// a list of rings and a ring a run of coordinates. Points and line strings
+// are parts with a single ring, a polygon part has its exterior ring
+// first. Decoding a multipolygon costs three vector allocations instead
+// of one per ring.
+template <typename T>
+class flat_geometry
+{
+public:
+    using value_type = T;
+    using point_type = point<T>;
+
+    flat_geometry()
+        : type_(geometry_types::Unknown) {}
+
+    explicit flat_geometry(geometry_types type)
+        : type_(type) {}
+
+    geometry_types type() const { return type_; }
+    void set_type(geometry_types type) { type_ = type; }
+
+    // geometry type of each part: Point, LineString or Polygon
+    geometry_types part_type() const
+    {
+        switch (type_)
+        {
+        case geometry_types::MultiPoint: return geometry_types::Point;
+        case geometry_types::MultiLineString: return geometry_types::LineString;
+        case geometry_types::MultiPolygon: return geometry_types::Polygon;
+        default: return type_;
+        }
+    }
+
+    bool empty() const { return points_.empty(); }
+
+    void clear()
+    {
+        type_ = geometry_types::Unknown;
+        points_.clear();
+        rings_.clear();
+        parts_.clear();
+    }
+
+    void reserve(std::size_t num_points) { points_.reserve(num_points); }
+
+    void begin_part() { parts_.push_back(rings_.size()); }
+    void begin_ring() { rings_.push_back(points_.size()); }
+    void add_coord(T x, T y) { points_.emplace_back(x, y); }
+
+    // Closes the last ring of a polygon part and orients it
+    // counterclockwise when it is the exterior ring and clockwise
+    // otherwise, the same way geometry::correct does.
+    void close_ring(bool exterior)
+    {
+        if (rings_.empty()) return;
+        auto first = points_.begin() + static_cast<std::ptrdiff_t>(rings_.back());
+        if (points_.end() - first <= 2) return;
+        if (*first != points_.back())
+        {
+            point_type start = *first;
+            points_.push_back(start);
+            first = points_.begin() + static_cast<std::ptrdiff_t>(rings_.back());
+        }
+        double area = 0;
+        for (auto itr = first; itr + 1 != points_.end(); ++itr)
+        {
+            area += static_cast<double>(itr->x) * static_cast<double>((itr + 1)->y)
+                - static_cast<double>((itr + 1)->x) * static_cast<double>(itr->y);
+        }
+        if (exterior ? area < 0 : area > 0)
+        {
+            std::reverse(first, points_.end());
+        }
+    }
+
+    std::size_t num_parts() const { return parts_.size(); }
+    std::size_t num_rings() const { return rings_.size(); }
+    std::size_t num_points() const { return points_.size(); }
+
+    // rings [part_begin(i), part_end(i)) make up part i
+    std::size_t part_begin(std::size_t part) const { return parts_[part]; }
+    std::size_t part_end(std::size_t part) const
+    {
+        return part + 1 < parts_.size() ? parts_[part + 1] : rings_.size();
+    }
+
+    // points [ring_begin(i), ring_end(i)) make up ring i
+    std::size_t ring_begin(std::size_t ring) const { return rings_[ring]; }
+    std::size_t ring_end(std::size_t ring) const
+    {
+        return ring + 1 < rings_.size() ? rings_[ring + 1] : points_.size();
+    }
+
+    std::vector<point_type> const& points() const { return points_; }
+    point_type const& operator[](std::size_t index) const { return points_[index]; }
+
+private:
+    geometry_types type_;
+    std::vector<point_type> points_;
+    std::vector<std::size_t> rings_;
+    std::vector<std::size_t> parts_;
+};
+
+namespace detail {
+
+template <typename T>
+struct geometry_to_flat
+{
+    geometry_to_flat(flat_geometry<T> & flat)
+        : flat_(flat) {}
+
+    bool operator() (geometry<T> const& geom) const
+    {
+        return util::apply_visitor(*this, geom);
+    }
+
+    bool operator() (geometry_empty const&) const
+    {
+        return true;
+    }
+
+    bool operator() (point<T> const& pt) const
+    {
+        flat_.set_type(geometry_types::Point);
+        add_point(pt);
+        return true;
+    }
+
+    bool operator() (line_string<T> const& line) const
+    {
+        flat_.set_type(geometry_types::LineString);
+        add_line(line);
+        return true;
+    }
+
+    bool operator() (polygon<T> const& poly) const
+    {
+        flat_.set_type(geometry_types::Polygon);
+        add_polygon(poly);
+        return true;
+    }
+
+    bool operator() (multi_point<T> const& multi_pt) const
+    {
+        flat_.set_type(geometry_types::MultiPoint);
+        for (auto const& pt : multi_pt) add_point(pt);
+        return true;
+    }
+
+    bool operator() (multi_line_string<T> const& multi_line) const
+    {
+        flat_.set_type(geometry_types::MultiLineString);
+        for (auto const& line : multi_line) add_line(line);
+        return true;
+    }
+
+    bool operator() (multi_polygon<T> const& multi_poly) const
+    {
+        flat_.set_type(geometry_types::MultiPolygon);
+        for (auto const& poly : multi_poly) add_polygon(poly);
+        return true;
+    }
+
+    bool operator() (geometry_collection<T> const&) const
+    {
+        // not homogeneous
+        return false;
+    }
+
+private:
+    void add_point(point<T> const& pt) const
+    {
+        flat_.begin_part();
+        flat_.begin_ring();
+        flat_.add_coord(pt.x, pt.y);
+    }
+
+    void add_ring(line_string<T> const& ring) const
+    {
+        flat_.begin_ring();
+        for (auto const& pt : ring) flat_.add_coord(pt.x, pt.y);
+    }
+
+    void add_line(line_string<T> const& line) const
+    {
+        flat_.begin_part();
+        add_ring(line);
+    }
+
+    void add_polygon(polygon<T> const& poly) const
+    {
+        flat_.begin_part();
+        add_ring(poly.exterior_ring);
+        for (auto const& ring : poly.interior_rings) add_ring(ring);
+    }
+
+    flat_geometry<T> & flat_;
+};
+
+template <typename T, typename Ring>
+Ring flat_ring(flat_geometry<T> const& flat, std::size_t ring)
+{
+    Ring result;
+    auto const& points = flat.points();
+    result.assign(points.begin() + static_cast<std::ptrdiff_t>(flat.ring_begin(ring)),
+                  points.begin() + static_cast<std::ptrdiff_t>(flat.ring_end(ring)));
+    return result;
+}
+
+template <typename T>
+polygon<T> flat_polygon(flat_geometry<T> const& flat, std::size_t part)
+{
+    polygon<T> poly;
+    std::size_t begin = flat.part_begin(part);
+    std::size_t end = flat.part_end(part);
+    if (begin == end) return poly;
+    poly.set_exterior_ring(flat_ring<T, linear_ring<T>>(flat, begin));
+    if (end - begin > 1) poly.interior_rings.reserve(end - begin - 1);
+    for (std::size_t ring = begin + 1; ring < end; ++ring)
+    {
+        poly.add_hole(flat_ring<T, linear_ring<T>>(flat, ring));
+    }
+    return poly;
+}
+
+} // ns detail
+
+// Appends geom to flat, false for geometry collections.
+template <typename T>
+bool to_flat(geometry<T> const& geom, flat_geometry<T> & flat)
+{
+    return detail::geometry_to_flat<T>(flat)(geom);
+}
+
+template <typename T>
+geometry<T> from_flat(flat_geometry<T> const& flat)
+{
+    std::size_t num_parts = flat.num_parts();
+    switch (flat.type())
+    {
+    case geometry_types::Point:
+        if (num_parts > 0 && flat.num_points() > 0) return geometry<T>(flat[0]);
+        break;
+    case geometry_types::LineString:
+        if (num_parts > 0 && flat.num_rings() > 0)
+        {
+            return geometry<T>(detail::flat_ring<T, line_string<T>>(flat, 0));
+        }
+        break;
+    case geometry_types::Polygon:
+        if (num_parts > 0) return geometry<T>(detail::flat_polygon(flat, 0));
+        break;
+    case geometry_types::MultiPoint:
+    {
+        multi_point<T> multi_pt;
+        multi_pt.reserve(flat.num_points());
+        for (auto const& pt : flat.points()) multi_pt.push_back(pt);
+        return geometry<T>(std::move(multi_pt));
+    }
+    case geometry_types::MultiLineString:
+    {
+        multi_line_string<T> multi_line;
+        multi_line.reserve(flat.num_rings());
+        for (std::size_t ring = 0; ring < flat.num_rings(); ++ring)
+        {
+            multi_line.push_back(detail::flat_ring<T, line_string<T>>(flat, ring));
+        }
+        return geometry<T>(std::move(multi_line));
+    }
+    case geometry_types::MultiPolygon:
+    {
+        multi_polygon<T> multi_poly;
+        multi_poly.reserve(num_parts);
+        for (std::size_t part = 0; part < num_parts; ++part)
+        {
+            multi_poly.push_back(detail::flat_polygon(flat, part));
+        }
+        return geometry<T>(std::move(multi_poly));
+    }
+    default:
+        break;
+    }
+    return geometry<T>();
+}
+
+}}
+
+#endif // MAPNIK_GEOMETRY_FLAT_HPP
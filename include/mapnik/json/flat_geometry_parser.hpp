@@ -0,0 +1,47 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_JSON_FLAT_GEOMETRY_PARSER_HPP
+#define MAPNIK_JSON_FLAT_GEOMETRY_PARSER_HPP
+
+// mapnik
+#include <mapnik/geometry_flat.hpp>
+
+// stl
+#include <string>
+
+namespace mapnik { namespace json {
+
+// Reads a GeoJSON geometry object straight into flat storage, without the
+// nested coordinate vectors of the spirit grammar. Returns false for
+// geometry collections and malformed input.
+bool from_geojson(char const* start, char const* end, mapnik::geometry::flat_geometry<double> & geom);
+
+inline bool from_geojson(std::string const& json, mapnik::geometry::flat_geometry<double> & geom)
+{
+    return from_geojson(json.c_str(), json.c_str() + json.size(), geom);
+}
+
+}}
+
+#endif // MAPNIK_JSON_FLAT_GEOMETRY_PARSER_HPP
@@ -24,6 +24,7 @@
 #define MAPNIK_LABEL_COLLISION_DETECTOR_HPP
 
 // mapnik
+#include <mapnik/config.hpp>
 #include <mapnik/quad_tree.hpp>
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/value_types.hpp>
@@ -32,6 +33,7 @@
 #include <unicode/unistr.h>
 
 // stl
+#include <cstdint>
 #include <vector>
 
 namespace mapnik
@@ -74,11 +76,9 @@ public:
 
     bool has_placement(box2d<double> const& box)
     {
-        tree_t::query_iterator itr = tree_.query_in_box(box);
-        tree_t::query_iterator end = tree_.query_end();
-        for ( ;itr != end; ++itr)
+        if (!tree_.visit_in_box(box, [&box](box2d<double> const& other) { return !other.intersects(box); }))
         {
-            if (itr->get().intersects(box)) return false;
+            return false;
         }
         tree_.insert(box,box);
         return true;
@@ -101,16 +101,9 @@ public:
     explicit label_collision_detector3(box2d<double> const& extent)
         : tree_(extent) {}
 
-    bool has_placement(box2d<double> const& box)
+    bool has_placement(box2d<double> const& box) const
     {
-        tree_t::query_iterator itr = tree_.query_in_box(box);
-        tree_t::query_iterator end = tree_.query_end();
-
-        for ( ;itr != end; ++itr)
-        {
-            if (itr->get().intersects(box)) return false;
-        }
-        return true;
+        return tree_.visit_in_box(box, [&box](box2d<double> const& other) { return !other.intersects(box); });
     }
 
     void insert(box2d<double> const& box)
@@ -125,119 +118,74 @@ public:
 };
 
 
-//quad tree based label collision detector so labels dont appear within a given distance
-class label_collision_detector4 : util::noncopyable
+// Label collision detector over a uniform grid covering the extent, each
+// cell listing the labels whose box touches it. Repeat checks compare
+// hashes of the repeat text instead of keeping a copy of it per label.
+// clear() keeps the grid and its cell storage so a detector can be reused
+// for the next render, reset() moves it to another extent.
+class MAPNIK_DECL label_collision_detector4 : util::noncopyable
 {
 public:
     struct label
     {
-        label(box2d<double> const& b) : box(b), text() {}
-        label(box2d<double> const& b, mapnik::value_unicode_string const& t) : box(b), text(t) {}
+        label(box2d<double> const& b, std::size_t key = 0)
+            : box(b), repeat_key(key) {}
 
         box2d<double> box;
-        mapnik::value_unicode_string text;
+        // hash of the repeat text, 0 for labels without one
+        std::size_t repeat_key;
     };
 
-private:
-    using tree_t = quad_tree< label >;
-    tree_t tree_;
-
-public:
-    using query_iterator = tree_t::query_iterator;
-
-    explicit label_collision_detector4(box2d<double> const& extent)
-        : tree_(extent) {}
-
-    bool has_placement(box2d<double> const& box)
-    {
-        tree_t::query_iterator itr = tree_.query_in_box(box);
-        tree_t::query_iterator end = tree_.query_end();
-
-        for ( ;itr != end; ++itr)
-        {
-            if (itr->get().box.intersects(box)) return false;
-        }
+    using label_container = std::vector<label>;
+    using query_iterator = label_container::const_iterator;
 
-        return true;
-    }
+    // in pixels, about the size of a short label
+    static constexpr double default_cell_size = 64.0;
 
-    bool has_placement(box2d<double> const& box, double margin)
-    {
-        box2d<double> const& margin_box = (margin > 0
-                                               ? box2d<double>(box.minx() - margin, box.miny() - margin,
-                                                               box.maxx() + margin, box.maxy() + margin)
-                                               : box);
+    explicit label_collision_detector4(box2d<double> const& extent,
+                                       double cell_size = default_cell_size);
 
-        tree_t::query_iterator itr = tree_.query_in_box(margin_box);
-        tree_t::query_iterator end = tree_.query_end();
+    bool has_placement(box2d<double> const& box) const;
+    bool has_placement(box2d<double> const& box, double margin) const;
+    bool has_placement(box2d<double> const& box, double margin, mapnik::value_unicode_string const& text, double repeat_distance) const;
 
-        for (;itr != end; ++itr)
-        {
-            if (itr->get().box.intersects(margin_box))
-            {
-                return false;
-            }
-        }
-        return true;
-    }
+    void insert(box2d<double> const& box);
+    void insert(box2d<double> const& box, mapnik::value_unicode_string const& text);
 
-    bool has_placement(box2d<double> const& box, double margin, mapnik::value_unicode_string const& text, double repeat_distance)
-    {
-        // Don't bother with any of the repeat checking unless the repeat distance is greater than the margin
-        if (repeat_distance <= margin) {
-            return has_placement(box, margin);
-        }
+    void clear();
+    void reset(box2d<double> const& extent);
 
-        box2d<double> repeat_box(box.minx() - repeat_distance, box.miny() - repeat_distance,
-                                 box.maxx() + repeat_distance, box.maxy() + repeat_distance);
-
-        box2d<double> const& margin_box = (margin > 0
-                                               ? box2d<double>(box.minx() - margin, box.miny() - margin,
-                                                               box.maxx() + margin, box.maxy() + margin)
-                                               : box);
-
-        tree_t::query_iterator itr = tree_.query_in_box(repeat_box);
-        tree_t::query_iterator end = tree_.query_end();
-
-        for ( ;itr != end; ++itr)
-        {
-            if (itr->get().box.intersects(margin_box) || (text == itr->get().text && itr->get().box.intersects(repeat_box)))
-            {
-                return false;
-            }
-        }
-
-        return true;
-    }
-
-    void insert(box2d<double> const& box)
+    box2d<double> const& extent() const
     {
-        if (tree_.extent().intersects(box))
-        {
-            tree_.insert(label(box), box);
-        }
+        return extent_;
     }
 
-    void insert(box2d<double> const& box, mapnik::value_unicode_string const& text)
-    {
-        if (tree_.extent().intersects(box))
-        {
-            tree_.insert(label(box, text), box);
-        }
-    }
+    std::size_t size() const { return labels_.size(); }
+    // may be larger than configured to bound the grid size
+    double cell_size() const { return cell_size_; }
 
-    void clear()
-    {
-        tree_.clear();
-    }
+    query_iterator begin() const { return labels_.begin(); }
+    query_iterator end() const { return labels_.end(); }
 
-    box2d<double> const& extent() const
-    {
-        return tree_.extent();
-    }
+    static std::size_t repeat_key(mapnik::value_unicode_string const& text);
 
-    query_iterator begin() { return tree_.query_in_box(extent()); }
-    query_iterator end() { return tree_.query_end(); }
+private:
+    template <typename Predicate>
+    bool none_in_box(box2d<double> const& box, Predicate pred) const;
+    std::size_t column(double x) const;
+    std::size_t row(double y) const;
+    void insert(label const& lbl);
+
+    box2d<double> extent_;
+    // as configured, cell_size_ is recomputed from it on reset()
+    double base_cell_size_;
+    double cell_size_;
+    std::size_t columns_;
+    std::size_t rows_;
+    // label indices per cell, row major
+    std::vector<std::vector<std::uint32_t> > cells_;
+    std::vector<std::size_t> used_cells_;
+    label_container labels_;
 };
 }
 
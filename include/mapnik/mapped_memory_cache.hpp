@@ -49,6 +49,8 @@ class MAPNIK_DECL mapped_memory_cache :
 public:
     bool insert(std::string const& key, mapped_region_ptr);
     boost::optional<mapped_region_ptr> find(std::string const& key, bool update_cache = false);
+    // forgets the mapping of key, e.g. after the file was replaced
+    bool remove(std::string const& key);
     void clear();
 };
 
@@ -26,9 +26,14 @@
 // mapnik
 #include <mapnik/datasource.hpp>
 #include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/packed_rtree.hpp>
 
 // stl
 #include <deque>
+#include <memory>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
 
 namespace mapnik {
 
@@ -50,13 +55,24 @@ public:
     void set_envelope(box2d<double> const& box);
     size_t size() const;
     void clear();
+    // below this size queries scan all features
+    static constexpr std::size_t min_indexed_features = 64;
 private:
+    using spatial_index_type = packed_rtree<std::size_t>;
+    std::shared_ptr<spatial_index_type const> spatial_index() const;
+    featureset_ptr query_index(box2d<double> const& box) const;
+
     std::deque<feature_ptr> features_;
     mapnik::layer_descriptor desc_;
     datasource::datasource_t type_;
     bool bbox_check_;
     mutable box2d<double> extent_;
     mutable bool dirty_extent_ = true;
+    // built on the first query after the features changed
+    mutable std::shared_ptr<spatial_index_type const> spatial_index_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex spatial_index_mutex_;
+#endif
 };
 
 }
@@ -56,6 +56,16 @@ public:
           bbox_check_(bbox_check)
     {}
 
+    // features selected by the caller, returned as they are
+    explicit memory_featureset(std::deque<feature_ptr> && features)
+        : bbox_(),
+          selected_(std::move(features)),
+          pos_(selected_.begin()),
+          end_(selected_.end()),
+          type_(datasource::Vector),
+          bbox_check_(false)
+    {}
+
     virtual ~memory_featureset() {}
 
     feature_ptr next()
@@ -92,6 +102,7 @@ public:
 
 private:
     box2d<double> bbox_;
+    std::deque<feature_ptr> selected_;
     std::deque<feature_ptr>::const_iterator pos_;
     std::deque<feature_ptr>::const_iterator end_;
     datasource::datasource_t type_;
@@ -0,0 +1,73 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_METATILE_HPP
+#define MAPNIK_METATILE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/attribute.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace mapnik {
+
+class Map;
+
+struct metatile_tile
+{
+    unsigned x;       // column within the metatile, from the left
+    unsigned y;       // row within the metatile, from the top
+    bool empty;       // every pixel is fully transparent
+    bool solid;       // every pixel has the same color (also true when empty)
+    std::string data; // encoded tile
+};
+
+using metatile_tiles = std::vector<metatile_tile>;
+
+// Encode the tiles_per_side x tiles_per_side tiles of an already rendered
+// metatile image, in row major order. Tiles are written straight from views
+// into the image, no intermediate copies are made.
+MAPNIK_DECL metatile_tiles slice_metatile(image_rgba8 const& image,
+                                          unsigned tiles_per_side,
+                                          unsigned tile_size,
+                                          std::string const& format);
+
+// Render the map once for the metatile extent with agg_renderer, so that
+// datasources are queried and labels are placed a single time for all
+// tiles, and return the encoded tiles as slice_metatile does.
+// The map's own size and extent are left untouched.
+MAPNIK_DECL metatile_tiles render_metatile(Map const& map,
+                                           box2d<double> const& extent,
+                                           unsigned tiles_per_side,
+                                           unsigned tile_size,
+                                           std::string const& format,
+                                           double scale_factor = 1.0,
+                                           attributes const& vars = attributes());
+
+}
+
+#endif // MAPNIK_METATILE_HPP
@@ -0,0 +1,477 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_PACKED_INDEX_FILE_HPP
+#define MAPNIK_PACKED_INDEX_FILE_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/attribute_descriptor.hpp>
+#include <mapnik/packed_rtree.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mapnik {
+
+// Spatial index of a datasource file, written next to it so that the file
+// doesn't have to be scanned again when the datasource is created. It holds
+// a packed hilbert r-tree (see packed_rtree) whose items are pairs of
+// integers given meaning by the plugin (e.g. offset and size of a feature),
+// and is queried in place, either from memory (e.g. a memory mapped file)
+// or through seeks on a stream. All values are little endian regardless of
+// the host.
+//
+//   header             104 bytes, see parse_header()
+//   level bounds       num_levels x uint64, end of each level in the node array
+//   nodes              num_nodes x 4 doubles (minx, miny, maxx, maxy), leaves first
+//   items              num_items x 2 uint64, one per leaf
+//   schema             schema_size bytes, per attribute a uint32 type,
+//                      a uint32 name length and the name
+//
+// The tree shape follows from num_items and node_size, so the level bounds
+// are checked in full when the index is opened, and each item is checked
+// against the size of the data file when a query reaches it.
+//
+// Plugins rebuilding the index on their own only use it while the size,
+// modification time and fingerprint (see util::file_fingerprint) of the
+// data file match the ones recorded in the header, as well as the hash of
+// any plugin options changing how the file is read.
+class packed_index_file
+{
+public:
+    using item_type = std::pair<std::uint64_t, std::uint64_t>;
+
+    struct header
+    {
+        char magic[12];
+        std::uint32_t version;
+        std::uint32_t node_size;
+        std::uint32_t num_levels;
+        std::uint64_t num_items;
+        std::uint64_t file_size;
+        std::int64_t file_mtime;
+        std::uint64_t file_hash;
+        double extent[4];
+        std::uint64_t schema_size;
+        std::uint64_t options;
+    };
+    static const std::size_t header_size = 104;
+
+    static const std::uint32_t version = 3;
+
+    // what the second value of an item holds, the first one being an
+    // offset into the data file
+    enum item_kind { offset_and_id, offset_and_size };
+
+    packed_index_file()
+        : data_(nullptr),
+          in_(nullptr),
+          base_(0),
+          size_(0),
+          hdr_(),
+          num_nodes_(0),
+          kind_(offset_and_id),
+          valid_(false) {}
+
+    // magic is the 12 character file type of the plugin owning the index,
+    // held in memory
+    packed_index_file(char const* magic, item_kind kind, char const* data, std::size_t size)
+        : packed_index_file()
+    {
+        data_ = data;
+        size_ = data ? size : 0;
+        kind_ = kind;
+        init(magic);
+    }
+
+    // same for an index read through seeks on in, from its current position
+    packed_index_file(char const* magic, item_kind kind, std::istream & in)
+        : packed_index_file()
+    {
+        in_ = &in;
+        kind_ = kind;
+        std::streampos start = in.tellg();
+        if (start < 0) return;
+        base_ = static_cast<std::uint64_t>(static_cast<std::streamoff>(start));
+        in.seekg(0, std::ios::end);
+        std::streampos end = in.tellg();
+        if (end >= start) size_ = static_cast<std::uint64_t>(end - start);
+        init(magic);
+    }
+
+    // true if data starts with magic, whatever the version
+    static bool has_magic(char const* magic, char const* data, std::size_t size)
+    {
+        return data != nullptr && size >= 12 && std::memcmp(data, magic, 12) == 0;
+    }
+
+    // same for a stream, which is left at its current position
+    static bool has_magic(char const* magic, std::istream & in)
+    {
+        std::streampos start = in.tellg();
+        char buffer[12];
+        bool found = static_cast<bool>(in.read(buffer, 12)) && has_magic(magic, buffer, 12);
+        in.clear();
+        in.seekg(start);
+        return found;
+    }
+
+    bool valid() const
+    {
+        return valid_;
+    }
+
+    // true if the index was built for a data file of this size,
+    // modification time and fingerprint, read with options of this hash
+    bool matches(std::uint64_t file_size, std::int64_t file_mtime, std::uint64_t file_hash,
+                 std::uint64_t options = 0) const
+    {
+        return valid_ && hdr_.file_size == file_size && hdr_.file_mtime == file_mtime &&
+            hdr_.file_hash == file_hash && hdr_.options == options;
+    }
+
+    std::size_t size() const
+    {
+        return valid_ ? static_cast<std::size_t>(hdr_.num_items) : 0;
+    }
+
+    box2d<double> extent() const
+    {
+        if (!valid_) return box2d<double>();
+        return box2d<double>(hdr_.extent[0], hdr_.extent[1], hdr_.extent[2], hdr_.extent[3]);
+    }
+
+    // attribute schema of the data, an empty list if it is damaged
+    std::vector<attribute_descriptor> schema() const
+    {
+        std::vector<attribute_descriptor> descriptors;
+        if (!valid_) return descriptors;
+        std::vector<char> buffer(static_cast<std::size_t>(hdr_.schema_size));
+        if (!fetch(schema_start(), buffer.data(), buffer.size())) return descriptors;
+        char const* itr = buffer.data();
+        char const* end = itr + buffer.size();
+        while (end - itr >= 8)
+        {
+            std::uint32_t type = get_uint32(itr);
+            std::uint32_t length = get_uint32(itr + 4);
+            itr += 8;
+            if (static_cast<std::uint64_t>(end - itr) < length) return {};
+            descriptors.emplace_back(std::string(itr, length), type);
+            itr += length;
+        }
+        if (itr != end) return {};
+        return descriptors;
+    }
+
+    // Calls visitor(box, first, second) for each item whose box
+    // intersects box, until the visitor returns false. Returns false if
+    // the index could not be read or an item pointing outside of the data
+    // file was found.
+    template <typename Visitor>
+    bool query(box2d<double> const& box, Visitor && visitor) const
+    {
+        return search(box_filter{ box }, visitor);
+    }
+
+    // Same for the items whose box passes filter, e.g. a mapnik::filter_in_box;
+    // so do the boxes of all nodes above them.
+    template <typename Filter, typename Visitor>
+    bool search(Filter const& filter, Visitor && visitor) const
+    {
+        if (!valid_) return false;
+        if (hdr_.num_items == 0) return true;
+        double root[4];
+        std::size_t root_node = static_cast<std::size_t>(num_nodes_ - 1);
+        if (!read_boxes(root_node, 1, root)) return false;
+        if (!filter.pass(box2d<double>(root[0], root[1], root[2], root[3]))) return true;
+        bool stop = false;
+        if (level_bounds_.size() == 1)
+        {
+            // a single item is its own root
+            return visit_items(root_node, 1, root, filter, visitor, stop);
+        }
+        return visit(filter, level_bounds_.size() - 1, root_node, visitor, stop);
+    }
+
+    static void write(std::ostream & out, char const* magic,
+                      packed_rtree<item_type> const& tree,
+                      box2d<double> const& extent,
+                      std::vector<attribute_descriptor> const& schema,
+                      std::uint64_t file_size, std::int64_t file_mtime,
+                      std::uint64_t file_hash, std::uint64_t options = 0)
+    {
+        std::string schema_data;
+        for (auto const& desc : schema)
+        {
+            put_uint32(schema_data, static_cast<std::uint32_t>(desc.get_type()));
+            put_uint32(schema_data, static_cast<std::uint32_t>(desc.get_name().size()));
+            schema_data.append(desc.get_name());
+        }
+
+        std::string data(magic, 12);
+        put_uint32(data, version);
+        put_uint32(data, static_cast<std::uint32_t>(tree.node_size()));
+        put_uint32(data, static_cast<std::uint32_t>(tree.level_bounds().size()));
+        put_uint64(data, tree.size());
+        put_uint64(data, file_size);
+        put_uint64(data, static_cast<std::uint64_t>(file_mtime));
+        put_uint64(data, file_hash);
+        put_double(data, extent.minx());
+        put_double(data, extent.miny());
+        put_double(data, extent.maxx());
+        put_double(data, extent.maxy());
+        put_uint64(data, schema_data.size());
+        put_uint64(data, options);
+        for (std::size_t bound : tree.level_bounds())
+        {
+            put_uint64(data, bound);
+        }
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        // nodes and items are written in chunks, there may be millions
+        data.clear();
+        for (auto const& node : tree.boxes())
+        {
+            put_double(data, node.minx);
+            put_double(data, node.miny);
+            put_double(data, node.maxx);
+            put_double(data, node.maxy);
+            if (data.size() >= 65536) flush(out, data);
+        }
+        for (auto const& item : tree.items())
+        {
+            put_uint64(data, item.first);
+            put_uint64(data, item.second);
+            if (data.size() >= 65536) flush(out, data);
+        }
+        flush(out, data);
+        out.write(schema_data.data(), static_cast<std::streamsize>(schema_data.size()));
+    }
+
+private:
+    struct box_filter
+    {
+        bool pass(box2d<double> const& b) const { return b.intersects(box); }
+        box2d<double> const& box;
+    };
+
+    static std::uint32_t get_uint32(char const* data)
+    {
+        unsigned char const* b = reinterpret_cast<unsigned char const*>(data);
+        return static_cast<std::uint32_t>(b[0]) | static_cast<std::uint32_t>(b[1]) << 8 |
+            static_cast<std::uint32_t>(b[2]) << 16 | static_cast<std::uint32_t>(b[3]) << 24;
+    }
+
+    static std::uint64_t get_uint64(char const* data)
+    {
+        return static_cast<std::uint64_t>(get_uint32(data)) |
+            static_cast<std::uint64_t>(get_uint32(data + 4)) << 32;
+    }
+
+    static double get_double(char const* data)
+    {
+        std::uint64_t bits = get_uint64(data);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static void put_uint32(std::string & out, std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+
+    static void put_uint64(std::string & out, std::uint64_t value)
+    {
+        put_uint32(out, static_cast<std::uint32_t>(value));
+        put_uint32(out, static_cast<std::uint32_t>(value >> 32));
+    }
+
+    static void put_double(std::string & out, double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put_uint64(out, bits);
+    }
+
+    static void flush(std::ostream & out, std::string & data)
+    {
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        data.clear();
+    }
+
+    static bool parse_header(char const* magic, char const* data, header & hdr)
+    {
+        std::memcpy(hdr.magic, data, 12);
+        hdr.version = get_uint32(data + 12);
+        hdr.node_size = get_uint32(data + 16);
+        hdr.num_levels = get_uint32(data + 20);
+        hdr.num_items = get_uint64(data + 24);
+        hdr.file_size = get_uint64(data + 32);
+        hdr.file_mtime = static_cast<std::int64_t>(get_uint64(data + 40));
+        hdr.file_hash = get_uint64(data + 48);
+        for (std::size_t i = 0; i < 4; ++i) hdr.extent[i] = get_double(data + 56 + i * 8);
+        hdr.schema_size = get_uint64(data + 88);
+        hdr.options = get_uint64(data + 96);
+        return std::memcmp(hdr.magic, magic, 12) == 0 && hdr.version == version;
+    }
+
+    // Validates the header and every level bound against the tree shape
+    // implied by num_items and node_size, and the sections against the size.
+    void init(char const* magic)
+    {
+        char buffer[header_size];
+        if (size_ < header_size || !fetch(0, buffer, header_size)) return;
+        if (!parse_header(magic, buffer, hdr_)) return;
+        if (hdr_.node_size < 2 || hdr_.num_items > size_ / 48 || hdr_.schema_size > size_) return;
+        std::vector<std::uint64_t> expected;
+        if (hdr_.num_items > 0)
+        {
+            std::uint64_t n = hdr_.num_items;
+            expected.push_back(n);
+            while (n > 1)
+            {
+                n = (n + hdr_.node_size - 1) / hdr_.node_size;
+                expected.push_back(expected.back() + n);
+            }
+        }
+        if (hdr_.num_levels != expected.size()) return;
+        num_nodes_ = expected.empty() ? 0 : expected.back();
+        std::uint64_t required = header_size + expected.size() * 8 + num_nodes_ * 32 +
+            hdr_.num_items * 16 + hdr_.schema_size;
+        if (size_ < required) return;
+        std::vector<char> bounds(expected.size() * 8);
+        if (!fetch(header_size, bounds.data(), bounds.size())) return;
+        for (std::size_t level = 0; level < expected.size(); ++level)
+        {
+            if (get_uint64(bounds.data() + level * 8) != expected[level]) return;
+        }
+        level_bounds_.assign(expected.begin(), expected.end());
+        valid_ = true;
+    }
+
+    std::uint64_t nodes_start() const
+    {
+        return header_size + level_bounds_.size() * 8;
+    }
+
+    std::uint64_t items_start() const
+    {
+        return nodes_start() + num_nodes_ * 32;
+    }
+
+    std::uint64_t schema_start() const
+    {
+        return items_start() + hdr_.num_items * 16;
+    }
+
+    bool fetch(std::uint64_t offset, char * dest, std::size_t size) const
+    {
+        if (offset > size_ || size > size_ - offset) return false;
+        if (data_)
+        {
+            std::memcpy(dest, data_ + offset, size);
+            return true;
+        }
+        in_->clear();
+        in_->seekg(static_cast<std::streamoff>(base_ + offset), std::ios::beg);
+        return static_cast<bool>(in_->read(dest, static_cast<std::streamsize>(size)));
+    }
+
+    bool read_boxes(std::size_t first, std::size_t count, double * boxes) const
+    {
+        std::vector<char> buffer(count * 32);
+        if (!fetch(nodes_start() + first * 32, buffer.data(), buffer.size())) return false;
+        for (std::size_t i = 0; i < count * 4; ++i) boxes[i] = get_double(buffer.data() + i * 8);
+        return true;
+    }
+
+    std::size_t level_start(std::size_t level) const
+    {
+        return level == 0 ? 0 : static_cast<std::size_t>(level_bounds_[level - 1]);
+    }
+
+    // leaves first to first + count with their boxes, hands the items of
+    // those passing the filter to the visitor
+    template <typename Filter, typename Visitor>
+    bool visit_items(std::size_t first, std::size_t count, double const* boxes,
+                     Filter const& filter, Visitor & visitor, bool & stop) const
+    {
+        std::vector<char> items(count * 16);
+        if (!fetch(items_start() + first * 16, items.data(), items.size())) return false;
+        for (std::size_t i = 0; i < count && !stop; ++i)
+        {
+            double const* b = boxes + i * 4;
+            box2d<double> box(b[0], b[1], b[2], b[3]);
+            if (!filter.pass(box)) continue;
+            std::uint64_t offset = get_uint64(items.data() + i * 16);
+            std::uint64_t second = get_uint64(items.data() + i * 16 + 8);
+            if (offset >= hdr_.file_size) return false;
+            if (kind_ == offset_and_size && second > hdr_.file_size - offset) return false;
+            stop = !visitor(box, offset, second);
+        }
+        return true;
+    }
+
+    // node passed the filter, reads and filters its children in one go
+    template <typename Filter, typename Visitor>
+    bool visit(Filter const& filter, std::size_t level, std::size_t node,
+               Visitor & visitor, bool & stop) const
+    {
+        std::size_t node_size = hdr_.node_size;
+        std::size_t first = level_start(level - 1) + (node - level_start(level)) * node_size;
+        std::size_t last = std::min(first + node_size, static_cast<std::size_t>(level_bounds_[level - 1]));
+        if (first >= last) return false;
+        std::size_t count = last - first;
+        std::vector<double> boxes(count * 4);
+        if (!read_boxes(first, count, boxes.data())) return false;
+        if (level == 1) return visit_items(first, count, boxes.data(), filter, visitor, stop);
+        for (std::size_t i = 0; i < count && !stop; ++i)
+        {
+            double const* b = boxes.data() + i * 4;
+            if (!filter.pass(box2d<double>(b[0], b[1], b[2], b[3]))) continue;
+            if (!visit(filter, level - 1, first + i, visitor, stop)) return false;
+        }
+        return true;
+    }
+
+    char const* data_;
+    std::istream * in_;
+    std::uint64_t base_;
+    std::uint64_t size_;
+    header hdr_;
+    std::vector<std::uint64_t> level_bounds_;
+    std::uint64_t num_nodes_;
+    item_kind kind_;
+    bool valid_;
+};
+
+}
+
+#endif // MAPNIK_PACKED_INDEX_FILE_HPP
@@ -0,0 +1,251 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_PACKED_RTREE_HPP
+#define MAPNIK_PACKED_RTREE_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace mapnik {
+
+namespace detail {
+
+// position of (x, y) on a 16 bit hilbert curve
+inline std::uint32_t hilbert_index(std::uint32_t x, std::uint32_t y)
+{
+    std::uint32_t a = x ^ y;
+    std::uint32_t b = 0xFFFF ^ a;
+    std::uint32_t c = 0xFFFF ^ (x | y);
+    std::uint32_t d = x & (y ^ 0xFFFF);
+
+    std::uint32_t A = a | (b >> 1);
+    std::uint32_t B = (a >> 1) ^ a;
+    std::uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    std::uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    std::uint32_t i0 = x ^ y;
+    std::uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+}
+
+// Static R-tree bulk loaded in hilbert order of the item centers. Nodes
+// are stored level by level in one flat array, leaves first, and the
+// children of a node are found by position so no child pointers are
+// stored. Queries do not allocate or modify the tree and may run
+// concurrently from any number of threads.
+template <typename T>
+class packed_rtree
+{
+public:
+    using value_type = T;
+    using item_type = std::pair<box2d<double>, T>;
+
+    struct node_box
+    {
+        double minx;
+        double miny;
+        double maxx;
+        double maxy;
+
+        bool intersects(node_box const& other) const
+        {
+            return !(other.minx > maxx || other.maxx < minx ||
+                     other.miny > maxy || other.maxy < miny);
+        }
+    };
+
+    packed_rtree()
+        : node_size_(16) {}
+
+    explicit packed_rtree(std::vector<item_type> items, std::size_t node_size = 16)
+        : node_size_(std::max<std::size_t>(node_size, 2))
+    {
+        build(items);
+    }
+
+    // Calls visitor(item) for each item whose box intersects box, until
+    // the visitor returns false. Returns false when stopped early.
+    template <typename Visitor>
+    bool query(box2d<double> const& box, Visitor && visitor) const
+    {
+        if (items_.empty()) return true;
+        node_box query_box = { box.minx(), box.miny(), box.maxx(), box.maxy() };
+        std::size_t root = boxes_.size() - 1;
+        if (!query_box.intersects(boxes_[root])) return true;
+        return visit(level_bounds_.size() - 1, root, query_box, visitor);
+    }
+
+    box2d<double> extent() const
+    {
+        if (boxes_.empty()) return box2d<double>();
+        node_box const& root = boxes_.back();
+        return box2d<double>(root.minx, root.miny, root.maxx, root.maxy);
+    }
+
+    std::size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+    std::size_t node_size() const { return node_size_; }
+
+    // items in hilbert order, their boxes are the first size() node boxes
+    std::vector<T> const& items() const { return items_; }
+    std::vector<node_box> const& boxes() const { return boxes_; }
+    // end of each level in boxes(), from the leaves up to the root
+    std::vector<std::size_t> const& level_bounds() const { return level_bounds_; }
+
+private:
+    void build(std::vector<item_type> & items)
+    {
+        std::size_t num_items = items.size();
+        if (num_items == 0) return;
+
+        box2d<double> ext = items.front().first;
+        for (auto const& item : items) ext.expand_to_include(item.first);
+        double width = ext.width() > 0 ? ext.width() : 1.0;
+        double height = ext.height() > 0 ? ext.height() : 1.0;
+
+        std::vector<std::uint32_t> keys;
+        keys.reserve(num_items);
+        for (auto const& item : items)
+        {
+            box2d<double> const& b = item.first;
+            // clamped, the center of an invalid box may be outside the extent
+            double cx = std::min(std::max(((b.minx() + b.maxx()) / 2 - ext.minx()) / width, 0.0), 1.0);
+            double cy = std::min(std::max(((b.miny() + b.maxy()) / 2 - ext.miny()) / height, 0.0), 1.0);
+            keys.push_back(detail::hilbert_index(static_cast<std::uint32_t>(cx * 0xFFFF),
+                                                 static_cast<std::uint32_t>(cy * 0xFFFF)));
+        }
+        std::vector<std::size_t> order(num_items);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&keys](std::size_t lhs, std::size_t rhs) { return keys[lhs] < keys[rhs]; });
+
+        std::size_t num_nodes = num_items;
+        for (std::size_t n = num_items; n > 1; )
+        {
+            n = (n + node_size_ - 1) / node_size_;
+            num_nodes += n;
+        }
+        boxes_.reserve(num_nodes);
+        items_.reserve(num_items);
+        for (std::size_t index : order)
+        {
+            box2d<double> const& b = items[index].first;
+            boxes_.push_back(node_box{ b.minx(), b.miny(), b.maxx(), b.maxy() });
+            items_.push_back(std::move(items[index].second));
+        }
+        level_bounds_.push_back(num_items);
+
+        std::size_t level_start = 0;
+        while (boxes_.size() - level_start > 1)
+        {
+            std::size_t level_end = boxes_.size();
+            for (std::size_t i = level_start; i < level_end; i += node_size_)
+            {
+                node_box b = boxes_[i];
+                std::size_t last = std::min(i + node_size_, level_end);
+                for (std::size_t j = i + 1; j < last; ++j)
+                {
+                    node_box const& child = boxes_[j];
+                    b.minx = std::min(b.minx, child.minx);
+                    b.miny = std::min(b.miny, child.miny);
+                    b.maxx = std::max(b.maxx, child.maxx);
+                    b.maxy = std::max(b.maxy, child.maxy);
+                }
+                boxes_.push_back(b);
+            }
+            level_bounds_.push_back(boxes_.size());
+            level_start = level_end;
+        }
+    }
+
+    std::size_t level_start(std::size_t level) const
+    {
+        return level == 0 ? 0 : level_bounds_[level - 1];
+    }
+
+    // recursion depth is the height of the tree
+    template <typename Visitor>
+    bool visit(std::size_t level, std::size_t node, node_box const& box, Visitor & visitor) const
+    {
+        if (level == 0) return visitor(items_[node]);
+        std::size_t first = level_start(level - 1) + (node - level_start(level)) * node_size_;
+        std::size_t last = std::min(first + node_size_, level_bounds_[level - 1]);
+        for (std::size_t child = first; child < last; ++child)
+        {
+            if (box.intersects(boxes_[child]) && !visit(level - 1, child, box, visitor))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::size_t node_size_;
+    std::vector<node_box> boxes_;
+    std::vector<T> items_;
+    std::vector<std::size_t> level_bounds_;
+};
+
+}
+
+#endif // MAPNIK_PACKED_RTREE_HPP
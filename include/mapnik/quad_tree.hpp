@@ -119,6 +119,15 @@ public:
         return query_result_.end();
     }
 
+    // Calls visitor(item) for the items of the nodes intersecting box until
+    // it returns false. Unlike query_in_box this does not allocate and may
+    // run concurrently with other queries.
+    template <typename Visitor>
+    bool visit_in_box(box2d<double> const& box, Visitor && visitor) const
+    {
+        return visit_node(box, visitor, root_);
+    }
+
     const_iterator begin() const
     {
         return nodes_.begin();
@@ -164,6 +173,23 @@ private:
         }
     }
 
+    template <typename Visitor>
+    bool visit_node(box2d<double> const& box, Visitor & visitor, node const* node_) const
+    {
+        if (node_ && box.intersects(node_->extent()))
+        {
+            for (auto const& n : *node_)
+            {
+                if (!visitor(n)) return false;
+            }
+            for (int k = 0; k < 4; ++k)
+            {
+                if (!visit_node(box, visitor, node_->children_[k])) return false;
+            }
+        }
+        return true;
+    }
+
     void do_insert_data(T data, box2d<double> const& box, node * n, unsigned int& depth)
     {
         if (++depth >= max_depth_)
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_RENDER_STATS_HPP
+#define MAPNIK_RENDER_STATS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mapnik {
+
+// Statistics collected by feature_style_processor when a render_stats
+// object is handed to set_stats(). All times are wall clock milliseconds.
+
+struct style_stats
+{
+    std::string name;
+    // spent waiting for the first feature of the style's featureset
+    double first_feature_time = 0.0;
+    // total time spent rendering the style, compositing included
+    double render_time = 0.0;
+    // style comp-op and image filters
+    double compositing_time = 0.0;
+    std::size_t features_fetched = 0;
+    std::size_t filters_evaluated = 0;
+    std::size_t features_painted = 0;
+    // symbolizer type name -> time spent in its renderer
+    std::map<std::string, double> symbolizer_times;
+};
+
+struct layer_stats
+{
+    std::string name;
+    // spent in datasource::features(), by the prefetch worker for
+    // prefetched layers
+    double query_time = 0.0;
+    // total time spent rendering the layer, compositing included
+    double render_time = 0.0;
+    // layer comp-op and opacity
+    double compositing_time = 0.0;
+    std::vector<style_stats> styles;
+};
+
+// Layers are appended in rendering order by every apply() call.
+struct render_stats
+{
+    std::vector<layer_stats> layers;
+
+    void clear() { layers.clear(); }
+};
+
+MAPNIK_DECL std::string to_json(render_stats const& stats);
+
+}
+
+#endif // MAPNIK_RENDER_STATS_HPP
@@ -27,6 +27,7 @@
 #include <mapnik/config.hpp>
 #include <mapnik/symbolizer_base.hpp>
 #include <mapnik/expression.hpp>
+#include <mapnik/expression_program.hpp>
 
 // stl
 #include <string>
@@ -46,6 +47,7 @@ private:
     double max_scale_;
     symbolizers syms_;
     expression_ptr filter_;
+    expression_program filter_program_;
     bool else_filter_;
     bool also_filter_;
 
@@ -73,6 +75,8 @@ public:
     symbolizers::iterator end();
     void set_filter(expression_ptr const& filter);
     expression_ptr const& get_filter() const;
+    // filter compiled by set_filter, for fast per feature evaluation
+    expression_program const& get_filter_program() const;
     void set_else(bool else_filter);
     bool has_else_filter() const;
     void set_also(bool also_filter);
@@ -24,29 +24,50 @@
 #define MAPNIK_RULE_CACHE_HPP
 
 // mapnik
+#include <mapnik/config.hpp>
 #include <mapnik/rule.hpp>
+#include <mapnik/value.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
 // stl
+#include <cstddef>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <type_traits>
 
 namespace mapnik
 {
 
-class rule_cache : private util::noncopyable
+class feature_impl;
+
+class MAPNIK_DECL rule_cache : private util::noncopyable
 {
 public:
     using rule_ptrs = std::vector<rule const*>;
+    using rule_indices = std::vector<std::size_t>;
+    // fewest rules dispatching on one attribute worth an index
+    static constexpr std::size_t min_indexed_rules = 4;
+
     rule_cache()
         : if_rules_(),
           else_rules_(),
-          also_rules_() {}
+          also_rules_(),
+          all_rules_(),
+          index_key_(),
+          unkeyed_rules_(),
+          string_rules_(),
+          number_rules_() {}
 
     rule_cache(rule_cache && rhs) // move ctor
         :  if_rules_(std::move(rhs.if_rules_)),
            else_rules_(std::move(rhs.else_rules_)),
-           also_rules_(std::move(rhs.also_rules_))
+           also_rules_(std::move(rhs.also_rules_)),
+           all_rules_(std::move(rhs.all_rules_)),
+           index_key_(std::move(rhs.index_key_)),
+           unkeyed_rules_(std::move(rhs.unkeyed_rules_)),
+           string_rules_(std::move(rhs.string_rules_)),
+           number_rules_(std::move(rhs.number_rules_))
     {}
 
     rule_cache& operator=(rule_cache && rhs) // move assign
@@ -54,6 +75,11 @@ public:
         std::swap(if_rules_, rhs.if_rules_);
         std::swap(else_rules_,rhs.else_rules_);
         std::swap(also_rules_, rhs.also_rules_);
+        std::swap(all_rules_, rhs.all_rules_);
+        std::swap(index_key_, rhs.index_key_);
+        std::swap(unkeyed_rules_, rhs.unkeyed_rules_);
+        std::swap(string_rules_, rhs.string_rules_);
+        std::swap(number_rules_, rhs.number_rules_);
         return *this;
     }
 
@@ -69,6 +95,7 @@ public:
         }
         else
         {
+            all_rules_.push_back(if_rules_.size());
             if_rules_.push_back(&r);
         }
     }
@@ -88,10 +115,42 @@ public:
         return also_rules_;
     }
 
+    // Index the if-rules by the attribute most of their filters test for
+    // equality with a literal, either as the whole filter or as one of
+    // its top level 'and' operands. Call once all rules are added.
+    void build_index();
+
+    // attribute the index dispatches on, empty when there is no index
+    std::string const& index_key() const
+    {
+        return index_key_;
+    }
+
+    // Positions in get_if_rules() of the rules whose filter can match the
+    // feature, in rule order. Rules left out cannot match it, so testing
+    // only these gives the same result as testing all of them, for
+    // FILTER_FIRST as well as for else and also rules.
+    rule_indices const& candidates(feature_impl const& feature) const;
+
 private:
+    struct string_hash
+    {
+        std::size_t operator() (value_unicode_string const& str) const
+        {
+            return static_cast<std::size_t>(str.hashCode());
+        }
+    };
+
     rule_ptrs if_rules_;
     rule_ptrs else_rules_;
     rule_ptrs also_rules_;
+    rule_indices all_rules_;
+    std::string index_key_;
+    // rules without a key, to be tested for every feature
+    rule_indices unkeyed_rules_;
+    // rules keyed by a literal, merged in order with the unkeyed ones
+    std::unordered_map<value_unicode_string, rule_indices, string_hash> string_rules_;
+    std::unordered_map<value_double, rule_indices> number_rules_;
 };
 
 }
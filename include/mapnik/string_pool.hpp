@@ -0,0 +1,72 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_STRING_POOL_HPP
+#define MAPNIK_STRING_POOL_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/value_types.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// boost
+#include <boost/utility/string_ref.hpp>
+// icu
+#include <unicode/unistr.h>
+
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace mapnik {
+
+// Transcodes strings through a transcoder, returning the same string for
+// repeated input. ICU shares the buffer of a long string between copies,
+// so attribute values repeated across features are stored once and only
+// converted the first time they are seen. Lookups do not allocate; once
+// `max_strings` distinct strings are pooled new ones are just transcoded.
+// Not thread safe; meant to live next to the context of the features it fills.
+class MAPNIK_DECL string_pool : private util::noncopyable
+{
+public:
+    explicit string_pool(transcoder const& tr, std::size_t max_strings = 65536);
+    mapnik::value_unicode_string intern(const char* data, std::int32_t length = -1);
+    std::size_t size() const { return strings_.size(); }
+private:
+    struct key_hash
+    {
+        std::size_t operator()(boost::string_ref const& key) const;
+    };
+    transcoder const& tr_;
+    std::size_t max_strings_;
+    // owns the bytes the map keys point to
+    std::deque<std::string> keys_;
+    std::unordered_map<boost::string_ref, mapnik::value_unicode_string, key_hash> strings_;
+};
+
+}
+
+#endif // MAPNIK_STRING_POOL_HPP
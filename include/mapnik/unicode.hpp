@@ -44,6 +44,11 @@ public:
     ~transcoder();
 private:
     UConverter * conv_;
+    // UTF-8 input is converted directly, skipping the generic converter
+    bool utf8_;
+    // the encoding maps 7-bit bytes to ASCII, so pure ASCII input is
+    // converted directly as well
+    bool ascii_;
 };
 }
 
@@ -27,6 +27,8 @@
 #include <mapnik/config.hpp>
 
 // stl
+#include <cstdint>
+#include <ctime>
 #include <string>
 #include <vector>
 
@@ -36,6 +38,11 @@ MAPNIK_DECL bool exists(std::string const& value);
 MAPNIK_DECL bool is_directory(std::string const& value);
 MAPNIK_DECL bool is_regular_file(std::string const& value);
 MAPNIK_DECL bool remove(std::string const& value);
+MAPNIK_DECL void rename(std::string const& from, std::string const& to);
+MAPNIK_DECL std::uintmax_t file_size(std::string const& value);
+MAPNIK_DECL std::time_t last_write_time(std::string const& value);
+// hash of the size and sampled contents of a file, see fs.cpp
+MAPNIK_DECL std::uint64_t file_fingerprint(std::string const& value);
 MAPNIK_DECL bool is_relative(std::string const& value);
 MAPNIK_DECL std::string make_relative(std::string const& filepath, std::string const& base);
 MAPNIK_DECL std::string make_absolute(std::string const& filepath, std::string const& base);
@@ -24,6 +24,7 @@
 #define MAPNIK_VERTEX_ADAPTERS_HPP
 
 #include <mapnik/geometry.hpp>
+#include <mapnik/geometry_flat.hpp>
 #include <mapnik/geometry_types.hpp>
 #include <mapnik/vertex.hpp>
 
@@ -233,6 +234,74 @@ private:
     mutable bool start_loop_;
 };
 
+// Vertices of one part of a flat geometry, emitted the same way as by the
+// point, line string and polygon adapters above.
+template <typename T>
+struct flat_vertex_adapter
+{
+    using value_type = typename point<T>::value_type;
+    flat_vertex_adapter(flat_geometry<T> const& geom, std::size_t part)
+        : geom_(geom),
+          type_(geom.part_type()),
+          part_(part)
+    {
+        rewind(0);
+    }
+
+    void rewind(unsigned) const
+    {
+        rings_itr_ = geom_.part_begin(part_);
+        rings_end_ = geom_.part_end(part_);
+        start_index_ = current_index_ = (rings_itr_ < rings_end_) ? geom_.ring_begin(rings_itr_) : 0;
+        end_index_ = (rings_itr_ < rings_end_) ? geom_.ring_end(rings_itr_) : 0;
+    }
+
+    unsigned vertex(value_type * x, value_type * y) const
+    {
+        while (rings_itr_ < rings_end_)
+        {
+            if (current_index_ < end_index_)
+            {
+                point<T> const& coord = geom_[current_index_++];
+                *x = coord.x;
+                *y = coord.y;
+                if (current_index_ == start_index_ + 1)
+                {
+                    return mapnik::SEG_MOVETO;
+                }
+                if (type_ == geometry_types::Polygon && current_index_ == end_index_)
+                {
+                    *x = 0;
+                    *y = 0;
+                    return mapnik::SEG_CLOSE;
+                }
+                return mapnik::SEG_LINETO;
+            }
+            if (++rings_itr_ < rings_end_)
+            {
+                start_index_ = current_index_ = geom_.ring_begin(rings_itr_);
+                end_index_ = geom_.ring_end(rings_itr_);
+            }
+        }
+        return mapnik::SEG_END;
+    }
+
+    inline geometry_types type () const
+    {
+        return type_;
+    }
+
+private:
+    flat_geometry<T> const& geom_;
+    geometry_types type_;
+    std::size_t part_;
+    mutable std::size_t rings_itr_;
+    mutable std::size_t rings_end_;
+    mutable std::size_t start_index_;
+    mutable std::size_t current_index_;
+    mutable std::size_t end_index_;
+};
+
 template <typename T>
 struct vertex_adapter_traits {};
 
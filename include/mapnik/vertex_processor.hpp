@@ -95,6 +95,16 @@ struct vertex_processor
         }
     }
 
+    template <typename T1>
+    void operator() (flat_geometry<T1> const& geom)
+    {
+        for (std::size_t part = 0; part < geom.num_parts(); ++part)
+        {
+            flat_vertex_adapter<T1> va(geom, part);
+            proc_(va);
+        }
+    }
+
     template <typename T1>
     void operator() (geometry_collection<T1> const& collection)
     {
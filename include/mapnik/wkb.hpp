@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/geometry.hpp>
+#include <mapnik/geometry_flat.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
 namespace mapnik
@@ -62,6 +63,18 @@ public:
     static mapnik::geometry::geometry<double> from_wkb(const char* wkb,
                                                        std::size_t size,
                                                        wkbFormat format = wkbGeneric);
+
+    // Decodes into flat storage, returns false for geometry collections
+    // and malformed input.
+    static bool from_wkb(const char* wkb,
+                         std::size_t size,
+                         mapnik::geometry::flat_geometry<double> & geom,
+                         wkbFormat format = wkbGeneric);
+
+    // Tiny WKB as returned by PostGIS ST_AsTWKB, malformed input yields
+    // an empty geometry.
+    static mapnik::geometry::geometry<double> from_twkb(const char* twkb,
+                                                        std::size_t size);
 };
 
 }
@@ -21,7 +21,7 @@
  *****************************************************************************/
 
 #include "csv_datasource.hpp"
-#include "csv_utils.hpp"
+#include "csv_featureset.hpp"
 
 // boost
 #include <boost/tokenizer.hpp>
@@ -31,19 +31,28 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/util/utf_conv_win.hpp>
 #include <mapnik/unicode.hpp>
+#include <mapnik/string_pool.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/geometry.hpp>
 #include <mapnik/geometry_correct.hpp>
 #include <mapnik/memory_featureset.hpp>
-#include <mapnik/wkt/wkt_factory.hpp>
-#include <mapnik/json/geometry_parser.hpp>
-#include <mapnik/util/conversions.hpp>
+#include <mapnik/featureset_prefetch.hpp>
 #include <mapnik/boolean.hpp>
 #include <mapnik/util/trim.hpp>
+#include <mapnik/util/fs.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
 #include <mapnik/value_types.hpp>
 
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wshadow"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#include <boost/interprocess/mapped_region.hpp>
+#pragma GCC diagnostic pop
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
 // stl
 #include <sstream>
 #include <fstream>
@@ -51,10 +60,106 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <random>
+#ifdef MAPNIK_THREADSAFE
+#include <thread>
+#endif
 
 using mapnik::datasource;
 using mapnik::parameters;
 
+namespace {
+
+// FNV-1a
+std::uint64_t options_hash(std::string const& options)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char c : options)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+mapnik::value_integer default_parse_threads()
+{
+#ifdef MAPNIK_THREADSAFE
+    return static_cast<mapnik::value_integer>(std::thread::hardware_concurrency());
+#else
+    return 1;
+#endif
+}
+
+// Consecutive rows of a file, parsed together on one thread.
+struct csv_chunk
+{
+    // rows are handed to a parser once about this many bytes are read
+    static const std::size_t max_bytes = 1024 * 1024;
+
+    void add(std::string const& line, std::uint64_t offset, int line_number)
+    {
+        lines.push_back(line);
+        offsets.push_back(offset);
+        line_numbers.push_back(line_number);
+        bytes += line.size();
+    }
+
+    // Parses the rows, keeping the features only if keep_features is set
+    // and otherwise just their attribute types for the first one. Ids are
+    // local to the chunk, they are set when the chunks are merged.
+    void parse(std::shared_ptr<csv_row_parser const> const& parser,
+               mapnik::context_ptr const& ctx,
+               std::string const& encoding,
+               bool keep_features)
+    {
+        mapnik::transcoder tr(encoding);
+        // share repeated string values between the features of the chunk
+        mapnik::string_pool strings(tr);
+        bool first_feature = true;
+        for (std::size_t i = 0; i < lines.size(); ++i)
+        {
+            mapnik::value_integer id = static_cast<mapnik::value_integer>(i + 1);
+            mapnik::feature_ptr feature;
+            if (first_feature)
+            {
+                mapnik::layer_descriptor row_desc(csv_datasource::name(), encoding);
+                feature = parser->parse(lines[i], line_numbers[i], id, ctx, mapnik::feature_arena_ptr(),
+                                        strings, true, &row_desc);
+                if (feature)
+                {
+                    descriptors = row_desc.get_descriptors();
+                    first_feature = false;
+                }
+            }
+            else
+            {
+                feature = parser->parse(lines[i], line_numbers[i], id, ctx, mapnik::feature_arena_ptr(),
+                                        strings, keep_features, nullptr);
+            }
+            if (!feature) continue;
+            rows.emplace_back(feature->envelope(), offsets[i]);
+            if (keep_features) features.push_back(feature);
+        }
+        std::vector<std::string>().swap(lines);
+    }
+
+    std::vector<std::string> lines;
+    std::vector<std::uint64_t> offsets;
+    std::vector<int> line_numbers;
+    std::size_t bytes = 0;
+
+    // envelope and offset of each parsed feature
+    std::vector<std::pair<mapnik::box2d<double>, std::uint64_t> > rows;
+    std::vector<mapnik::feature_ptr> features;
+    std::vector<mapnik::attribute_descriptor> descriptors;
+};
+
+}
+
 DATASOURCE_PLUGIN(csv_datasource)
 
 csv_datasource::csv_datasource(parameters const& params)
@@ -73,18 +178,14 @@ csv_datasource::csv_datasource(parameters const& params)
     manual_headers_(mapnik::util::trim_copy(*params.get<std::string>("headers", ""))),
     strict_(*params.get<mapnik::boolean_type>("strict", false)),
     filesize_max_(*params.get<double>("filesize_max", 20.0)),  // MB
+    parse_threads_(*params.get<mapnik::value_integer>("parse_threads", default_parse_threads())),
     ctx_(std::make_shared<mapnik::context_type>()),
     extent_initialized_(false)
 {
     /* TODO:
        general:
-       - refactor parser into generic class
        - tests of grid_renderer output
        - ensure that the attribute desc_ matches the first feature added
-       alternate large file pipeline:
-       - stat file, detect > 15 MB
-       - build up csv line-by-line iterator
-       - creates opportunity to filter attributes by map query
        speed:
        - add properties for wkt/json/lon/lat at parse time
        - add ability to pass 'filter' keyword to drop attributes at layer init
@@ -127,6 +228,8 @@ csv_datasource::csv_datasource(parameters const& params)
     }
     else
     {
+        // large files are read through a spatial index of their rows instead
+        cache_features_ = *params.get<mapnik::boolean_type>("cache_features", true);
 #if defined (_WINDOWS)
         std::ifstream in(mapnik::utf8_to_utf16(filename_),std::ios_base::in | std::ios_base::binary);
 #else
@@ -153,7 +256,7 @@ void csv_datasource::parse_csv(T & stream,
     stream.seekg(0, std::ios::end);
     file_length_ = stream.tellg();
 
-    if (filesize_max_ > 0)
+    if (cache_features_ && filesize_max_ > 0)
     {
         double file_mb = static_cast<double>(file_length_)/1048576;
 
@@ -162,7 +265,7 @@ void csv_datasource::parse_csv(T & stream,
         {
             std::ostringstream s;
             s << "CSV Plugin: csv file is greater than ";
-            s << filesize_max_ << "MB - you should use a more efficient data format like sqlite, postgis or a shapefile to render this data (set 'filesize_max=0' to disable this restriction if you have lots of memory)";
+            s << filesize_max_ << "MB - you should use a more efficient data format like sqlite, postgis or a shapefile to render this data (set 'filesize_max=0' to disable this restriction if you have lots of memory, or 'cache_features=false' to read it through a spatial index)";
             throw mapnik::datasource_exception(s.str());
         }
     }
@@ -240,8 +343,6 @@ void csv_datasource::parse_csv(T & stream,
     // set back to start
     stream.seekg(0, std::ios::beg);
 
-    using escape_type = boost::escaped_list_separator<char>;
-
     std::string esc = mapnik::util::trim_copy(escape);
     if (esc.empty()) esc = "\\";
 
@@ -251,11 +352,13 @@ void csv_datasource::parse_csv(T & stream,
     MAPNIK_LOG_DEBUG(csv) << "csv_datasource: csv grammar: sep: '" << sep
                           << "' quo: '" << quo << "' esc: '" << esc << "'";
 
-    boost::escaped_list_separator<char> grammer;
+    auto parser = std::make_shared<csv_row_parser>();
+    parser->newline = newline;
+    parser->quote = quo;
+    parser->strict = strict_;
     try
     {
-        //  grammer = boost::escaped_list_separator<char>('\\', ',', '\"');
-        grammer = boost::escaped_list_separator<char>(esc, sep, quo);
+        parser->grammar = csv_row_parser::escape_type(esc, sep, quo);
     }
     catch(std::exception const& ex)
     {
@@ -264,21 +367,13 @@ void csv_datasource::parse_csv(T & stream,
         throw mapnik::datasource_exception(s);
     }
 
-    using Tokenizer = boost::tokenizer< escape_type >;
+    using Tokenizer = csv_row_parser::tokenizer_type;
 
     int line_number = 1;
-    bool has_wkt_field = false;
-    bool has_json_field = false;
-    bool has_lat_field = false;
-    bool has_lon_field = false;
-    unsigned wkt_idx = 0;
-    unsigned json_idx = 0;
-    unsigned lat_idx = 0;
-    unsigned lon_idx = 0;
 
     if (!manual_headers_.empty())
     {
-        Tokenizer tok(manual_headers_, grammer);
+        Tokenizer tok(manual_headers_, parser->grammar);
         Tokenizer::iterator beg = tok.begin();
         unsigned idx = 0;
         for (; beg != tok.end(); ++beg)
@@ -289,13 +384,13 @@ void csv_datasource::parse_csv(T & stream,
             if (lower_val == "wkt"
                 || (lower_val.find("geom") != std::string::npos))
             {
-                wkt_idx = idx;
-                has_wkt_field = true;
+                parser->wkt_idx = idx;
+                parser->has_wkt_field = true;
             }
             if (lower_val == "geojson")
             {
-                json_idx = idx;
-                has_json_field = true;
+                parser->json_idx = idx;
+                parser->has_json_field = true;
             }
             if (lower_val == "x"
                 || lower_val == "lon"
@@ -303,15 +398,15 @@ void csv_datasource::parse_csv(T & stream,
                 || lower_val == "long"
                 || (lower_val.find("longitude") != std::string::npos))
             {
-                lon_idx = idx;
-                has_lon_field = true;
+                parser->lon_idx = idx;
+                parser->has_lon_field = true;
             }
             if (lower_val == "y"
                 || lower_val == "lat"
                 || (lower_val.find("latitude") != std::string::npos))
             {
-                lat_idx = idx;
-                has_lat_field = true;
+                parser->lat_idx = idx;
+                parser->has_lat_field = true;
             }
             ++idx;
             headers_.push_back(val);
@@ -323,7 +418,7 @@ void csv_datasource::parse_csv(T & stream,
         {
             try
             {
-                Tokenizer tok(csv_line, grammer);
+                Tokenizer tok(csv_line, parser->grammar);
                 Tokenizer::iterator beg = tok.begin();
                 std::string val;
                 if (beg != tok.end())
@@ -368,13 +463,13 @@ void csv_datasource::parse_csv(T & stream,
                             if (lower_val == "wkt"
                                 || (lower_val.find("geom") != std::string::npos))
                             {
-                                wkt_idx = idx;
-                                has_wkt_field = true;
+                                parser->wkt_idx = idx;
+                                parser->has_wkt_field = true;
                             }
                             if (lower_val == "geojson")
                             {
-                                json_idx = idx;
-                                has_json_field = true;
+                                parser->json_idx = idx;
+                                parser->has_json_field = true;
                             }
                             if (lower_val == "x"
                                 || lower_val == "lon"
@@ -382,15 +477,15 @@ void csv_datasource::parse_csv(T & stream,
                                 || lower_val == "long"
                                 || (lower_val.find("longitude") != std::string::npos))
                             {
-                                lon_idx = idx;
-                                has_lon_field = true;
+                                parser->lon_idx = idx;
+                                parser->has_lon_field = true;
                             }
                             if (lower_val == "y"
                                 || lower_val == "lat"
                                 || (lower_val.find("latitude") != std::string::npos))
                             {
-                                lat_idx = idx;
-                                has_lat_field = true;
+                                parser->lat_idx = idx;
+                                parser->has_lat_field = true;
                             }
                             headers_.push_back(val);
                         }
@@ -408,511 +503,256 @@ void csv_datasource::parse_csv(T & stream,
         }
     }
 
-    if (!has_wkt_field && !has_json_field && (!has_lon_field || !has_lat_field) )
+    if (!parser->has_wkt_field && !parser->has_json_field && (!parser->has_lon_field || !parser->has_lat_field))
     {
         throw mapnik::datasource_exception("CSV Plugin: could not detect column headers with the name of wkt, geojson, x/y, or latitude/longitude - this is required for reading geometry data");
     }
 
-    mapnik::value_integer feature_count = 0;
-    bool extent_started = false;
-
-    std::size_t num_headers = headers_.size();
+    parser->headers = headers_;
+    parser_ = parser;
 
     std::for_each(headers_.begin(), headers_.end(),
                   [ & ](std::string const& header){ ctx_->push(header); });
 
-    mapnik::transcoder tr(desc_.get_encoding());
-
-    // handle rare case of a single line of data and user-provided headers
-    // where a lack of a newline will mean that std::getline returns false
-    bool is_first_row = false;
-    if (!has_newline)
+    std::string index_file = filename_ + ".index";
+    std::uint64_t options = 0;
+    if (!cache_features_)
     {
-        stream >> csv_line;
-        if (!csv_line.empty())
-        {
-            is_first_row = true;
-        }
+        // an index only holds for the options the file was read with
+        std::ostringstream s;
+        s << sep << '\0' << quo << '\0' << esc << '\0' << manual_headers_ << '\0'
+          << strict_ << '\0' << row_limit_;
+        options = options_hash(s.str());
+        if (load_index(index_file, options)) return;
     }
-    while (std::getline(stream,csv_line,newline) || is_first_row)
-    {
-        is_first_row = false;
-        if ((row_limit_ > 0) && (line_number > row_limit_))
-        {
-            MAPNIK_LOG_DEBUG(csv) << "csv_datasource: row limit hit, exiting at feature: " << feature_count;
-            break;
-        }
 
-        // skip blank lines
-        unsigned line_length = csv_line.length();
-        if (line_length <= 10)
-        {
-            std::string trimmed = csv_line;
-            boost::trim_if(trimmed,boost::algorithm::is_any_of("\",'\r\n "));
-            if (trimmed.empty())
-            {
-                ++line_number;
-                MAPNIK_LOG_DEBUG(csv) << "csv_datasource: empty row encountered at line: " << line_number;
-                continue;
-            }
-        }
+    mapnik::value_integer feature_count = 0;
+    bool extent_started = false;
 
-        try
+    // rows of an indexed file are only parsed for their geometry, all but
+    // the first one which gives the attribute types
+    std::vector<std::pair<mapnik::box2d<double>, csv_index::row_type> > rows;
+    std::streamoff pos = stream.tellg();
+    std::uint64_t offset = pos > 0 ? static_cast<std::uint64_t>(pos) : 0;
+
+    // Rows are read here and parsed in chunks on a pool of threads, the
+    // results are merged in file order so feature ids are kept.
+    std::size_t num_threads = parse_threads_ > 0 ? static_cast<std::size_t>(parse_threads_) : 1;
+    std::deque<std::pair<std::shared_ptr<csv_chunk>, std::future<void> > > pending;
+    std::unique_ptr<mapnik::prefetch_pool> pool;
+    auto merge = [&](csv_chunk & chunk)
+    {
+        for (std::size_t i = 0; i < chunk.rows.size(); ++i)
         {
-            // special handling for varieties of quoting that we will enounter with json
-            // TODO - test with custom "quo" option
-            if (has_json_field && (quo == "\"") && (std::count(csv_line.begin(), csv_line.end(), '"') >= 6))
-            {
-                csv_utils::fix_json_quoting(csv_line);
-            }
-
-            Tokenizer tok(csv_line, grammer);
-            Tokenizer::iterator beg = tok.begin();
-
-            unsigned num_fields = std::distance(beg,tok.end());
-            if (num_fields > num_headers)
-            {
-                std::ostringstream s;
-                s << "CSV Plugin: # of columns("
-                  << num_fields << ") > # of headers("
-                  << num_headers << ") parsed for row " << line_number << "\n";
-                throw mapnik::datasource_exception(s.str());
-            }
-            else if (num_fields < num_headers)
+            // NOTE: feature id's start at 1
+            ++feature_count;
+            if (feature_count == 1)
             {
-                std::ostringstream s;
-                s << "CSV Plugin: # of headers("
-                  << num_headers << ") > # of columns("
-                  << num_fields << ") parsed for row " << line_number << "\n";
-                if (strict_)
+                for (auto const& desc : chunk.descriptors)
                 {
-                    throw mapnik::datasource_exception(s.str());
-                }
-                else
-                {
-                    MAPNIK_LOG_WARN(csv) << s.str();
+                    desc_.add_descriptor(desc);
                 }
             }
-
-            // NOTE: we use ++feature_count here because feature id's should start at 1;
-            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,++feature_count));
-            double x = 0;
-            double y = 0;
-            bool parsed_x = false;
-            bool parsed_y = false;
-            bool parsed_wkt = false;
-            bool parsed_json = false;
-            std::vector<std::string> collected;
-            for (unsigned i = 0; i < num_headers; ++i)
+            mapnik::box2d<double> const& box = chunk.rows[i].first;
+            if (!extent_initialized_)
             {
-                std::string fld_name(headers_.at(i));
-                collected.push_back(fld_name);
-                std::string value;
-                if (beg == tok.end()) // there are more headers than column values for this row
-                {
-                    // add an empty string here to represent a missing value
-                    // not using null type here since nulls are not a csv thing
-                    feature->put(fld_name,tr.transcode(value.c_str()));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
-                    }
-                    // continue here instead of break so that all missing values are
-                    // encoded consistenly as empty strings
-                    continue;
-                }
-                else
+                if (!extent_started)
                 {
-                    value = mapnik::util::trim_copy(*beg);
-                    ++beg;
-                }
-
-                int value_length = value.length();
-
-                // parse wkt
-                if (has_wkt_field)
-                {
-                    if (i == wkt_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-                        mapnik::geometry::geometry<double> geom;
-                        if (mapnik::from_wkt(value, geom))
-                        {
-                            // correct orientations etc
-                            mapnik::geometry::correct(geom);
-                            // set geometry
-                            feature->set_geometry(std::move(geom));
-                            parsed_wkt = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected well known text geometry: could not parse row "
-                              << line_number
-                              << ",column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
-                }
-                // TODO - support both wkt/geojson columns
-                // at once to create multi-geoms?
-                // parse as geojson
-                else if (has_json_field)
-                {
-                    if (i == json_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-                        mapnik::geometry::geometry<double> geom;
-                        if (mapnik::json::from_geojson(value, geom))
-                        {
-                            feature->set_geometry(std::move(geom));
-                            parsed_json = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected geojson geometry: could not parse row "
-                              << line_number
-                              << ",column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
+                    extent_started = true;
+                    extent_ = box;
                 }
                 else
                 {
-                    // longitude
-                    if (i == lon_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-
-                        if (mapnik::util::string2double(value,x))
-                        {
-                            parsed_x = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected a float value for longitude: could not parse row "
-                              << line_number
-                              << ", column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
-                    // latitude
-                    else if (i == lat_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-
-                        if (mapnik::util::string2double(value,y))
-                        {
-                            parsed_y = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected a float value for latitude: could not parse row "
-                              << line_number
-                              << ", column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
-                }
-
-                // now, add attributes, skipping any WKT or JSON fields
-                if ((has_wkt_field) && (i == wkt_idx)) continue;
-                if ((has_json_field) && (i == json_idx)) continue;
-                /* First we detect likely strings,
-                   then try parsing likely numbers,
-                   then try converting to bool,
-                   finally falling back to string type.
-                   An empty string or a string of "null" will be parsed
-                   as a string rather than a true null value.
-                   Likely strings are either empty values, very long values
-                   or values with leading zeros like 001 (which are not safe
-                   to assume are numbers)
-                */
-
-                bool matched = false;
-                bool has_dot = value.find(".") != std::string::npos;
-                if (value.empty() ||
-                    (value_length > 20) ||
-                    (value_length > 1 && !has_dot && value[0] == '0'))
-                {
-                    matched = true;
-                    feature->put(fld_name,std::move(tr.transcode(value.c_str())));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
-                    }
-                }
-                else if (csv_utils::is_likely_number(value))
-                {
-                    bool has_e = value.find("e") != std::string::npos;
-                    if (has_dot || has_e)
-                    {
-                        double float_val = 0.0;
-                        if (mapnik::util::string2double(value,float_val))
-                        {
-                            matched = true;
-                            feature->put(fld_name,float_val);
-                            if (feature_count == 1)
-                            {
-                                desc_.add_descriptor(
-                                    mapnik::attribute_descriptor(
-                                        fld_name,mapnik::Double));
-                            }
-                        }
-                    }
-                    else
-                    {
-                        mapnik::value_integer int_val = 0;
-                        if (mapnik::util::string2int(value,int_val))
-                        {
-                            matched = true;
-                            feature->put(fld_name,int_val);
-                            if (feature_count == 1)
-                            {
-                                desc_.add_descriptor(
-                                    mapnik::attribute_descriptor(
-                                        fld_name,mapnik::Integer));
-                            }
-                        }
-                    }
-                }
-                if (!matched)
-                {
-                    // NOTE: we don't use mapnik::util::string2bool
-                    // here because we don't want to treat 'on' and 'off'
-                    // as booleans, only 'true' and 'false'
-                    bool bool_val = false;
-                    std::string lower_val = value;
-                    std::transform(lower_val.begin(), lower_val.end(), lower_val.begin(), ::tolower);
-                    if (lower_val == "true")
-                    {
-                        matched = true;
-                        bool_val = true;
-                    }
-                    else if (lower_val == "false")
-                    {
-                        matched = true;
-                        bool_val = false;
-                    }
-                    if (matched)
-                    {
-                        feature->put(fld_name,bool_val);
-                        if (feature_count == 1)
-                        {
-                            desc_.add_descriptor(
-                                mapnik::attribute_descriptor(
-                                    fld_name,mapnik::Boolean));
-                        }
-                    }
-                    else
-                    {
-                        // fallback to normal string
-                        feature->put(fld_name,std::move(tr.transcode(value.c_str())));
-                        if (feature_count == 1)
-                        {
-                            desc_.add_descriptor(
-                                mapnik::attribute_descriptor(
-                                    fld_name,mapnik::String));
-                        }
-                    }
+                    extent_.expand_to_include(box);
                 }
             }
-
-            bool null_geom = true;
-            if (has_wkt_field || has_json_field)
+            if (cache_features_)
             {
-                if (parsed_wkt || parsed_json)
-                {
-                    if (!extent_initialized_)
-                    {
-                        if (!extent_started)
-                        {
-                            extent_started = true;
-                            extent_ = feature->envelope();
-                        }
-                        else
-                        {
-                            extent_.expand_to_include(feature->envelope());
-                        }
-                    }
-                    features_.push_back(feature);
-                    null_geom = false;
-                }
-                else
-                {
-                    std::ostringstream s;
-                    s << "CSV Plugin: could not read WKT or GeoJSON geometry "
-                      << "for line " << line_number << " - found " <<  headers_.size()
-                      << " with values like: " << csv_line << "\n";
-                    if (strict_)
-                    {
-                        throw mapnik::datasource_exception(s.str());
-                    }
-                    else
-                    {
-                        MAPNIK_LOG_ERROR(csv) << s.str();
-                        continue;
-                    }
-                }
+                chunk.features[i]->set_id(feature_count);
+                features_.push_back(chunk.features[i]);
             }
-            else if (has_lat_field || has_lon_field)
+            else
             {
-                if (parsed_x && parsed_y)
-                {
-                    mapnik::geometry::point<double> pt(x,y);
-                    feature->set_geometry(std::move(pt));
-                    features_.push_back(feature);
-                    null_geom = false;
-                    if (!extent_initialized_)
-                    {
-                        if (!extent_started)
-                        {
-                            extent_started = true;
-                            extent_ = feature->envelope();
-                        }
-                        else
-                        {
-                            extent_.expand_to_include(feature->envelope());
-                        }
-                    }
-                }
-                else if (parsed_x || parsed_y)
-                {
-                    std::ostringstream s;
-                    s << "CSV Plugin: does your csv have valid headers?\n";
-                    if (!parsed_x)
-                    {
-                        s << "Could not detect or parse any rows named 'x' or 'longitude' "
-                          << "for line " << line_number << " but found " <<  headers_.size()
-                          << " with values like: " << csv_line << "\n"
-                          << "for: " << boost::algorithm::join(collected, ",") << "\n";
-                    }
-                    if (!parsed_y)
-                    {
-                        s << "Could not detect or parse any rows named 'y' or 'latitude' "
-                          << "for line " << line_number << " but found " <<  headers_.size()
-                          << " with values like: " << csv_line << "\n"
-                          << "for: " << boost::algorithm::join(collected, ",") << "\n";
-                    }
-                    if (strict_)
-                    {
-                        throw mapnik::datasource_exception(s.str());
-                    }
-                    else
-                    {
-                        MAPNIK_LOG_ERROR(csv) << s.str();
-                        continue;
-                    }
-                }
+                rows.emplace_back(box, csv_index::row_type(chunk.rows[i].second, feature_count));
             }
-
-            if (null_geom)
+        }
+    };
+    // the last chunk of the file is parsed here unless threads were started
+    // for earlier ones, so files fitting in one chunk don't start any
+    auto dispatch = [&](std::shared_ptr<csv_chunk> const& chunk, bool last)
+    {
+        auto task = std::make_shared<std::packaged_task<void()> >(
+            std::bind(&csv_chunk::parse, chunk, parser, ctx_, desc_.get_encoding(), cache_features_));
+        pending.emplace_back(chunk, task->get_future());
+        if (!pool)
+        {
+            if (num_threads <= 1 || last)
             {
-                std::ostringstream s;
-                s << "CSV Plugin: could not detect and parse valid lat/lon fields or wkt/json geometry for line "
-                  << line_number;
-                if (strict_)
-                {
-                    throw mapnik::datasource_exception(s.str());
-                }
-                else
-                {
-                    MAPNIK_LOG_ERROR(csv) << s.str();
-                    // with no geometry we will never
-                    // add this feature so drop the count
-                    feature_count--;
-                    continue;
-                }
+                (*task)();
+                return;
             }
+            pool.reset(new mapnik::prefetch_pool(num_threads));
+        }
+        pool->post([task] { (*task)(); });
+    };
+    auto merge_front = [&]()
+    {
+        // rethrows errors of strict parsing, the first one in the file wins
+        pending.front().second.get();
+        merge(*pending.front().first);
+        pending.pop_front();
+    };
 
-            ++line_number;
+    std::shared_ptr<csv_chunk> chunk = std::make_shared<csv_chunk>();
+    // handle rare case of a single line of data and user-provided headers
+    // where a lack of a newline will mean that std::getline returns false
+    bool is_first_row = false;
+    if (!has_newline)
+    {
+        stream >> csv_line;
+        if (!csv_line.empty())
+        {
+            is_first_row = true;
         }
-        catch(mapnik::datasource_exception const& ex )
+    }
+    while (std::getline(stream,csv_line,newline) || is_first_row)
+    {
+        is_first_row = false;
+        std::uint64_t row_offset = offset;
+        offset += csv_line.size() + 1;
+        if ((row_limit_ > 0) && (line_number > row_limit_))
         {
-            if (strict_)
-            {
-                throw mapnik::datasource_exception(ex.what());
-            }
-            else
-            {
-                MAPNIK_LOG_ERROR(csv) << ex.what();
-            }
+            MAPNIK_LOG_DEBUG(csv) << "csv_datasource: row limit hit, exiting at line: " << line_number;
+            break;
         }
-        catch(std::exception const& ex)
+
+        // skip blank lines
+        if (csv_row_parser::is_blank(csv_line))
         {
-            std::ostringstream s;
-            s << "CSV Plugin: unexpected error parsing line: " << line_number
-              << " - found " << headers_.size() << " with values like: " << csv_line << "\n"
-              << " and got error like: " << ex.what();
-            if (strict_)
-            {
-                throw mapnik::datasource_exception(s.str());
-            }
-            else
+            ++line_number;
+            MAPNIK_LOG_DEBUG(csv) << "csv_datasource: empty row encountered at line: " << line_number;
+            continue;
+        }
+
+        chunk->add(csv_line, row_offset, line_number);
+        ++line_number;
+        if (chunk->bytes >= csv_chunk::max_bytes)
+        {
+            dispatch(chunk, false);
+            chunk = std::make_shared<csv_chunk>();
+            // bounds the rows read ahead of the parsers
+            while (pending.size() > 2 * num_threads)
             {
-                MAPNIK_LOG_ERROR(csv) << s.str();
+                merge_front();
             }
         }
     }
+    if (!chunk->lines.empty())
+    {
+        dispatch(chunk, true);
+    }
+    while (!pending.empty())
+    {
+        merge_front();
+    }
+    pool.reset();
+
     if (feature_count < 1)
     {
         MAPNIK_LOG_ERROR(csv) << "CSV Plugin: could not parse any lines of data";
     }
+    if (!cache_features_)
+    {
+        std::ostringstream out;
+        csv_index::write(out, mapnik::packed_rtree<csv_index::row_type>(std::move(rows)),
+                         extent_, desc_.get_descriptors(), file_size_, file_mtime_, file_hash_, options);
+        std::string data = out.str();
+        index_buffer_.assign(data.begin(), data.end());
+        index_ = csv_index(index_buffer_.data(), index_buffer_.size());
+        save_index(index_file);
+    }
+}
+
+bool csv_datasource::load_index(std::string const& index_file, std::uint64_t options)
+{
+    try
+    {
+        file_size_ = mapnik::util::file_size(filename_);
+        file_mtime_ = mapnik::util::last_write_time(filename_);
+        file_hash_ = mapnik::util::file_fingerprint(filename_);
+    }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_DEBUG(csv) << "csv_datasource: could not stat '" << filename_ << "': " << ex.what();
+        file_size_ = 0;
+        file_mtime_ = 0;
+        file_hash_ = 0;
+        return false;
+    }
+    if (!mapnik::util::exists(index_file)) return false;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    // mapped read-only, so the pages are shared by all processes using the index
+    boost::optional<mapnik::mapped_region_ptr> region =
+        mapnik::mapped_memory_cache::instance().find(index_file, true);
+    if (!region) return false;
+    csv_index index(static_cast<char const*>((*region)->get_address()), (*region)->get_size());
+    if (!index.matches(file_size_, file_mtime_, file_hash_, options))
+    {
+        mapnik::mapped_memory_cache::instance().remove(index_file);
+        return false;
+    }
+    index_region_ = *region;
+#else
+#ifdef _WINDOWS
+    std::ifstream in(mapnik::utf8_to_utf16(index_file), std::ios::in | std::ios::binary);
+#else
+    std::ifstream in(index_file.c_str(), std::ios::in | std::ios::binary);
+#endif
+    std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    csv_index index(buffer.data(), buffer.size());
+    if (!index.matches(file_size_, file_mtime_, file_hash_, options)) return false;
+    index_buffer_ = std::move(buffer);
+#endif
+    index_ = index;
+    if (!extent_initialized_)
+    {
+        extent_ = index_.extent();
+    }
+    for (auto const& desc : index_.schema())
+    {
+        desc_.add_descriptor(desc);
+    }
+    MAPNIK_LOG_DEBUG(csv) << "csv_datasource: using index '" << index_file << "'";
+    return true;
+}
+
+void csv_datasource::save_index(std::string const& index_file) const
+{
+    if (file_mtime_ == 0 || index_buffer_.empty()) return;
+    // written aside and renamed, so readers never see a partial index and
+    // existing mappings of an older one stay intact
+    std::string tmp_file = index_file + ".tmp" + std::to_string(std::random_device()());
+    try
+    {
+        {
+#ifdef _WINDOWS
+            std::ofstream out(mapnik::utf8_to_utf16(tmp_file), std::ios::out | std::ios::binary);
+#else
+            std::ofstream out(tmp_file.c_str(), std::ios::out | std::ios::binary);
+#endif
+            out.write(index_buffer_.data(), static_cast<std::streamsize>(index_buffer_.size()));
+            if (!out) throw std::runtime_error("could not write '" + tmp_file + "'");
+        }
+        mapnik::util::rename(tmp_file, index_file);
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+        mapnik::mapped_memory_cache::instance().remove(index_file);
+#endif
+    }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_WARN(csv) << "csv_datasource: could not save index '" << index_file << "': " << ex.what();
+        if (mapnik::util::exists(tmp_file)) mapnik::util::remove(tmp_file);
+    }
 }
 
 const char * csv_datasource::name()
@@ -939,10 +779,32 @@ boost::optional<mapnik::datasource_geometry_t> csv_datasource::get_geometry_type
 {
     boost::optional<mapnik::datasource_geometry_t> result;
     int multi_type = 0;
-    unsigned num_features = features_.size();
-    for (unsigned i = 0; i < num_features && i < 5; ++i)
+    std::deque<mapnik::feature_ptr> features;
+    if (cache_features_)
+    {
+        features.assign(features_.begin(), features_.begin() + std::min(features_.size(), std::size_t(5)));
+    }
+    else
     {
-        result = mapnik::util::to_ds_type(features_[i]->get_geometry());
+        csv_featureset::array_type rows;
+        if (!index_.query(extent_, [&rows](mapnik::box2d<double> const&, std::uint64_t offset, std::uint64_t id)
+                          {
+                              rows.emplace_back(offset, id);
+                              return rows.size() < 5;
+                          }))
+        {
+            throw mapnik::datasource_exception("CSV Plugin: damaged index '" + filename_ + ".index'");
+        }
+        std::sort(rows.begin(), rows.end());
+        csv_featureset featureset(filename_, parser_, ctx_, desc_.get_encoding(), std::move(rows));
+        while (mapnik::feature_ptr feature = featureset.next())
+        {
+            features.push_back(feature);
+        }
+    }
+    for (auto const& feature : features)
+    {
+        result = mapnik::util::to_ds_type(feature->get_geometry());
         if (result)
         {
             int type = static_cast<int>(*result);
@@ -981,7 +843,26 @@ mapnik::featureset_ptr csv_datasource::features(mapnik::query const& q) const
         }
         ++pos;
     }
-    return std::make_shared<mapnik::memory_featureset>(q.get_bbox(),features_);
+    if (cache_features_)
+    {
+        return std::make_shared<mapnik::memory_featureset>(q.get_bbox(),features_);
+    }
+    if (index_.valid() && extent_.intersects(q.get_bbox()))
+    {
+        csv_featureset::array_type rows;
+        if (!index_.query(q.get_bbox(), [&rows](mapnik::box2d<double> const&, std::uint64_t offset, std::uint64_t id)
+                          {
+                              rows.emplace_back(offset, id);
+                              return true;
+                          }))
+        {
+            throw mapnik::datasource_exception("CSV Plugin: damaged index '" + filename_ + ".index'");
+        }
+        // read the file front to back
+        std::sort(rows.begin(), rows.end());
+        return std::make_shared<csv_featureset>(filename_, parser_, ctx_, desc_.get_encoding(), std::move(rows));
+    }
+    return mapnik::featureset_ptr();
 }
 
 mapnik::featureset_ptr csv_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
@@ -32,6 +32,12 @@
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/value_types.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
+#include "csv_index.hpp"
+#include "csv_row_parser.hpp"
 
 // boost
 #include <boost/optional.hpp>
@@ -39,6 +45,7 @@
 // stl
 #include <vector>
 #include <deque>
+#include <memory>
 #include <string>
 
 class csv_datasource : public mapnik::datasource
@@ -60,11 +67,14 @@ public:
                    std::string const& quote);
 
 private:
+    bool load_index(std::string const& index_file, std::uint64_t options);
+    void save_index(std::string const& index_file) const;
+
     mapnik::layer_descriptor desc_;
     mapnik::box2d<double> extent_;
     std::string filename_;
     std::string inline_string_;
-    unsigned file_length_;
+    std::size_t file_length_;
     mapnik::value_integer row_limit_;
     std::deque<mapnik::feature_ptr> features_;
     std::string escape_;
@@ -74,8 +84,21 @@ private:
     std::string manual_headers_;
     bool strict_;
     double filesize_max_;
+    // threads parsing the rows, at least one
+    mapnik::value_integer parse_threads_;
     mapnik::context_ptr ctx_;
     bool extent_initialized_;
+    std::shared_ptr<csv_row_parser const> parser_;
+    // with cache_features=false rows are parsed when queried, found through index_
+    bool cache_features_ = true;
+    csv_index index_;
+    std::vector<char> index_buffer_;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::mapped_region_ptr index_region_;
+#endif
+    std::uint64_t file_size_ = 0;
+    std::int64_t file_mtime_ = 0;
+    std::uint64_t file_hash_ = 0;
 };
 
 #endif // MAPNIK_CSV_DATASOURCE_HPP
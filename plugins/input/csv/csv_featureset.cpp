@@ -0,0 +1,81 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/util/utf_conv_win.hpp>
+
+#include "csv_featureset.hpp"
+
+csv_featureset::csv_featureset(std::string const& filename,
+                               std::shared_ptr<csv_row_parser const> const& parser,
+                               mapnik::context_ptr const& ctx,
+                               std::string const& encoding,
+                               array_type && rows)
+    :
+#if defined(_WINDOWS)
+    in_(mapnik::utf8_to_utf16(filename), std::ios_base::in | std::ios_base::binary),
+#else
+    in_(filename.c_str(), std::ios_base::in | std::ios_base::binary),
+#endif
+    parser_(parser),
+    ctx_(ctx),
+    tr_(encoding),
+    strings_(tr_),
+    arena_(std::make_shared<mapnik::feature_arena>()),
+    rows_(std::move(rows)),
+    rows_itr_(rows_.begin()),
+    next_offset_(0),
+    csv_line_()
+{
+    if (!in_.is_open())
+    {
+        throw mapnik::datasource_exception("CSV Plugin: could not open: '" + filename + "'");
+    }
+}
+
+csv_featureset::~csv_featureset() {}
+
+mapnik::feature_ptr csv_featureset::next()
+{
+    while (rows_itr_ != rows_.end())
+    {
+        std::uint64_t offset = rows_itr_->first;
+        mapnik::value_integer id = static_cast<mapnik::value_integer>(rows_itr_->second);
+        ++rows_itr_;
+        if (offset != next_offset_)
+        {
+            in_.clear();
+            in_.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        }
+        if (!std::getline(in_, csv_line_, parser_->newline))
+        {
+            throw mapnik::datasource_exception("CSV Plugin: failed to read row at offset " + std::to_string(offset));
+        }
+        next_offset_ = offset + csv_line_.size() + 1;
+        // the line number is only known while the file is scanned, report the id instead
+        mapnik::feature_ptr feature = parser_->parse(csv_line_, static_cast<int>(id), id, ctx_,
+                                                     arena_, strings_, true, nullptr);
+        if (feature) return feature;
+    }
+    return mapnik::feature_ptr();
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef CSV_FEATURESET_HPP
+#define CSV_FEATURESET_HPP
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/string_pool.hpp>
+#include "csv_index.hpp"
+#include "csv_row_parser.hpp"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reads the rows of an indexed csv file matching a query, parsing each
+// into a feature as it is requested.
+class csv_featureset : public mapnik::Featureset
+{
+public:
+    using array_type = std::vector<csv_index::row_type>;
+
+    // rows are read in the order given, best sorted by offset
+    csv_featureset(std::string const& filename,
+                   std::shared_ptr<csv_row_parser const> const& parser,
+                   mapnik::context_ptr const& ctx,
+                   std::string const& encoding,
+                   array_type && rows);
+    virtual ~csv_featureset();
+    mapnik::feature_ptr next();
+
+private:
+    std::ifstream in_;
+    std::shared_ptr<csv_row_parser const> parser_;
+    mapnik::context_ptr ctx_;
+    mapnik::transcoder tr_;
+    mapnik::string_pool strings_;
+    mapnik::feature_arena_ptr arena_;
+    const array_type rows_;
+    array_type::const_iterator rows_itr_;
+    // offset the stream is positioned at, rows next to each other are read without seeking
+    std::uint64_t next_offset_;
+    std::string csv_line_;
+};
+
+#endif // CSV_FEATURESET_HPP
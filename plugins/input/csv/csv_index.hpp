@@ -0,0 +1,55 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_CSV_INDEX_HPP
+#define MAPNIK_CSV_INDEX_HPP
+
+// mapnik
+#include <mapnik/packed_index_file.hpp>
+
+// Sidecar index of a csv file, its items are the offset of each row in the
+// file and the id of its feature.
+class csv_index : public mapnik::packed_index_file
+{
+public:
+    using row_type = item_type;
+
+    csv_index() {}
+
+    csv_index(char const* data, std::size_t size)
+        : packed_index_file(magic(), offset_and_id, data, size) {}
+
+    static void write(std::ostream & out,
+                      mapnik::packed_rtree<row_type> const& tree,
+                      mapnik::box2d<double> const& extent,
+                      std::vector<mapnik::attribute_descriptor> const& schema,
+                      std::uint64_t file_size, std::int64_t file_mtime, std::uint64_t file_hash,
+                      std::uint64_t options)
+    {
+        packed_index_file::write(out, magic(), tree, extent, schema, file_size, file_mtime, file_hash, options);
+    }
+
+private:
+    static char const* magic() { return "mapnik-csvix"; }
+};
+
+#endif // MAPNIK_CSV_INDEX_HPP
@@ -0,0 +1,466 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#include "csv_row_parser.hpp"
+#include "csv_utils.hpp"
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry_correct.hpp>
+#include <mapnik/wkt/wkt_factory.hpp>
+#include <mapnik/json/geometry_parser.hpp>
+#include <mapnik/util/conversions.hpp>
+#include <mapnik/util/trim.hpp>
+
+// boost
+#include <boost/algorithm/string.hpp>
+
+// stl
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+bool csv_row_parser::is_blank(std::string const& csv_line)
+{
+    if (csv_line.length() > 10) return false;
+    std::string trimmed = csv_line;
+    boost::trim_if(trimmed,boost::algorithm::is_any_of("\",'\r\n "));
+    return trimmed.empty();
+}
+
+mapnik::feature_ptr csv_row_parser::parse(std::string & csv_line,
+                                          int line_number,
+                                          mapnik::value_integer id,
+                                          mapnik::context_ptr const& ctx,
+                                          mapnik::feature_arena_ptr const& arena,
+                                          mapnik::string_pool & strings,
+                                          bool attributes,
+                                          mapnik::layer_descriptor * desc) const
+{
+    std::size_t num_headers = headers.size();
+    try
+    {
+        // special handling for varieties of quoting that we will enounter with json
+        // TODO - test with custom "quo" option
+        if (has_json_field && (quote == "\"") && (std::count(csv_line.begin(), csv_line.end(), '"') >= 6))
+        {
+            csv_utils::fix_json_quoting(csv_line);
+        }
+
+        tokenizer_type tok(csv_line, grammar);
+        tokenizer_type::iterator beg = tok.begin();
+
+        unsigned num_fields = std::distance(beg,tok.end());
+        if (num_fields > num_headers)
+        {
+            std::ostringstream s;
+            s << "CSV Plugin: # of columns("
+              << num_fields << ") > # of headers("
+              << num_headers << ") parsed for row " << line_number << "\n";
+            throw mapnik::datasource_exception(s.str());
+        }
+        else if (num_fields < num_headers)
+        {
+            std::ostringstream s;
+            s << "CSV Plugin: # of headers("
+              << num_headers << ") > # of columns("
+              << num_fields << ") parsed for row " << line_number << "\n";
+            if (strict)
+            {
+                throw mapnik::datasource_exception(s.str());
+            }
+            else
+            {
+                MAPNIK_LOG_WARN(csv) << s.str();
+            }
+        }
+
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id, arena));
+        double x = 0;
+        double y = 0;
+        bool parsed_x = false;
+        bool parsed_y = false;
+        bool parsed_wkt = false;
+        bool parsed_json = false;
+        std::vector<std::string> collected;
+        for (unsigned i = 0; i < num_headers; ++i)
+        {
+            std::string fld_name(headers.at(i));
+            collected.push_back(fld_name);
+            std::string value;
+            if (beg == tok.end()) // there are more headers than column values for this row
+            {
+                // add an empty string here to represent a missing value
+                // not using null type here since nulls are not a csv thing
+                if (attributes) feature->put(fld_name,strings.intern(value.c_str(), static_cast<std::int32_t>(value.size())));
+                if (desc)
+                {
+                    desc->add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
+                }
+                // continue here instead of break so that all missing values are
+                // encoded consistenly as empty strings
+                continue;
+            }
+            else
+            {
+                value = mapnik::util::trim_copy(*beg);
+                ++beg;
+            }
+
+            int value_length = value.length();
+
+            // parse wkt
+            if (has_wkt_field)
+            {
+                if (i == wkt_idx)
+                {
+                    // skip empty geoms
+                    if (value.empty())
+                    {
+                        break;
+                    }
+                    mapnik::geometry::geometry<double> geom;
+                    if (mapnik::from_wkt(value, geom))
+                    {
+                        // correct orientations etc
+                        mapnik::geometry::correct(geom);
+                        // set geometry
+                        feature->set_geometry(std::move(geom));
+                        parsed_wkt = true;
+                    }
+                    else
+                    {
+                        std::ostringstream s;
+                        s << "CSV Plugin: expected well known text geometry: could not parse row "
+                          << line_number
+                          << ",column "
+                          << i << " - found: '"
+                          << value << "'";
+                        if (strict)
+                        {
+                            throw mapnik::datasource_exception(s.str());
+                        }
+                        else
+                        {
+                            MAPNIK_LOG_ERROR(csv) << s.str();
+                        }
+                    }
+                }
+            }
+            // TODO - support both wkt/geojson columns
+            // at once to create multi-geoms?
+            // parse as geojson
+            else if (has_json_field)
+            {
+                if (i == json_idx)
+                {
+                    // skip empty geoms
+                    if (value.empty())
+                    {
+                        break;
+                    }
+                    mapnik::geometry::geometry<double> geom;
+                    if (mapnik::json::from_geojson(value, geom))
+                    {
+                        feature->set_geometry(std::move(geom));
+                        parsed_json = true;
+                    }
+                    else
+                    {
+                        std::ostringstream s;
+                        s << "CSV Plugin: expected geojson geometry: could not parse row "
+                          << line_number
+                          << ",column "
+                          << i << " - found: '"
+                          << value << "'";
+                        if (strict)
+                        {
+                            throw mapnik::datasource_exception(s.str());
+                        }
+                        else
+                        {
+                            MAPNIK_LOG_ERROR(csv) << s.str();
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // longitude
+                if (i == lon_idx)
+                {
+                    // skip empty geoms
+                    if (value.empty())
+                    {
+                        break;
+                    }
+
+                    if (mapnik::util::string2double(value,x))
+                    {
+                        parsed_x = true;
+                    }
+                    else
+                    {
+                        std::ostringstream s;
+                        s << "CSV Plugin: expected a float value for longitude: could not parse row "
+                          << line_number
+                          << ", column "
+                          << i << " - found: '"
+                          << value << "'";
+                        if (strict)
+                        {
+                            throw mapnik::datasource_exception(s.str());
+                        }
+                        else
+                        {
+                            MAPNIK_LOG_ERROR(csv) << s.str();
+                        }
+                    }
+                }
+                // latitude
+                else if (i == lat_idx)
+                {
+                    // skip empty geoms
+                    if (value.empty())
+                    {
+                        break;
+                    }
+
+                    if (mapnik::util::string2double(value,y))
+                    {
+                        parsed_y = true;
+                    }
+                    else
+                    {
+                        std::ostringstream s;
+                        s << "CSV Plugin: expected a float value for latitude: could not parse row "
+                          << line_number
+                          << ", column "
+                          << i << " - found: '"
+                          << value << "'";
+                        if (strict)
+                        {
+                            throw mapnik::datasource_exception(s.str());
+                        }
+                        else
+                        {
+                            MAPNIK_LOG_ERROR(csv) << s.str();
+                        }
+                    }
+                }
+            }
+
+            // now, add attributes, skipping any WKT or JSON fields
+            if ((has_wkt_field) && (i == wkt_idx)) continue;
+            if ((has_json_field) && (i == json_idx)) continue;
+            if (!attributes) continue;
+            /* First we detect likely strings,
+               then try parsing likely numbers,
+               then try converting to bool,
+               finally falling back to string type.
+               An empty string or a string of "null" will be parsed
+               as a string rather than a true null value.
+               Likely strings are either empty values, very long values
+               or values with leading zeros like 001 (which are not safe
+               to assume are numbers)
+            */
+
+            bool matched = false;
+            bool has_dot = value.find(".") != std::string::npos;
+            if (value.empty() ||
+                (value_length > 20) ||
+                (value_length > 1 && !has_dot && value[0] == '0'))
+            {
+                matched = true;
+                feature->put(fld_name,strings.intern(value.c_str(), static_cast<std::int32_t>(value.size())));
+                if (desc)
+                {
+                    desc->add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
+                }
+            }
+            else if (csv_utils::is_likely_number(value))
+            {
+                bool has_e = value.find("e") != std::string::npos;
+                if (has_dot || has_e)
+                {
+                    double float_val = 0.0;
+                    if (mapnik::util::string2double(value,float_val))
+                    {
+                        matched = true;
+                        feature->put(fld_name,float_val);
+                        if (desc)
+                        {
+                            desc->add_descriptor(
+                                mapnik::attribute_descriptor(
+                                    fld_name,mapnik::Double));
+                        }
+                    }
+                }
+                else
+                {
+                    mapnik::value_integer int_val = 0;
+                    if (mapnik::util::string2int(value,int_val))
+                    {
+                        matched = true;
+                        feature->put(fld_name,int_val);
+                        if (desc)
+                        {
+                            desc->add_descriptor(
+                                mapnik::attribute_descriptor(
+                                    fld_name,mapnik::Integer));
+                        }
+                    }
+                }
+            }
+            if (!matched)
+            {
+                // NOTE: we don't use mapnik::util::string2bool
+                // here because we don't want to treat 'on' and 'off'
+                // as booleans, only 'true' and 'false'
+                bool bool_val = false;
+                std::string lower_val = value;
+                std::transform(lower_val.begin(), lower_val.end(), lower_val.begin(), ::tolower);
+                if (lower_val == "true")
+                {
+                    matched = true;
+                    bool_val = true;
+                }
+                else if (lower_val == "false")
+                {
+                    matched = true;
+                    bool_val = false;
+                }
+                if (matched)
+                {
+                    feature->put(fld_name,bool_val);
+                    if (desc)
+                    {
+                        desc->add_descriptor(
+                            mapnik::attribute_descriptor(
+                                fld_name,mapnik::Boolean));
+                    }
+                }
+                else
+                {
+                    // fallback to normal string
+                    feature->put(fld_name,strings.intern(value.c_str(), static_cast<std::int32_t>(value.size())));
+                    if (desc)
+                    {
+                        desc->add_descriptor(
+                            mapnik::attribute_descriptor(
+                                fld_name,mapnik::String));
+                    }
+                }
+            }
+        }
+
+        if (has_wkt_field || has_json_field)
+        {
+            if (parsed_wkt || parsed_json)
+            {
+                return feature;
+            }
+            std::ostringstream s;
+            s << "CSV Plugin: could not read WKT or GeoJSON geometry "
+              << "for line " << line_number << " - found " <<  headers.size()
+              << " with values like: " << csv_line << "\n";
+            if (strict)
+            {
+                throw mapnik::datasource_exception(s.str());
+            }
+            MAPNIK_LOG_ERROR(csv) << s.str();
+            return mapnik::feature_ptr();
+        }
+        else if (has_lat_field || has_lon_field)
+        {
+            if (parsed_x && parsed_y)
+            {
+                feature->set_geometry(mapnik::geometry::point<double>(x,y));
+                return feature;
+            }
+            else if (parsed_x || parsed_y)
+            {
+                std::ostringstream s;
+                s << "CSV Plugin: does your csv have valid headers?\n";
+                if (!parsed_x)
+                {
+                    s << "Could not detect or parse any rows named 'x' or 'longitude' "
+                      << "for line " << line_number << " but found " <<  headers.size()
+                      << " with values like: " << csv_line << "\n"
+                      << "for: " << boost::algorithm::join(collected, ",") << "\n";
+                }
+                if (!parsed_y)
+                {
+                    s << "Could not detect or parse any rows named 'y' or 'latitude' "
+                      << "for line " << line_number << " but found " <<  headers.size()
+                      << " with values like: " << csv_line << "\n"
+                      << "for: " << boost::algorithm::join(collected, ",") << "\n";
+                }
+                if (strict)
+                {
+                    throw mapnik::datasource_exception(s.str());
+                }
+                MAPNIK_LOG_ERROR(csv) << s.str();
+                return mapnik::feature_ptr();
+            }
+        }
+
+        std::ostringstream s;
+        s << "CSV Plugin: could not detect and parse valid lat/lon fields or wkt/json geometry for line "
+          << line_number;
+        if (strict)
+        {
+            throw mapnik::datasource_exception(s.str());
+        }
+        MAPNIK_LOG_ERROR(csv) << s.str();
+    }
+    catch(mapnik::datasource_exception const& ex )
+    {
+        if (strict)
+        {
+            throw mapnik::datasource_exception(ex.what());
+        }
+        else
+        {
+            MAPNIK_LOG_ERROR(csv) << ex.what();
+        }
+    }
+    catch(std::exception const& ex)
+    {
+        std::ostringstream s;
+        s << "CSV Plugin: unexpected error parsing line: " << line_number
+          << " - found " << headers.size() << " with values like: " << csv_line << "\n"
+          << " and got error like: " << ex.what();
+        if (strict)
+        {
+            throw mapnik::datasource_exception(s.str());
+        }
+        else
+        {
+            MAPNIK_LOG_ERROR(csv) << s.str();
+        }
+    }
+    return mapnik::feature_ptr();
+}
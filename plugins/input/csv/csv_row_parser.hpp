@@ -0,0 +1,79 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_CSV_ROW_PARSER_HPP
+#define MAPNIK_CSV_ROW_PARSER_HPP
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/string_pool.hpp>
+#include <mapnik/value_types.hpp>
+
+// boost
+#include <boost/tokenizer.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+// Turns the data rows of a csv file into features. Set up by the
+// datasource while it reads the headers, then shared read-only with the
+// featuresets of indexed files, which parse rows as they are queried.
+struct csv_row_parser
+{
+    using escape_type = boost::escaped_list_separator<char>;
+    using tokenizer_type = boost::tokenizer<escape_type>;
+
+    // true for short rows holding nothing but quotes, separators and spaces
+    static bool is_blank(std::string const& csv_line);
+
+    // Parses a data row into a feature with the given id. Returns a null
+    // pointer for rows without usable geometry, after logging why, or
+    // throws when strict. Without attributes only the geometry is read.
+    // The types of the row's attributes are added to desc when given.
+    mapnik::feature_ptr parse(std::string & csv_line,
+                              int line_number,
+                              mapnik::value_integer id,
+                              mapnik::context_ptr const& ctx,
+                              mapnik::feature_arena_ptr const& arena,
+                              mapnik::string_pool & strings,
+                              bool attributes,
+                              mapnik::layer_descriptor * desc) const;
+
+    char newline = '\n';
+    std::string quote;
+    escape_type grammar;
+    std::vector<std::string> headers;
+    bool strict = false;
+    bool has_wkt_field = false;
+    bool has_json_field = false;
+    bool has_lat_field = false;
+    bool has_lon_field = false;
+    unsigned wkt_idx = 0;
+    unsigned json_idx = 0;
+    unsigned lat_idx = 0;
+    unsigned lon_idx = 0;
+};
+
+#endif // MAPNIK_CSV_ROW_PARSER_HPP
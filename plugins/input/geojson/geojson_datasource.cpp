@@ -23,8 +23,17 @@
 #include "geojson_datasource.hpp"
 #include "geojson_featureset.hpp"
 #include "large_geojson_featureset.hpp"
+#include "geojson_scanner.hpp"
 #include <fstream>
 #include <algorithm>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <random>
+#include <sstream>
+#ifdef MAPNIK_THREADSAFE
+#include <thread>
+#endif
 
 // boost
 #pragma GCC diagnostic push
@@ -47,10 +56,12 @@
 #include <mapnik/value_types.hpp>
 #include <mapnik/box2d.hpp>
 #include <mapnik/debug.hpp>
+#include <mapnik/featureset_prefetch.hpp>
 #include <mapnik/proj_transform.hpp>
 #include <mapnik/projection.hpp>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/util/file_io.hpp>
+#include <mapnik/util/fs.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
 #include <mapnik/make_unique.hpp>
 #include <mapnik/geometry_adapters.hpp>
@@ -120,6 +131,11 @@ geojson_datasource::geojson_datasource(parameters const& params)
     features_(),
     tree_(nullptr)
 {
+#ifdef MAPNIK_THREADSAFE
+    mapnik::value_integer threads = static_cast<mapnik::value_integer>(std::thread::hardware_concurrency());
+    parse_threads_ = static_cast<std::size_t>(std::max(mapnik::value_integer(1),
+        *params.get<mapnik::value_integer>("parse_threads", threads)));
+#endif
     boost::optional<std::string> inline_string = params.get<std::string>("inline");
     if (inline_string)
     {
@@ -145,46 +161,136 @@ geojson_datasource::geojson_datasource(parameters const& params)
     else
     {
         cache_features_ = *params.get<mapnik::boolean_type>("cache_features", true);
-#if !defined(SHAPE_MEMORY_MAPPED_FILE)
-        mapnik::util::file file(filename_);
-        if (!file.open())
+        std::string index_file = filename_ + ".index";
+        if (cache_features_ || !load_index(index_file))
         {
-            throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+            read_file(index_file);
         }
+    }
+}
 
-        std::string file_buffer;
-        file_buffer.resize(file.size());
-        std::fread(&file_buffer[0], file.size(), 1, file.get());
-        char const* start = file_buffer.c_str();
-        char const* end = start + file_buffer.length();
-        if (cache_features_)
-        {
-            parse_geojson(start, end);
-        }
-        else
-        {
-            initialise_index(start, end);
-        }
+void geojson_datasource::read_file(std::string const& index_file)
+{
+#if !defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::util::file file(filename_);
+    if (!file.open())
+    {
+        throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+    }
+
+    std::string file_buffer;
+    file_buffer.resize(file.size());
+    std::fread(&file_buffer[0], file.size(), 1, file.get());
+    char const* start = file_buffer.c_str();
+    char const* end = start + file_buffer.length();
+    if (cache_features_)
+    {
+        parse_geojson(start, end);
+    }
+    else
+    {
+        initialise_index(start, end);
+        save_index(index_file);
+    }
 #else
-        boost::optional<mapnik::mapped_region_ptr> mapped_region =
-            mapnik::mapped_memory_cache::instance().find(filename_, false);
-        if (!mapped_region)
-        {
-            throw std::runtime_error("could not get file mapping for "+ filename_);
-        }
+    boost::optional<mapnik::mapped_region_ptr> mapped_region =
+        mapnik::mapped_memory_cache::instance().find(filename_, false);
+    if (!mapped_region)
+    {
+        throw std::runtime_error("could not get file mapping for "+ filename_);
+    }
 
-        char const* start = reinterpret_cast<char const*>((*mapped_region)->get_address());
-        char const* end = start + (*mapped_region)->get_size();
-        if (cache_features_)
-        {
-            parse_geojson(start, end);
-        }
-        else
+    char const* start = reinterpret_cast<char const*>((*mapped_region)->get_address());
+    char const* end = start + (*mapped_region)->get_size();
+    if (cache_features_)
+    {
+        parse_geojson(start, end);
+    }
+    else
+    {
+        initialise_index(start, end);
+        save_index(index_file);
+    }
+#endif
+}
+
+bool geojson_datasource::load_index(std::string const& index_file)
+{
+    try
+    {
+        file_size_ = mapnik::util::file_size(filename_);
+        file_mtime_ = mapnik::util::last_write_time(filename_);
+        file_hash_ = mapnik::util::file_fingerprint(filename_);
+    }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_DEBUG(geojson) << "geojson_datasource: could not stat '" << filename_ << "': " << ex.what();
+        file_size_ = 0;
+        file_mtime_ = 0;
+        file_hash_ = 0;
+        return false;
+    }
+    if (!mapnik::util::exists(index_file)) return false;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    // mapped read-only, so the pages are shared by all processes using the index
+    boost::optional<mapnik::mapped_region_ptr> region =
+        mapnik::mapped_memory_cache::instance().find(index_file, true);
+    if (!region) return false;
+    geojson_index index(static_cast<char const*>((*region)->get_address()), (*region)->get_size());
+    if (!index.matches(file_size_, file_mtime_, file_hash_))
+    {
+        mapnik::mapped_memory_cache::instance().remove(index_file);
+        return false;
+    }
+    index_region_ = *region;
+#else
+#ifdef _WINDOWS
+    std::ifstream in(mapnik::utf8_to_utf16(index_file), std::ios::in | std::ios::binary);
+#else
+    std::ifstream in(index_file.c_str(), std::ios::in | std::ios::binary);
+#endif
+    std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    geojson_index index(buffer.data(), buffer.size());
+    if (!index.matches(file_size_, file_mtime_, file_hash_)) return false;
+    index_buffer_ = std::move(buffer);
+#endif
+    index_ = index;
+    extent_ = index_.extent();
+    for (auto const& desc : index_.schema())
+    {
+        desc_.add_descriptor(desc);
+    }
+    MAPNIK_LOG_DEBUG(geojson) << "geojson_datasource: using index '" << index_file << "'";
+    return true;
+}
+
+void geojson_datasource::save_index(std::string const& index_file) const
+{
+    if (file_mtime_ == 0 || index_buffer_.empty()) return;
+    // written aside and renamed, so readers never see a partial index and
+    // existing mappings of an older one stay intact
+    std::string tmp_file = index_file + ".tmp" + std::to_string(std::random_device()());
+    try
+    {
         {
-            initialise_index(start, end);
+#ifdef _WINDOWS
+            std::ofstream out(mapnik::utf8_to_utf16(tmp_file), std::ios::out | std::ios::binary);
+#else
+            std::ofstream out(tmp_file.c_str(), std::ios::out | std::ios::binary);
+#endif
+            out.write(index_buffer_.data(), static_cast<std::streamsize>(index_buffer_.size()));
+            if (!out) throw std::runtime_error("could not write '" + tmp_file + "'");
         }
+        mapnik::util::rename(tmp_file, index_file);
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+        mapnik::mapped_memory_cache::instance().remove(index_file);
 #endif
     }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_WARN(geojson) << "geojson_datasource: could not save index '" << index_file << "': " << ex.what();
+        if (mapnik::util::exists(tmp_file)) mapnik::util::remove(tmp_file);
+    }
 }
 
 namespace {
@@ -205,8 +311,8 @@ void geojson_datasource::initialise_index(Iterator start, Iterator end)
     {
         throw mapnik::datasource_exception("GeoJSON Plugin: could not parse: '" + filename_ + "'");
     }
-    // bulk insert initialise r-tree
-    tree_ = std::make_unique<spatial_index_type>(boxes);
+    std::vector<std::pair<box_type, geojson_index::feature_type> > items;
+    items.reserve(boxes.size());
     // calculate total extent
     for (auto const& item : boxes)
     {
@@ -236,25 +342,121 @@ void geojson_datasource::initialise_index(Iterator start, Iterator end)
         {
             extent_.expand_to_include(box);
         }
+        items.emplace_back(box, geojson_index::feature_type(geometry_index.first, geometry_index.second));
     }
+    // packed r-tree, serialised so it can be saved as it is queried
+    std::ostringstream out;
+    geojson_index::write(out, mapnik::packed_rtree<geojson_index::feature_type>(std::move(items)),
+                         extent_, desc_.get_descriptors(), file_size_, file_mtime_, file_hash_);
+    std::string data = out.str();
+    index_buffer_.assign(data.begin(), data.end());
+    index_ = geojson_index(index_buffer_.data(), index_buffer_.size());
+}
+
+namespace {
+
+// Parses the features found by geojson_scanner from first to last into
+// features, with their envelopes. The features of a range share a context,
+// ids are their position in the collection.
+struct parse_feature_range
+{
+    void operator() () const
+    {
+        boost::spirit::standard::space_type space;
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        for (std::size_t i = first; i < last; ++i)
+        {
+            char const* itr = start + ranges[i].first;
+            char const* end = itr + ranges[i].second;
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, static_cast<mapnik::value_integer>(i + 1)));
+            if (!boost::spirit::qi::phrase_parse(itr, end, (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space)
+                || itr != end)
+            {
+                throw mapnik::datasource_exception("geojson_datasource: Failed to parse feature " + std::to_string(i + 1));
+            }
+            envelopes[i] = feature->envelope();
+            features[i] = std::move(feature);
+        }
+    }
+
+    char const* start;
+    std::vector<geojson_scanner::range_type> const& ranges;
+    std::vector<mapnik::feature_ptr> & features;
+    std::vector<mapnik::box2d<double> > & envelopes;
+    std::size_t first;
+    std::size_t last;
+};
+
+// features are handed to a parser in ranges of about this many bytes
+const std::size_t parse_range_bytes = 1024 * 1024;
+
 }
 
 template <typename Iterator>
 void geojson_datasource::parse_geojson(Iterator start, Iterator end)
 {
-    boost::spirit::standard::space_type space;
-    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
-    std::size_t start_id = 1;
+    std::vector<mapnik::box2d<double> > envelopes;
+    std::vector<geojson_scanner::range_type> ranges;
+    if (parse_threads_ > 1 && geojson_scanner::scan_features(start, end, ranges))
+    {
+        // the features of a collection are found with a structural scan
+        // first, then parsed in parallel
+        features_.resize(ranges.size());
+        envelopes.resize(ranges.size());
+        std::deque<std::future<void> > pending;
+        {
+            mapnik::prefetch_pool pool(parse_threads_);
+            std::size_t first = 0;
+            while (first < ranges.size())
+            {
+                std::size_t last = first;
+                std::size_t bytes = 0;
+                while (last < ranges.size() && bytes < parse_range_bytes)
+                {
+                    bytes += ranges[last++].second;
+                }
+                auto task = std::make_shared<std::packaged_task<void()> >(
+                    parse_feature_range{start, ranges, features_, envelopes, first, last});
+                pending.push_back(task->get_future());
+                pool.post([task] { (*task)(); });
+                first = last;
+            }
+            // rethrows the first error in the collection
+            for (auto & result : pending)
+            {
+                try
+                {
+                    result.get();
+                }
+                catch (mapnik::datasource_exception const& ex)
+                {
+                    if (!inline_string_.empty()) throw mapnik::datasource_exception(std::string(ex.what()) + " of in-memory string");
+                    else throw mapnik::datasource_exception(std::string(ex.what()) + " of GeoJSON file '" + filename_ + "'");
+                }
+            }
+        }
+    }
+    else
+    {
+        boost::spirit::standard::space_type space;
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        std::size_t start_id = 1;
 
-    mapnik::json::default_feature_callback callback(features_);
+        mapnik::json::default_feature_callback callback(features_);
 
-    bool result = boost::spirit::qi::phrase_parse(start, end, (geojson_datasource_static_fc_grammar)
-                                                  (boost::phoenix::ref(ctx),boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
-                                                  space);
-    if (!result)
-    {
-        if (!inline_string_.empty()) throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file from in-memory string");
-        else throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file '" + filename_ + "'");
+        bool result = boost::spirit::qi::phrase_parse(start, end, (geojson_datasource_static_fc_grammar)
+                                                      (boost::phoenix::ref(ctx),boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
+                                                      space);
+        if (!result)
+        {
+            if (!inline_string_.empty()) throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file from in-memory string");
+            else throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file '" + filename_ + "'");
+        }
+        envelopes.reserve(features_.size());
+        for (mapnik::feature_ptr const& f : features_)
+        {
+            envelopes.push_back(f->envelope());
+        }
     }
 
     using values_container = std::vector< std::pair<box_type, std::pair<std::size_t, std::size_t>>>;
@@ -264,7 +466,7 @@ void geojson_datasource::parse_geojson(Iterator start, Iterator end)
     std::size_t geometry_index = 0;
     for (mapnik::feature_ptr const& f : features_)
     {
-        mapnik::box2d<double> box = f->envelope();
+        mapnik::box2d<double> const& box = envelopes[geometry_index];
         if (box.valid())
         {
             if (geometry_index == 0)
@@ -342,14 +544,20 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
         {
             throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
         }
-        auto itr = tree_->qbegin(boost::geometry::index::intersects(extent_));
-        auto end = tree_->qend();
+        std::vector<geojson_index::feature_type> items;
+        if (!index_.query(extent_, [&items](box_type const&, std::uint64_t offset, std::uint64_t size)
+                          {
+                              items.emplace_back(offset, size);
+                              return items.size() < 5;
+                          }))
+        {
+            throw mapnik::datasource_exception("GeoJSON Plugin: damaged index '" + filename_ + ".index'");
+        }
         mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
-        for (std::size_t count = 0; itr !=end &&  count < 5; ++itr,++count)
+        for (auto const& item : items)
         {
-            geojson_datasource::item_type const& item = *itr;
-            std::size_t file_offset = item.second.first;
-            std::size_t size = item.second.second;
+            std::size_t file_offset = item.first;
+            std::size_t size = item.second;
 
             std::fseek(file.get(), file_offset, SEEK_SET);
             std::vector<char> json;
@@ -390,23 +598,30 @@ mapnik::featureset_ptr geojson_datasource::features(mapnik::query const& q) cons
     if (extent_.intersects(box))
     {
         geojson_featureset::array_type index_array;
-        if (tree_)
+        if (cache_features_)
         {
-            tree_->query(boost::geometry::index::intersects(box),std::back_inserter(index_array));
-
-            if (cache_features_)
+            if (tree_)
             {
+                tree_->query(boost::geometry::index::intersects(box),std::back_inserter(index_array));
                 return std::make_shared<geojson_featureset>(features_, std::move(index_array));
             }
-            else
+        }
+        else if (index_.valid())
+        {
+            if (!index_.query(box, [&index_array](box_type const& item_box, std::uint64_t offset, std::uint64_t size)
+                              {
+                                  index_array.emplace_back(item_box, std::make_pair(offset, size));
+                                  return true;
+                              }))
             {
-                std::sort(index_array.begin(),index_array.end(),
-                          [] (item_type const& item0, item_type const& item1)
-                          {
-                              return item0.second.first < item1.second.first;
-                          });
-                return std::make_shared<large_geojson_featureset>(filename_, std::move(index_array));
+                throw mapnik::datasource_exception("GeoJSON Plugin: damaged index '" + filename_ + ".index'");
             }
+            std::sort(index_array.begin(),index_array.end(),
+                      [] (item_type const& item0, item_type const& item1)
+                      {
+                          return item0.second.first < item1.second.first;
+                      });
+            return std::make_shared<large_geojson_featureset>(filename_, std::move(index_array));
         }
     }
     // otherwise return an empty featureset pointer
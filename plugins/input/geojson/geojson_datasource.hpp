@@ -32,6 +32,11 @@
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/unicode.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
+#include "geojson_index.hpp"
 
 // boost
 #include <boost/optional.hpp>
@@ -99,6 +104,10 @@ public:
     template <typename Iterator>
     void initialise_index(Iterator start, Iterator end);
 private:
+    void read_file(std::string const& index_file);
+    bool load_index(std::string const& index_file);
+    void save_index(std::string const& index_file) const;
+
     mapnik::datasource::datasource_t type_;
     mapnik::layer_descriptor desc_;
     std::string filename_;
@@ -106,7 +115,18 @@ private:
     mapnik::box2d<double> extent_;
     std::vector<mapnik::feature_ptr> features_;
     std::unique_ptr<spatial_index_type> tree_;
+    // used instead of tree_ when features are not cached
+    geojson_index index_;
+    std::vector<char> index_buffer_;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::mapped_region_ptr index_region_;
+#endif
+    std::uint64_t file_size_ = 0;
+    std::int64_t file_mtime_ = 0;
+    std::uint64_t file_hash_ = 0;
     bool cache_features_ = true;
+    // threads parsing a cached feature collection
+    std::size_t parse_threads_ = 1;
 };
 
 
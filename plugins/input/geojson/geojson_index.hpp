@@ -0,0 +1,54 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef GEOJSON_INDEX_HPP
+#define GEOJSON_INDEX_HPP
+
+// mapnik
+#include <mapnik/packed_index_file.hpp>
+
+// Sidecar index of a GeoJSON file, its items are the offset and size of
+// each feature in the file.
+class geojson_index : public mapnik::packed_index_file
+{
+public:
+    using feature_type = item_type;
+
+    geojson_index() {}
+
+    geojson_index(char const* data, std::size_t size)
+        : packed_index_file(magic(), offset_and_size, data, size) {}
+
+    static void write(std::ostream & out,
+                      mapnik::packed_rtree<feature_type> const& tree,
+                      mapnik::box2d<double> const& extent,
+                      std::vector<mapnik::attribute_descriptor> const& schema,
+                      std::uint64_t file_size, std::int64_t file_mtime, std::uint64_t file_hash)
+    {
+        packed_index_file::write(out, magic(), tree, extent, schema, file_size, file_mtime, file_hash);
+    }
+
+private:
+    static char const* magic() { return "mapnik-gjidx"; }
+};
+
+#endif // GEOJSON_INDEX_HPP
@@ -0,0 +1,175 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef GEOJSON_SCANNER_HPP
+#define GEOJSON_SCANNER_HPP
+
+// stl
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Structural scan of GeoJSON text: finds where values begin and end by
+// tracking strings and nesting only, without parsing them.
+class geojson_scanner
+{
+public:
+    using range_type = std::pair<std::size_t, std::size_t>;
+
+    // Finds the offset and size of each feature of the "features" array of
+    // a top level object whose "type" is "FeatureCollection". Returns false
+    // if the text is not such an object, leaving other forms to the full
+    // grammar.
+    static bool scan_features(char const* start, char const* end, std::vector<range_type> & features)
+    {
+        char const* itr = start;
+        skip_space(itr, end);
+        if (itr == end || *itr != '{') return false;
+        ++itr;
+        bool found = false;
+        bool collection = false;
+        for (;;)
+        {
+            skip_space(itr, end);
+            if (itr == end) return false;
+            if (*itr == '}') break;
+            char const* key = itr;
+            if (*itr != '"' || !skip_string(itr, end)) return false;
+            bool is_features = itr - key == 10 && std::memcmp(key, "\"features\"", 10) == 0;
+            bool is_type = itr - key == 6 && std::memcmp(key, "\"type\"", 6) == 0;
+            skip_space(itr, end);
+            if (itr == end || *itr != ':') return false;
+            ++itr;
+            skip_space(itr, end);
+            if (is_features)
+            {
+                if (found || !scan_array(start, itr, end, features)) return false;
+                found = true;
+            }
+            else if (is_type)
+            {
+                char const* value = itr;
+                if (collection || itr == end || *itr != '"' || !skip_string(itr, end)) return false;
+                if (itr - value != 19 || std::memcmp(value, "\"FeatureCollection\"", 19) != 0) return false;
+                collection = true;
+            }
+            else if (!skip_value(itr, end))
+            {
+                return false;
+            }
+            skip_space(itr, end);
+            if (itr == end) return false;
+            if (*itr == ',') ++itr;
+            else if (*itr != '}') return false;
+        }
+        ++itr;
+        skip_space(itr, end);
+        return found && collection && itr == end;
+    }
+
+private:
+    static void skip_space(char const*& itr, char const* end)
+    {
+        while (itr != end && (*itr == ' ' || *itr == '\n' || *itr == '\r' || *itr == '\t')) ++itr;
+    }
+
+    // itr is on the opening quote, leaves it past the closing one
+    static bool skip_string(char const*& itr, char const* end)
+    {
+        for (++itr; itr != end; ++itr)
+        {
+            if (*itr == '\\')
+            {
+                if (++itr == end) return false;
+            }
+            else if (*itr == '"')
+            {
+                ++itr;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool skip_value(char const*& itr, char const* end)
+    {
+        if (itr == end) return false;
+        if (*itr == '"') return skip_string(itr, end);
+        if (*itr != '{' && *itr != '[')
+        {
+            // number or literal
+            char const* begin = itr;
+            while (itr != end && *itr != ',' && *itr != '}' && *itr != ']' &&
+                   *itr != ' ' && *itr != '\n' && *itr != '\r' && *itr != '\t') ++itr;
+            return itr != begin;
+        }
+        std::size_t depth = 0;
+        while (itr != end)
+        {
+            char c = *itr;
+            if (c == '"')
+            {
+                if (!skip_string(itr, end)) return false;
+                continue;
+            }
+            if (c == '{' || c == '[') ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)
+            {
+                ++itr;
+                return true;
+            }
+            ++itr;
+        }
+        return false;
+    }
+
+    static bool scan_array(char const* start, char const*& itr, char const* end, std::vector<range_type> & items)
+    {
+        if (itr == end || *itr != '[') return false;
+        ++itr;
+        skip_space(itr, end);
+        if (itr != end && *itr == ']')
+        {
+            ++itr;
+            return true;
+        }
+        for (;;)
+        {
+            skip_space(itr, end);
+            char const* begin = itr;
+            if (itr == end || *itr != '{' || !skip_value(itr, end)) return false;
+            items.emplace_back(static_cast<std::size_t>(begin - start), static_cast<std::size_t>(itr - begin));
+            skip_space(itr, end);
+            if (itr == end) return false;
+            if (*itr == ']')
+            {
+                ++itr;
+                return true;
+            }
+            if (*itr != ',') return false;
+            ++itr;
+        }
+    }
+};
+
+#endif // GEOJSON_SCANNER_HPP
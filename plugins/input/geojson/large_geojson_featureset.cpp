@@ -26,52 +26,116 @@
 #include <mapnik/json/geometry_grammar.hpp>
 #include <mapnik/json/feature_grammar.hpp>
 #include <mapnik/util/utf_conv_win.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wshadow"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#include <boost/interprocess/mapped_region.hpp>
+#pragma GCC diagnostic pop
+#endif
 // stl
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <deque>
 
 #include "large_geojson_featureset.hpp"
 
+namespace {
+
+// features further apart than this are read separately
+const std::size_t max_gap = 64 * 1024;
+// runs are cut at this size, unless a single feature is larger
+const std::size_t max_run = 4 * 1024 * 1024;
+
+}
+
 large_geojson_featureset::large_geojson_featureset(std::string const& filename,
                                                    array_type && index_array)
 :
-#ifdef _WINDOWS
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapped_region_(),
+#elif defined(_WINDOWS)
     file_(_wfopen(mapnik::utf8_to_utf16(filename).c_str(), L"rb"), std::fclose),
+    buffer_(),
+    buffer_offset_(0),
 #else
     file_(std::fopen(filename.c_str(),"rb"), std::fclose),
+    buffer_(),
+    buffer_offset_(0),
 #endif
     index_array_(std::move(index_array)),
     index_itr_(index_array_.begin()),
     index_end_(index_array_.end()),
-    ctx_(std::make_shared<mapnik::context_type>())
+    ctx_(std::make_shared<mapnik::context_type>()),
+    arena_(std::make_shared<mapnik::feature_arena>())
 {
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    // shared by all featuresets of the file, features are parsed in place
+    boost::optional<mapnik::mapped_region_ptr> memory =
+        mapnik::mapped_memory_cache::instance().find(filename, true);
+    if (!memory) throw std::runtime_error("Can't map " + filename);
+    mapped_region_ = *memory;
+#else
     if (!file_) throw std::runtime_error("Can't open " + filename);
+#endif
 }
 
 large_geojson_featureset::~large_geojson_featureset() {}
 
+#if !defined(SHAPE_MEMORY_MAPPED_FILE)
+void large_geojson_featureset::read_run(array_type::const_iterator itr)
+{
+    // the index array is sorted by file offset
+    std::size_t run_start = itr->second.first;
+    std::size_t run_end = run_start + itr->second.second;
+    for (++itr; itr != index_end_; ++itr)
+    {
+        std::size_t offset = itr->second.first;
+        std::size_t end = std::max(run_end, offset + itr->second.second);
+        if (offset > run_end + max_gap || end - run_start > max_run) break;
+        run_end = end;
+    }
+    buffer_offset_ = run_start;
+    buffer_.resize(run_end - run_start);
+    std::fseek(file_.get(), static_cast<long>(run_start), SEEK_SET);
+    if (std::fread(buffer_.data(), buffer_.size(), 1, file_.get()) != 1)
+    {
+        throw std::runtime_error("Failed to read geojson feature");
+    }
+}
+#endif
+
 mapnik::feature_ptr large_geojson_featureset::next()
 {
     if (index_itr_ != index_end_)
     {
-        geojson_datasource::item_type const& item = *index_itr_++;
+        geojson_datasource::item_type const& item = *index_itr_;
         std::size_t file_offset = item.second.first;
         std::size_t size = item.second.second;
-        std::fseek(file_.get(), file_offset, SEEK_SET);
-        std::vector<char> json;
-        json.resize(size);
-        std::fread(json.data(), size, 1, file_.get());
 
         using chr_iterator_type = char const*;
-        chr_iterator_type start = json.data();
-        chr_iterator_type end = start + json.size();
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+        if (file_offset + size > mapped_region_->get_size())
+        {
+            throw std::runtime_error("Failed to read geojson feature");
+        }
+        chr_iterator_type start = static_cast<char const*>(mapped_region_->get_address()) + file_offset;
+#else
+        if (file_offset < buffer_offset_ || file_offset + size > buffer_offset_ + buffer_.size())
+        {
+            read_run(index_itr_);
+        }
+        chr_iterator_type start = buffer_.data() + (file_offset - buffer_offset_);
+#endif
+        chr_iterator_type end = start + size;
+        ++index_itr_;
 
         static const mapnik::transcoder tr("utf8");
         static const mapnik::json::feature_grammar<chr_iterator_type,mapnik::feature_impl> grammar(tr);
         using namespace boost::spirit;
         standard::space_type space;
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,1));
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,1,arena_));
         if (!qi::phrase_parse(start, end, (grammar)(boost::phoenix::ref(*feature)), space))
         {
             throw std::runtime_error("Failed to parse geojson feature");
@@ -24,6 +24,9 @@
 #define LARGE_GEOJSON_FEATURESET_HPP
 
 #include <mapnik/feature.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
 #include "geojson_datasource.hpp"
 
 #include <vector>
@@ -43,12 +46,23 @@ public:
     mapnik::feature_ptr next();
 
 private:
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::mapped_region_ptr mapped_region_;
+#else
+    // reads the run of features starting at itr that are close enough in
+    // the file to be read at once into buffer_
+    void read_run(array_type::const_iterator itr);
+
     file_ptr file_;
+    std::vector<char> buffer_;
+    std::size_t buffer_offset_;
+#endif
 
     const array_type index_array_;
     array_type::const_iterator index_itr_;
     array_type::const_iterator index_end_;
     mapnik::context_ptr ctx_;
+    mapnik::feature_arena_ptr arena_;
 };
 
 #endif // LARGE_GEOJSON_FEATURESET_HPP
@@ -30,6 +30,11 @@
 #include "resultset.hpp"
 #include <queue>
 #include <memory>
+#include <exception>
+#ifdef MAPNIK_THREADSAFE
+#include <condition_variable>
+#include <mutex>
+#endif
 
 class postgis_processor_context;
 using postgis_processor_context_ptr = std::shared_ptr<postgis_processor_context>;
@@ -44,7 +49,8 @@ public:
           pool_(pool),
           conn_(conn),
           sql_(sql),
-          is_closed_(false)
+          is_closed_(false),
+          cancelled_(false)
     {
     }
 
@@ -69,21 +75,51 @@ public:
 
     virtual void close()
     {
-        if (!is_closed_)
         {
-            rs_.reset();
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            if (is_closed_) return;
             is_closed_ = true;
-            if (conn_)
+        }
+        rs_.reset();
+        if (conn_)
+        {
+            if(conn_->isPending())
             {
-                if(conn_->isPending())
-                {
-                    abort();
-                }
-                conn_.reset();
+                abort();
             }
+            conn_.reset();
+            // the connection is back in the pool, hand it to a queued request
+            prepare_next();
         }
     }
 
+    // Blocks until a queued request got its connection, which happens on
+    // whichever thread finishes an earlier request. Returns false when
+    // cancelled meanwhile.
+    bool wait_for_connection()
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return conn_ || error_ || cancelled_ || is_closed_; });
+#endif
+        return !cancelled_;
+    }
+
+    void cancel()
+    {
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            cancelled_ = true;
+        }
+#ifdef MAPNIK_THREADSAFE
+        cond_.notify_all();
+#endif
+    }
+
     virtual int getNumFields() const
     {
         return rs_->getNumFields();
@@ -94,6 +130,13 @@ public:
         bool next_res = false;
         if (!rs_)
         {
+            if (error_)
+            {
+                // the query could not be sent for this request
+                std::exception_ptr error = error_;
+                error_ = std::exception_ptr();
+                std::rethrow_exception(error);
+            }
             // Ensure connection is valid
             if (conn_ && conn_->isOK())
             {
@@ -115,7 +158,6 @@ public:
                 return true;
             }
             close();
-            prepare_next();
         }
         return next_res;
     }
@@ -166,18 +208,62 @@ private:
     std::shared_ptr<Connection> conn_;
     std::string sql_;
     std::shared_ptr<ResultSet> rs_;
+    std::exception_ptr error_;
     bool is_closed_;
+    bool cancelled_;
+#ifdef MAPNIK_THREADSAFE
+    std::mutex mutex_;
+    std::condition_variable cond_;
+#endif
+
+    friend class postgis_processor_context;
 
+    // Sends the query of a queued request, possibly from another thread
+    // than the one reading it. Failures are rethrown by next().
     void prepare()
     {
-        conn_ = pool_->borrowObject();
-        if (conn_ && conn_->isOK())
+        std::shared_ptr<Connection> conn;
+        std::exception_ptr error;
+        try
         {
-            conn_->executeAsyncQuery(sql_, 1);
+            conn = pool_->borrowObject();
+            if (conn && conn->isOK())
+            {
+                conn->executeAsyncQuery(sql_, 1);
+            }
+            else
+            {
+                throw mapnik::datasource_exception("Postgis Plugin: bad connection");
+            }
         }
-        else
+        catch (...)
         {
-            throw mapnik::datasource_exception("Postgis Plugin: bad connection");
+            error = std::current_exception();
+        }
+        bool closed;
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            closed = is_closed_;
+            if (!closed)
+            {
+                if (error) error_ = error;
+                else conn_ = conn;
+            }
+        }
+#ifdef MAPNIK_THREADSAFE
+        cond_.notify_all();
+#endif
+        if (closed || error)
+        {
+            // nobody is going to read this result
+            if (conn && conn->isPending())
+            {
+                conn->close();
+            }
+            conn.reset();
+            prepare_next();
         }
     }
 
@@ -190,23 +276,45 @@ class postgis_processor_context : public mapnik::IProcessorContext
 {
 public:
     postgis_processor_context()
-        : num_async_requests_(0) {}
+        : num_async_requests_(0),
+          idle_connections_(0) {}
     ~postgis_processor_context() {}
 
+    // Queues a request until a connection is given up, or sends it right
+    // away when an earlier request already gave one up with the queue empty.
+    // Requests may finish on decoding threads while others are being added.
     void add_request(std::shared_ptr<AsyncResultSet> const& req)
     {
-        q_.push(req);
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            if (idle_connections_ == 0)
+            {
+                q_.push(req);
+                return;
+            }
+            --idle_connections_;
+        }
+        req->prepare();
     }
 
-    std::shared_ptr<AsyncResultSet> pop_next_request()
+    void release_connection()
     {
-        std::shared_ptr<AsyncResultSet> r;
-        if (!q_.empty())
+        std::shared_ptr<AsyncResultSet> next;
         {
-            r = q_.front();
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            if (q_.empty())
+            {
+                ++idle_connections_;
+                return;
+            }
+            next = q_.front();
             q_.pop();
         }
-        return r;
+        next->prepare();
     }
 
     int num_async_requests_;
@@ -214,17 +322,16 @@ public:
 private:
     using async_queue = std::queue<std::shared_ptr<AsyncResultSet> >;
     async_queue q_;
-
+    int idle_connections_;
+#ifdef MAPNIK_THREADSAFE
+    std::mutex mutex_;
+#endif
 };
 
 inline void AsyncResultSet::prepare_next()
 {
     // ensure cnx pool has unused cnx
-    std::shared_ptr<AsyncResultSet> next = ctx_->pop_next_request();
-    if (next)
-    {
-        next->prepare();
-    }
+    ctx_->release_connection();
 }
 
 #endif // POSTGIS_ASYNCRESULTSET_HPP
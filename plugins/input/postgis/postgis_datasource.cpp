@@ -31,6 +31,7 @@
 #include <mapnik/global.hpp>
 #include <mapnik/boolean.hpp>
 #include <mapnik/sql_utils.hpp>
+#include <mapnik/expression_sql.hpp>
 #include <mapnik/util/conversions.hpp>
 #include <mapnik/timer.hpp>
 #include <mapnik/value_types.hpp>
@@ -51,6 +52,7 @@
 #include <set>
 #include <sstream>
 #include <iomanip>
+#include <cmath>
 
 DATASOURCE_PLUGIN(postgis_datasource)
 
@@ -74,6 +76,9 @@ postgis_datasource::postgis_datasource(parameters const& params)
       srid_(*params.get<mapnik::value_integer>("srid", 0)),
       extent_initialized_(false),
       simplify_geometries_(false),
+      clip_geometries_(false),
+      snap_geometries_(false),
+      twkb_encoding_(false),
       desc_(postgis_datasource::name(), "utf-8"),
       creator_(params.get<std::string>("host"),
              params.get<std::string>("port"),
@@ -85,11 +90,13 @@ postgis_datasource::postgis_datasource(parameters const& params)
       scale_denom_token_("!scale_denominator!"),
       pixel_width_token_("!pixel_width!"),
       pixel_height_token_("!pixel_height!"),
+      filter_token_("!filter!"),
       pool_max_size_(*params_.get<mapnik::value_integer>("max_size", 10)),
       persist_connection_(*params.get<mapnik::boolean_type>("persist_connection", true)),
       extent_from_subquery_(*params.get<mapnik::boolean_type>("extent_from_subquery", false)),
       max_async_connections_(*params_.get<mapnik::value_integer>("max_async_connection", 1)),
       asynchronous_request_(false),
+      decode_queue_size_(*params_.get<mapnik::value_integer>("decode_queue_size", 1024)),
       // TODO - use for known tokens too: "(@\\w+|!\\w+!)"
       pattern_(boost::regex("(@\\w+)",boost::regex::normal | boost::regbase::icase)),
       // params below are for testing purposes only and may be removed at any time
@@ -122,6 +129,13 @@ postgis_datasource::postgis_datasource(parameters const& params)
             throw mapnik::datasource_exception(err.str());
         }
         asynchronous_request_ = true;
+#ifdef MAPNIK_THREADSAFE
+        if (decode_queue_size_ > 0)
+        {
+            // one decoding task per request that may hold a connection
+            decode_pool_ = std::make_shared<mapnik::prefetch_pool>(static_cast<std::size_t>(max_async_connections_));
+        }
+#endif
     }
 
     boost::optional<mapnik::value_integer> initial_size = params.get<mapnik::value_integer>("initial_size", 1);
@@ -130,6 +144,19 @@ postgis_datasource::postgis_datasource(parameters const& params)
     estimate_extent_ = estimate_extent && *estimate_extent;
     boost::optional<mapnik::boolean_type> simplify_opt = params.get<mapnik::boolean_type>("simplify_geometries", false);
     simplify_geometries_ = simplify_opt && *simplify_opt;
+    boost::optional<mapnik::boolean_type> clip_opt = params.get<mapnik::boolean_type>("clip_geometries", false);
+    clip_geometries_ = clip_opt && *clip_opt;
+    boost::optional<mapnik::boolean_type> snap_opt = params.get<mapnik::boolean_type>("snap_geometries", false);
+    snap_geometries_ = snap_opt && *snap_opt;
+    std::string geometry_format = *params.get<std::string>("geometry_format", "wkb");
+    if (geometry_format == "twkb")
+    {
+        twkb_encoding_ = true;
+    }
+    else if (geometry_format != "wkb")
+    {
+        throw mapnik::datasource_exception("PostGIS Plugin: unknown geometry_format '" + geometry_format + "', expected 'wkb' or 'twkb'");
+    }
 
     ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_);
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
@@ -558,6 +585,11 @@ std::string postgis_datasource::populate_tokens(std::string const& sql) const
         boost::algorithm::replace_all(populated_sql, pixel_height_token_, "0");
     }
 
+    if (boost::algorithm::icontains(sql, filter_token_))
+    {
+        boost::algorithm::replace_all(populated_sql, filter_token_, "1=1");
+    }
+
     std::string copy2 = populated_sql;
     std::list<std::string> l;
     boost::regex_split(std::back_inserter(l), copy2, pattern_);
@@ -577,10 +609,12 @@ std::string postgis_datasource::populate_tokens(
                                 box2d<double> const& env,
                                 double pixel_width,
                                 double pixel_height,
-                                mapnik::attributes const& vars) const
+                                mapnik::attributes const& vars,
+                                std::string const& filter) const
 {
     std::string populated_sql = sql;
     std::string box = sql_bbox(env);
+    bool has_where = false;
 
     if (boost::algorithm::icontains(populated_sql, scale_denom_token_))
     {
@@ -614,6 +648,7 @@ std::string postgis_datasource::populate_tokens(
         if (intersect_min_scale_ > 0 && (scale_denom <= intersect_min_scale_))
         {
             s << " WHERE ST_Intersects(\"" << geometryColumn_ << "\"," << box << ")";
+            has_where = true;
         }
         else if (intersect_max_scale_ > 0 && (scale_denom >= intersect_max_scale_))
         {
@@ -622,6 +657,7 @@ std::string postgis_datasource::populate_tokens(
         else
         {
             s << " WHERE \"" << geometryColumn_ << "\" && " << box;
+            has_where = true;
         }
         populated_sql += s.str();
     }
@@ -643,6 +679,17 @@ std::string postgis_datasource::populate_tokens(
             }
         }
     }
+
+    // after the variables, string literals in the filter may contain '@'
+    if (boost::algorithm::icontains(populated_sql, filter_token_))
+    {
+        boost::algorithm::replace_all(populated_sql, filter_token_, filter.empty() ? "1=1" : filter);
+    }
+    else if (!filter.empty())
+    {
+        populated_sql += has_where ? " AND " : " WHERE ";
+        populated_sql += filter;
+    }
     return populated_sql;
 }
 
@@ -793,22 +840,65 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         const double px_gw = 1.0 / std::get<0>(q.resolution());
         const double px_gh = 1.0 / std::get<1>(q.resolution());
 
-        s << "SELECT ST_AsBinary(";
+        if (twkb_encoding_)
+        {
+            s << "SELECT ST_AsTWKB(";
+        }
+        else
+        {
+            s << "SELECT ST_AsBinary(";
+        }
+
+        const double px_sz = std::min(px_gw, px_gh);
+        const bool snap = snap_geometries_ && px_sz > 0 && std::isfinite(px_sz);
+
+        if (snap) {
+          s << "ST_SnapToGrid(";
+        }
 
         if (simplify_geometries_) {
           s << "ST_Simplify(";
         }
 
+        if (clip_geometries_) {
+          s << "ST_ClipByBox2D(";
+        }
+
         s << "\"" << geometryColumn_ << "\"";
 
+        if (clip_geometries_) {
+          // the query extent already includes the buffer, polygons are
+          // cut where the renderer would clip them anyway
+          s << ", " << sql_bbox(box) << "::box2d)";
+        }
+
         if (simplify_geometries_) {
           // 1/20 of pixel seems to be a good compromise to avoid
           // drop of collapsed polygons.
           // See https://github.com/mapnik/mapnik/issues/1639
-          const double tolerance = std::min(px_gw, px_gh) / 20.0;
+          const double tolerance = px_sz / 20.0;
           s << ", " << tolerance << ")";
         }
 
+        if (snap) {
+          // a tenth of a pixel, consecutive vertices falling into the same
+          // cell are dropped
+          s << ", " << px_sz / 10.0 << ")";
+        }
+
+        if (twkb_encoding_)
+        {
+            // one decimal digit finer than the pixel size keeps vertices
+            // within a tenth of a pixel of their true position
+            int precision = 0;
+            if (px_sz > 0 && std::isfinite(px_sz))
+            {
+                precision = 1 - static_cast<int>(std::floor(std::log10(px_sz)));
+            }
+            // the encoding stores precision in four bits
+            s << ", " << std::max(-7, std::min(7, precision));
+        }
+
         s << ") AS geom";
 
         mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
@@ -839,7 +929,11 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             }
         }
 
-        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables());
+        // rows matching none of the rule filters are left in the database
+        std::string filter;
+        mapnik::to_sql_condition(q, desc_, filter, mapnik::sql_dialect::postgresql);
+
+        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables(), filter);
 
         s << " FROM " << table_with_bbox;
 
@@ -849,7 +943,18 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         }
 
         std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool, proc_ctx);
-        return std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty());
+        featureset_ptr features = std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(), twkb_encoding_);
+#ifdef MAPNIK_THREADSAFE
+        if (proc_ctx && decode_pool_)
+        {
+            // decode the rows on the decode pool while earlier layers render
+            return std::make_shared<postgis_decode_featureset>(std::static_pointer_cast<AsyncResultSet>(rs),
+                                                               features,
+                                                               decode_pool_,
+                                                               static_cast<std::size_t>(decode_queue_size_));
+        }
+#endif
+        return features;
 
     }
 
@@ -34,6 +34,7 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/value_types.hpp>
 #include <mapnik/attribute.hpp>
+#include <mapnik/featureset_prefetch.hpp>
 
 // boost
 #include <boost/optional.hpp>
@@ -84,7 +85,8 @@ private:
                                 box2d<double> const& env,
                                 double pixel_width,
                                 double pixel_height,
-                                mapnik::attributes const& vars) const;
+                                mapnik::attributes const& vars,
+                                std::string const& filter = std::string()) const;
     std::string populate_tokens(std::string const& sql) const;
     std::shared_ptr<IResultSet> get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr()) const;
     static const std::string GEOMETRY_COLUMNS;
@@ -107,18 +109,26 @@ private:
     mutable bool extent_initialized_;
     mutable mapnik::box2d<double> extent_;
     bool simplify_geometries_;
+    bool clip_geometries_;
+    bool snap_geometries_;
+    bool twkb_encoding_;
     layer_descriptor desc_;
     ConnectionCreator<Connection> creator_;
     const std::string bbox_token_;
     const std::string scale_denom_token_;
     const std::string pixel_width_token_;
     const std::string pixel_height_token_;
+    const std::string filter_token_;
     int pool_max_size_;
     bool persist_connection_;
     bool extent_from_subquery_;
     bool estimate_extent_;
     int max_async_connections_;
     bool asynchronous_request_;
+    mapnik::value_integer decode_queue_size_;
+#ifdef MAPNIK_THREADSAFE
+    std::shared_ptr<mapnik::prefetch_pool> decode_pool_;
+#endif
     boost::regex pattern_;
     int intersect_min_scale_;
     int intersect_max_scale_;
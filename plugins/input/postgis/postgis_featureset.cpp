@@ -23,6 +23,7 @@
 #include "postgis_featureset.hpp"
 #include "resultset.hpp"
 #include "cursorresultset.hpp"
+#include "asyncresultset.hpp"
  #include "numeric2string.hpp"
 
 // mapnik
@@ -48,27 +49,40 @@ using mapnik::context_ptr;
 postgis_featureset::postgis_featureset(std::shared_ptr<IResultSet> const& rs,
                                        context_ptr const& ctx,
                                        std::string const& encoding,
-                                       bool key_field)
+                                       bool key_field,
+                                       bool twkb_encoding)
     : rs_(rs),
       ctx_(ctx),
       tr_(new transcoder(encoding)),
       totalGeomSize_(0),
       feature_id_(1),
-      key_field_(key_field)
+      key_field_(key_field),
+      twkb_encoding_(twkb_encoding),
+      arena_(std::make_shared<mapnik::feature_arena>())
 {
 }
 
 feature_ptr postgis_featureset::next()
 {
+    unsigned num_attrs = ctx_->size() + 1;
     while (rs_->next())
     {
+        if (columns_.empty())
+        {
+            columns_.reserve(num_attrs);
+            for (unsigned i = 0; i < num_attrs; ++i)
+            {
+                columns_.emplace_back(rs_->getFieldName(i), rs_->getTypeOID(i));
+            }
+        }
+
         // new feature
         unsigned pos = 1;
         feature_ptr feature;
 
         if (key_field_)
         {
-            std::string name = rs_->getFieldName(pos);
+            std::string const& name = columns_[pos].first;
 
             // null feature id is not acceptable
             if (rs_->isNull(pos))
@@ -77,7 +91,7 @@ feature_ptr postgis_featureset::next()
                 continue;
             }
             // create feature with user driven id from attribute
-            int oid = rs_->getTypeOID(pos);
+            int oid = columns_[pos].second;
             const char* buf = rs_->getValue(pos);
 
             // validation happens of this type at initialization
@@ -96,7 +110,7 @@ feature_ptr postgis_featureset::next()
                 val = int4net(buf);
             }
 
-            feature = feature_factory::create(ctx_, val);
+            feature = feature_factory::create(ctx_, val, arena_);
             // TODO - extend feature class to know
             // that its id is also an attribute to avoid
             // this duplication
@@ -106,7 +120,7 @@ feature_ptr postgis_featureset::next()
         else
         {
             // fallback to auto-incrementing id
-            feature = feature_factory::create(ctx_, feature_id_);
+            feature = feature_factory::create(ctx_, feature_id_, arena_);
             ++feature_id_;
         }
 
@@ -121,21 +135,26 @@ feature_ptr postgis_featureset::next()
         int size = rs_->getFieldLength(0);
         const char *data = rs_->getValue(0);
 
-        mapnik::geometry::geometry<double> geometry = geometry_utils::from_wkb(data, size);
-        feature->set_geometry(std::move(geometry));
+        if (twkb_encoding_)
+        {
+            feature->set_geometry(geometry_utils::from_twkb(data, size));
+        }
+        else
+        {
+            feature->set_geometry(geometry_utils::from_wkb(data, size));
+        }
 
         totalGeomSize_ += size;
-        unsigned num_attrs = ctx_->size() + 1;
         for (; pos < num_attrs; ++pos)
         {
-            std::string name = rs_->getFieldName(pos);
+            std::string const& name = columns_[pos].first;
 
             // NOTE: we intentionally do not store null here
             // since it is equivalent to the attribute not existing
             if (!rs_->isNull(pos))
             {
                 const char* buf = rs_->getValue(pos);
-                const int oid = rs_->getTypeOID(pos);
+                const int oid = columns_[pos].second;
                 switch (oid)
                 {
                     case 16: //bool
@@ -223,3 +242,46 @@ postgis_featureset::~postgis_featureset()
 {
     rs_->close();
 }
+
+#ifdef MAPNIK_THREADSAFE
+postgis_decode_featureset::postgis_decode_featureset(std::shared_ptr<AsyncResultSet> const& rs,
+                                                     featureset_ptr const& decoder,
+                                                     std::shared_ptr<mapnik::prefetch_pool> const& pool,
+                                                     std::size_t max_size)
+    : mapnik::prefetch_featureset(max_size),
+      rs_(rs),
+      pool_(pool)
+{
+    mapnik::prefetch_queue_ptr queue = this->queue();
+    // the task owns the decoder, which closes the result set on the worker
+    pool_->post([rs, decoder, queue]
+    {
+        std::exception_ptr error;
+        try
+        {
+            // queued requests wait here until an earlier one is done
+            if (!queue->closed() && rs->wait_for_connection())
+            {
+                feature_ptr feature;
+                while ((feature = decoder->next()))
+                {
+                    if (!queue->push(feature)) break;
+                }
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        queue->done(error);
+    });
+}
+
+postgis_decode_featureset::~postgis_decode_featureset()
+{
+    // stop the task before releasing the pool: a closed queue makes push()
+    // return false and a cancelled request stops waiting for a connection
+    queue()->close();
+    rs_->cancel();
+}
+#endif
@@ -28,14 +28,22 @@
 #include <mapnik/datasource.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/unicode.hpp>
+#include <mapnik/featureset_prefetch.hpp>
+
+// stl
+#include <string>
+#include <utility>
+#include <vector>
 
 using mapnik::Featureset;
+using mapnik::featureset_ptr;
 using mapnik::box2d;
 using mapnik::feature_ptr;
 using mapnik::transcoder;
 using mapnik::context_ptr;
 
 class IResultSet;
+class AsyncResultSet;
 
 class postgis_featureset : public mapnik::Featureset
 {
@@ -43,7 +51,8 @@ public:
     postgis_featureset(std::shared_ptr<IResultSet> const& rs,
                        context_ptr const& ctx,
                        std::string const& encoding,
-                       bool key_field = false);
+                       bool key_field = false,
+                       bool twkb_encoding = false);
     feature_ptr next();
     ~postgis_featureset();
 
@@ -54,6 +63,31 @@ private:
     unsigned totalGeomSize_;
     mapnik::value_integer feature_id_;
     bool key_field_;
+    bool twkb_encoding_;
+    // name and type oid of each column, read once from the first row
+    std::vector<std::pair<std::string, int> > columns_;
+    mapnik::feature_arena_ptr arena_;
+};
+
+#ifdef MAPNIK_THREADSAFE
+// Reads the features of an asynchronous request from a task posted to the
+// datasource's decode pool, keeping up to max_size of them ahead of the
+// consumer. Rows are then decoded while the layers queried before are
+// still being rendered.
+class postgis_decode_featureset : public mapnik::prefetch_featureset
+{
+public:
+    postgis_decode_featureset(std::shared_ptr<AsyncResultSet> const& rs,
+                              featureset_ptr const& decoder,
+                              std::shared_ptr<mapnik::prefetch_pool> const& pool,
+                              std::size_t max_size);
+    ~postgis_decode_featureset();
+
+private:
+    std::shared_ptr<AsyncResultSet> rs_;
+    // outlives the task, which may still be running when this is destroyed
+    std::shared_ptr<mapnik::prefetch_pool> pool_;
 };
+#endif
 
 #endif // POSTGIS_FEATURESET_HPP
@@ -25,6 +25,7 @@
 #include <mapnik/util/utf_conv_win.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/util/trim.hpp>
+#include <mapnik/debug.hpp>
 
 #include "dbfile.hpp"
 
@@ -43,11 +44,22 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <cstring>
 #include <stdexcept>
 
+dbf_columns::dbf_columns(dbf_file const& dbf, std::vector<int> const& attr_ids, std::string const& encoding)
+    : tr(encoding)
+{
+    fields.reserve(attr_ids.size());
+    for (int col : attr_ids)
+    {
+        fields.push_back(dbf.descriptor(col));
+    }
+}
+
 dbf_file::dbf_file()
     : num_records_(0),
       num_fields_(0),
@@ -144,77 +156,101 @@ const field_descriptor& dbf_file::descriptor(int col) const
 
 void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feature_impl & f) const throw()
 {
-    using namespace boost::spirit;
-
     if (col>=0 && col<num_fields_)
     {
-        std::string const& name=fields_[col].name_;
-
-        // NOTE: ensure types handled here are matched in shape_datasource.cpp
-        switch (fields_[col].type_)
+        mapnik::value val;
+        // NOTE: null values are intentionally not stored
+        // since it is equivalent to the attribute not existing
+        if (decode(fields_[col], record_, tr, val))
         {
-        case 'C':
-        case 'D':
-        {
-            // FIXME - avoid constructing std::string on stack
-            std::string str(record_+fields_[col].offset_,fields_[col].length_);
-            mapnik::util::trim(str);
-            f.put(name,tr.transcode(str.c_str()));
-            break;
+            f.put(fields_[col].name_, std::move(val));
         }
-        case 'L':
+    }
+}
+
+void dbf_file::add_attributes(dbf_columns const& columns, mapnik::feature_impl & f) const
+{
+    try
+    {
+        for (field_descriptor const& desc : columns.fields)
         {
-            char ch = record_[fields_[col].offset_];
-            if ( ch == '1' || ch == 't' || ch == 'T' || ch == 'y' || ch == 'Y')
-            {
-                f.put(name,true);
-            }
-            else
+            mapnik::value val;
+            // NOTE: null values are intentionally not stored
+            // since it is equivalent to the attribute not existing
+            if (decode(desc, record_, columns.tr, val))
             {
-                // NOTE: null logical fields use '?'
-                f.put(name,false);
+                f.put(desc.name_, std::move(val));
             }
-            break;
         }
-        case 'N': // numeric
-        case 'O': // double
-        case 'F': // float
-        {
+    }
+    catch (...)
+    {
+        MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
+    }
+}
 
-            if (record_[fields_[col].offset_] == '*')
-            {
-                // NOTE: we intentionally do not store null here
-                // since it is equivalent to the attribute not existing
-                break;
-            }
-            if ( fields_[col].dec_>0 )
+bool dbf_file::decode(field_descriptor const& desc, const char* record,
+                      mapnik::transcoder const& tr, mapnik::value & val)
+{
+    using namespace boost::spirit;
+
+    const char *itr = record + desc.offset_;
+    const char *end = itr + desc.length_;
+
+    // NOTE: ensure types handled here are matched in shape_datasource.cpp
+    switch (desc.type_)
+    {
+    case 'C':
+    case 'D':
+    {
+        // trimmed in place rather than through a std::string, the value
+        // still ends at the first NUL
+        while (end != itr && !mapnik::util::not_whitespace(*(end - 1))) --end;
+        itr = std::find_if(itr, end, mapnik::util::not_whitespace);
+        end = std::find(itr, end, '\0');
+        val = tr.transcode(itr, static_cast<std::int32_t>(end - itr));
+        return true;
+    }
+    case 'L':
+    {
+        char ch = *itr;
+        // NOTE: null logical fields use '?'
+        val = (ch == '1' || ch == 't' || ch == 'T' || ch == 'y' || ch == 'Y');
+        return true;
+    }
+    case 'N': // numeric
+    case 'O': // double
+    case 'F': // float
+    {
+        if (*itr == '*')
+        {
+            return false;
+        }
+        ascii::space_type space;
+        if (desc.dec_ > 0)
+        {
+            double d = 0.0;
+            static qi::double_type double_;
+            if (qi::phrase_parse(itr, end, double_, space, d))
             {
-                double val = 0.0;
-                const char *itr = record_+fields_[col].offset_;
-                const char *end = itr + fields_[col].length_;
-                ascii::space_type space;
-                static qi::double_type double_;
-                if (qi::phrase_parse(itr,end,double_,space,val))
-                {
-                    f.put(name,val);
-                }
+                val = d;
+                return true;
             }
-            else
+        }
+        else
+        {
+            mapnik::value_integer i = 0;
+            static qi::int_parser<mapnik::value_integer,10,1,-1> numeric_parser;
+            if (qi::phrase_parse(itr, end, numeric_parser, space, i))
             {
-                mapnik::value_integer val = 0;
-                const char *itr = record_+fields_[col].offset_;
-                const char *end = itr + fields_[col].length_;
-                ascii::space_type space;
-                static qi::int_parser<mapnik::value_integer,10,1,-1> numeric_parser;
-                if (qi::phrase_parse(itr, end, numeric_parser, space, val))
-                {
-                    f.put(name,val);
-                }
+                val = i;
+                return true;
             }
-            break;
-        }
         }
+        return false;
+    }
     }
+    return false;
 }
 
 void dbf_file::read_header()
@@ -36,6 +36,7 @@
 #endif
 
 // stl
+#include <memory>
 #include <vector>
 #include <string>
 #include <cassert>
@@ -52,6 +53,23 @@ struct field_descriptor
 };
 
 
+class dbf_file;
+
+// Requested DBF columns with the converter for their strings. Each
+// featureset owns one, so attributes are decoded on the thread producing
+// the features and no converter is shared between threads. Values are
+// decoded when the feature is built, not when they are first read: that
+// would need a converter per feature and a synchronised feature_impl::get().
+struct dbf_columns : private mapnik::util::noncopyable
+{
+    dbf_columns(dbf_file const& dbf, std::vector<int> const& attr_ids, std::string const& encoding);
+
+    std::vector<field_descriptor> fields;
+    mapnik::transcoder tr;
+};
+
+using dbf_columns_ptr = std::unique_ptr<dbf_columns>;
+
 class dbf_file : private mapnik::util::noncopyable
 {
 private:
@@ -77,6 +95,12 @@ public:
     void move_to(int index);
     std::string string_value(int col) const;
     void add_attribute(int col, mapnik::transcoder const& tr, mapnik::feature_impl & f) const throw();
+    // decodes the current record's values of columns into f, only the
+    // requested columns are parsed and transcoded
+    void add_attributes(dbf_columns const& columns, mapnik::feature_impl & f) const;
+    // decodes the value of field desc in record, false for empty or unparsable values
+    static bool decode(field_descriptor const& desc, const char* record,
+                       mapnik::transcoder const& tr, mapnik::value & val);
 private:
     void read_header();
     int read_short();
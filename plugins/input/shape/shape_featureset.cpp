@@ -47,14 +47,18 @@ shape_featureset<filterT>::shape_featureset(filterT const& filter,
       shape_(shape_name, false),
       query_ext_(),
       feature_bbox_(),
-      tr_(new transcoder(encoding)),
       file_length_(file_length),
       row_limit_(row_limit),
       count_(0),
-      ctx_(std::make_shared<mapnik::context_type>())
+      ctx_(std::make_shared<mapnik::context_type>()),
+      arena_(std::make_shared<mapnik::feature_arena>())
 {
     shape_.shp().skip(100);
     setup_attributes(ctx_, attribute_names, shape_name, shape_,attr_ids_);
+    if (!attr_ids_.empty())
+    {
+        columns_ = std::make_unique<dbf_columns>(shape_.dbf(), attr_ids_, encoding);
+    }
 }
 
 template <typename filterT>
@@ -76,7 +80,7 @@ feature_ptr shape_featureset<filterT>::next()
         // skip null shapes
         if (type == shape_io::shape_null) continue;
 
-        feature_ptr feature(feature_factory::create(ctx_, shape_.id_));
+        feature_ptr feature(feature_factory::create(ctx_, shape_.id_, arena_));
         switch (type)
         {
         case shape_io::shape_point:
@@ -133,22 +137,10 @@ feature_ptr shape_featureset<filterT>::next()
 
         // FIXME: https://github.com/mapnik/mapnik/issues/1020
         feature->set_id(shape_.id_);
-        if (attr_ids_.size())
+        if (columns_)
         {
             shape_.dbf().move_to(shape_.id_);
-            std::vector<int>::const_iterator itr = attr_ids_.begin();
-            std::vector<int>::const_iterator end = attr_ids_.end();
-            try
-            {
-                for (; itr != end; ++itr)
-                {
-                    shape_.dbf().add_attribute(*itr, *tr_, *feature); //TODO optimize!!!
-                }
-            }
-            catch (...)
-            {
-                MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
-            }
+            shape_.dbf().add_attributes(*columns_, *feature);
         }
         ++count_;
         return feature;
@@ -60,12 +60,13 @@ private:
     shape_io shape_;
     box2d<double> query_ext_;
     mutable box2d<double> feature_bbox_;
-    const std::unique_ptr<transcoder> tr_;
     long file_length_;
     std::vector<int> attr_ids_;
+    dbf_columns_ptr columns_;
     mapnik::value_integer row_limit_;
     mutable int count_;
     context_ptr ctx_;
+    mapnik::feature_arena_ptr arena_;
 };
 
 #endif //SHAPE_FEATURESET_HPP
@@ -40,6 +40,7 @@
 #include "shape_index_featureset.hpp"
 #include "shape_utils.hpp"
 #include "shp_index.hpp"
+#include "shp_packed_index.hpp"
 
 using mapnik::feature_factory;
 
@@ -53,32 +54,77 @@ shape_index_featureset<filterT>::shape_index_featureset(filterT const& filter,
     : filter_(filter),
       ctx_(std::make_shared<mapnik::context_type>()),
     shape_ptr_(std::move(shape_ptr)),
-    tr_(new mapnik::transcoder(encoding)),
     row_limit_(row_limit),
     count_(0),
-    feature_bbox_()
+    feature_bbox_(),
+    arena_(std::make_shared<mapnik::feature_arena>())
 {
     shape_ptr_->shp().skip(100);
     setup_attributes(ctx_, attribute_names, shape_name, *shape_ptr_,attr_ids_);
+    if (!attr_ids_.empty())
+    {
+        columns_ = std::make_unique<dbf_columns>(shape_ptr_->dbf(), attr_ids_, encoding);
+    }
 
     auto index = shape_ptr_->index();
     if (index)
     {
 #ifdef SHAPE_MEMORY_MAPPED_FILE
-        //shp_index<filterT,stream<mapped_file_source> >::query(filter, index->file(), offsets_);
-        shp_index<filterT,boost::interprocess::ibufferstream>::query(filter, index->file(), offsets_);
+        // version 2 indexes are queried in place
+        auto buffer = index->file().buffer();
+        if (shp_packed_index::is_packed(buffer.first, buffer.second))
+        {
+            query_packed(shp_packed_index(buffer.first, buffer.second));
+        }
+        else
+        {
+            //shp_index<filterT,stream<mapped_file_source> >::query(filter, index->file(), offsets_);
+            shp_index<filterT,boost::interprocess::ibufferstream>::query(filter, index->file(), offsets_);
+            std::sort(offsets_.begin(), offsets_.end());
+        }
 #else
-        shp_index<filterT,std::ifstream>::query(filter, index->file(), offsets_);
+        // version 2 indexes are queried through seeks like the quadtree
+        if (shp_packed_index::is_packed(index->file()))
+        {
+            query_packed(shp_packed_index(index->file()));
+        }
+        else
+        {
+            shp_index<filterT,std::ifstream>::query(filter, index->file(), offsets_);
+            std::sort(offsets_.begin(), offsets_.end());
+        }
 #endif
     }
 
-    std::sort(offsets_.begin(), offsets_.end());
-
     MAPNIK_LOG_DEBUG(shape) << "shape_index_featureset: Query size=" << offsets_.size();
 
     itr_ = offsets_.begin();
 }
 
+template <typename filterT>
+void shape_index_featureset<filterT>::query_packed(shp_packed_index const& index)
+{
+    if (index.query(filter_, offsets_)) return;
+    MAPNIK_LOG_ERROR(shape) << "shape_index_featureset: Invalid, truncated or outdated index, scanning all records (rebuild it with shapeindex)";
+    // every record is visited, next() still filters them by their box
+    offsets_.clear();
+    shape_file & shp = shape_ptr_->shp();
+    shp.seek(24);
+    std::streampos file_length = static_cast<std::streamoff>(shp.read_xdr_integer()) * 2;
+    std::streampos pos = 100;
+    while (pos + static_cast<std::streamoff>(8) <= file_length)
+    {
+        // record number, then content length in 16 bit words
+        shp.seek(pos + static_cast<std::streamoff>(4));
+        int length = shp.read_xdr_integer();
+        if (!shp.file() || length < 0) break;
+        offsets_.push_back(pos);
+        pos += static_cast<std::streamoff>(8 + static_cast<std::streamoff>(length) * 2);
+    }
+    // a short file leaves the stream failed for the reads in next()
+    shp.file().clear();
+}
+
 template <typename filterT>
 feature_ptr shape_index_featureset<filterT>::next()
 {
@@ -93,7 +139,7 @@ feature_ptr shape_index_featureset<filterT>::next()
         shape_file::record_type record(shape_ptr_->reclength_ * 2);
         shape_ptr_->shp().read_record(record);
         int type = record.read_ndr_integer();
-        feature_ptr feature(feature_factory::create(ctx_,shape_ptr_->id_));
+        feature_ptr feature(feature_factory::create(ctx_,shape_ptr_->id_,arena_));
 
         switch (type)
         {
@@ -103,6 +149,8 @@ feature_ptr shape_index_featureset<filterT>::next()
         {
             double x = record.read_double();
             double y = record.read_double();
+            // only needed when all records are scanned
+            if (!filter_.pass(mapnik::box2d<double>(x,y,x,y))) continue;
             feature->set_geometry(mapnik::geometry::point<double>(x,y));
             break;
         }
@@ -148,22 +196,10 @@ feature_ptr shape_index_featureset<filterT>::next()
 
         // FIXME: https://github.com/mapnik/mapnik/issues/1020
         feature->set_id(shape_ptr_->id_);
-        if (attr_ids_.size())
+        if (columns_)
         {
             shape_ptr_->dbf().move_to(shape_ptr_->id_);
-            std::vector<int>::const_iterator itr = attr_ids_.begin();
-            std::vector<int>::const_iterator end = attr_ids_.end();
-            try
-            {
-                for (; itr!=end; ++itr)
-                {
-                    shape_ptr_->dbf().add_attribute(*itr, *tr_, *feature);
-                }
-            }
-            catch (...)
-            {
-                MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
-            }
+            shape_ptr_->dbf().add_attributes(*columns_, *feature);
         }
         ++count_;
         return feature;
@@ -45,6 +45,8 @@ using mapnik::box2d;
 using mapnik::feature_ptr;
 using mapnik::context_ptr;
 
+class shp_packed_index;
+
 template <typename filterT>
 class shape_index_featureset : public Featureset
 {
@@ -59,16 +61,19 @@ public:
     feature_ptr next();
 
 private:
+    void query_packed(shp_packed_index const& index);
+
     filterT filter_;
     context_ptr ctx_;
     std::unique_ptr<shape_io> shape_ptr_;
-    const std::unique_ptr<mapnik::transcoder> tr_;
     std::vector<std::streampos> offsets_;
     std::vector<std::streampos>::iterator itr_;
     std::vector<int> attr_ids_;
+    dbf_columns_ptr columns_;
     mapnik::value_integer row_limit_;
     mutable int count_;
     mutable box2d<double> feature_bbox_;
+    mapnik::feature_arena_ptr arena_;
 };
 
 #endif // SHAPE_INDEX_FEATURESET_HPP
@@ -64,7 +64,12 @@ shape_io::~shape_io() {}
 
 void shape_io::move_to(std::streampos pos)
 {
-    shp_.seek(pos);
+    // index queries return offsets in file order, so runs of adjacent
+    // records are read without seeking (which drops the stream buffer)
+    if (shp_.pos() != pos)
+    {
+        shp_.seek(pos);
+    }
     id_ = shp_.read_xdr_integer();
     reclength_ = shp_.read_xdr_integer();
 }
@@ -79,6 +84,24 @@ dbf_file& shape_io::dbf()
     return dbf_;
 }
 
+bool shape_io::valid_parts(shape_file::record_type const& record, int num_parts, int num_points)
+{
+    if (num_parts <= 0 || num_points < 0) return false;
+    std::size_t parts = record.pos;
+    std::size_t needed = 4 * static_cast<std::size_t>(num_parts) + 16 * static_cast<std::size_t>(num_points);
+    if (record.size < parts || record.size - parts < needed) return false;
+    // part indices must be ascending and within the points, so every part
+    // reads its points straight from the record without checks
+    int last = 0;
+    for (int k = 0; k < num_parts; ++k)
+    {
+        int start = record.ndr_integer_at(parts + 4 * k);
+        if (start < last || start > num_points) return false;
+        last = start;
+    }
+    return true;
+}
+
 void shape_io::read_bbox(shape_file::record_type & record, mapnik::box2d<double> & bbox)
 {
     double lox = record.read_double();
@@ -93,6 +116,7 @@ mapnik::geometry::geometry<double> shape_io::read_polyline(shape_file::record_ty
     mapnik::geometry::geometry<double> geom; // default empty
     int num_parts = record.read_ndr_integer();
     int num_points = record.read_ndr_integer();
+    if (!valid_parts(record, num_parts, num_points)) return geom;
 
     if (num_parts == 1)
     {
@@ -109,22 +133,15 @@ mapnik::geometry::geometry<double> shape_io::read_polyline(shape_file::record_ty
     }
     else
     {
-        std::vector<int> parts;
-        parts.resize(num_parts);
-        std::for_each(parts.begin(), parts.end(), [&](int & part) { part = record.read_ndr_integer();});
-        int start, end;
+        // part indices are read in place, see valid_parts
+        std::size_t parts = record.pos;
+        record.skip(4 * num_parts);
         mapnik::geometry::multi_line_string<double> multi_line;
+        multi_line.reserve(num_parts);
         for (int k = 0; k < num_parts; ++k)
         {
-            start = parts[k];
-            if (k == num_parts - 1)
-            {
-                end = num_points;
-            }
-            else
-            {
-                end = parts[k + 1];
-            }
+            int start = record.ndr_integer_at(parts + 4 * k);
+            int end = (k == num_parts - 1) ? num_points : record.ndr_integer_at(parts + 4 * (k + 1));
 
             mapnik::geometry::line_string<double> line;
             line.reserve(end - start);
@@ -147,18 +164,16 @@ mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_typ
     mapnik::geometry::geometry<double> geom; // default empty
     int num_parts = record.read_ndr_integer();
     int num_points = record.read_ndr_integer();
+    if (!valid_parts(record, num_parts, num_points)) return geom;
 
-    std::vector<int> parts;
-    parts.resize(num_parts);
-    std::for_each(parts.begin(), parts.end(), [&](int & part) { part = record.read_ndr_integer();});
+    std::size_t parts = record.pos;
+    record.skip(4 * num_parts);
     mapnik::geometry::polygon<double> poly;
     mapnik::geometry::multi_polygon<double> multi_poly;
     for (int k = 0; k < num_parts; ++k)
     {
-        int start = parts[k];
-        int end;
-        if (k == num_parts - 1) end = num_points;
-        else end = parts[k + 1];
+        int start = record.ndr_integer_at(parts + 4 * k);
+        int end = (k == num_parts - 1) ? num_points : record.ndr_integer_at(parts + 4 * (k + 1));
 
         mapnik::geometry::linear_ring<double> ring;
         ring.reserve(end - start);
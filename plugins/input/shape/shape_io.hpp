@@ -78,6 +78,7 @@ public:
     static void read_bbox(shape_file::record_type & record, mapnik::box2d<double> & bbox);
     static mapnik::geometry::geometry<double> read_polyline(shape_file::record_type & record);
     static mapnik::geometry::geometry<double> read_polygon(shape_file::record_type & record);
+    static bool valid_parts(shape_file::record_type const& record, int num_parts, int num_points);
 
     shapeType type_;
     shape_file shp_;
@@ -28,6 +28,7 @@
 #include <fstream>
 #include <stdexcept>
 #include <cstdint>
+#include <vector>
 
 // mapnik
 #include <mapnik/global.hpp>
@@ -51,18 +52,14 @@ using mapnik::read_double_ndr;
 using mapnik::read_double_xdr;
 
 
+// Records are views: they point into the mapped file or into a buffer
+// owned by shape_file and reused for every record, so reading a record
+// neither allocates nor (when mapped) copies.
 struct RecordTag
 {
     using data_type = char*;
-    static data_type alloc(unsigned size)
-    {
-        return static_cast<data_type>(::operator new(sizeof(char)*size));
-    }
-
-    static void dealloc(data_type data)
-    {
-        ::operator delete(data);
-    }
+    static data_type alloc(unsigned) { return 0; }
+    static void dealloc(data_type) {}
 };
 
 struct MappedRecordTag
@@ -113,6 +110,14 @@ struct shape_record
         return val;
     }
 
+    // reads the integer at offset without moving pos
+    int ndr_integer_at(std::size_t offset) const
+    {
+        std::int32_t val;
+        read_int32_ndr(&data[offset], val);
+        return val;
+    }
+
     int read_xdr_integer()
     {
         std::int32_t val;
@@ -148,6 +153,7 @@ public:
 #else
     using file_source_type = std::ifstream;
     using record_type = shape_record<RecordTag>;
+    std::vector<char> record_buffer_;
 #endif
 
     file_source_type file_;
@@ -198,10 +204,16 @@ public:
     inline void read_record(record_type& rec)
     {
 #ifdef SHAPE_MEMORY_MAPPED_FILE
-        rec.set_data(file_.buffer().first + file_.tellg());
+        std::size_t offset = static_cast<std::size_t>(file_.tellg());
+        std::size_t available = offset < file_.buffer().second ? file_.buffer().second - offset : 0;
+        // a truncated file yields a short record rather than reads past the mapping
+        if (rec.size > available) rec.size = available;
+        rec.set_data(file_.buffer().first + offset);
         file_.seekg(rec.size, std::ios::cur);
 #else
-        file_.read(rec.get_data(), rec.size);
+        if (record_buffer_.size() < rec.size) record_buffer_.resize(rec.size);
+        file_.read(record_buffer_.data(), rec.size);
+        rec.set_data(record_buffer_.data());
 #endif
     }
 
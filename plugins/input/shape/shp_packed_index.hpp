@@ -0,0 +1,95 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef SHP_PACKED_INDEX_HPP
+#define SHP_PACKED_INDEX_HPP
+
+// mapnik
+#include <mapnik/packed_index_file.hpp>
+
+// stl
+#include <algorithm>
+#include <istream>
+#include <vector>
+
+// Version 2 of the .index format written by shapeindex --rtree, a
+// mapnik::packed_index_file whose items are the offset and the record
+// number of each shp record. Unlike the sidecars of other plugins it is
+// not rebuilt when the shapefile changes, its recorded size only bounds
+// the offsets.
+class shp_packed_index : public mapnik::packed_index_file
+{
+public:
+    // index held in memory, e.g. a memory mapped file
+    shp_packed_index(char const* data, std::size_t size)
+        : packed_index_file(magic(), offset_and_id, data, size) {}
+
+    // index read through seeks on in, starting at its current position
+    explicit shp_packed_index(std::istream & in)
+        : packed_index_file(magic(), offset_and_id, in) {}
+
+    // true if the data is a packed index rather than a quadtree, which
+    // is not necessarily valid, e.g. when written by another version
+    static bool is_packed(char const* data, std::size_t size)
+    {
+        return has_magic(magic(), data, size);
+    }
+
+    // same for a stream, which is left at its current position
+    static bool is_packed(std::istream & in)
+    {
+        return has_magic(magic(), in);
+    }
+
+    // Appends the offsets of the records whose box passes the filter, in
+    // file order. Returns false, leaving pos untouched, when the index can
+    // not be read or is inconsistent; callers should not trust it then.
+    template <typename filterT>
+    bool query(filterT const& filter, std::vector<std::streampos> & pos) const
+    {
+        std::vector<std::streampos> result;
+        if (!search(filter, [&result](mapnik::box2d<double> const&, std::uint64_t offset, std::uint64_t)
+                    {
+                        result.push_back(static_cast<std::streamoff>(offset));
+                        return true;
+                    }))
+        {
+            return false;
+        }
+        std::sort(result.begin(), result.end());
+        pos.insert(pos.end(), result.begin(), result.end());
+        return true;
+    }
+
+    static void write(std::ostream & out,
+                      mapnik::packed_rtree<item_type> const& tree,
+                      std::uint64_t file_size, std::int64_t file_mtime, std::uint64_t file_hash)
+    {
+        packed_index_file::write(out, magic(), tree, tree.extent(), {}, file_size, file_mtime, file_hash);
+    }
+
+private:
+    static char const* magic() { return "mapnik-rtree"; }
+};
+
+#endif // SHP_PACKED_INDEX_HPP
@@ -29,6 +29,7 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/boolean.hpp>
 #include <mapnik/sql_utils.hpp>
+#include <mapnik/expression_sql.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
 #include <mapnik/timer.hpp>
 #include <mapnik/wkb.hpp>
@@ -67,6 +68,7 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
       row_offset_(*params.get<mapnik::value_integer>("row_offset", 0)),
       row_limit_(*params.get<mapnik::value_integer>("row_limit", 0)),
       intersects_token_("!intersects!"),
+      filter_token_("!filter!"),
       desc_(sqlite_datasource::name(), *params.get<std::string>("encoding", "utf-8")),
       format_(mapnik::wkbAuto)
 {
@@ -364,6 +366,10 @@ std::string sqlite_datasource::populate_tokens(std::string const& sql) const
         // replace with dummy comparison that is true
         boost::algorithm::ireplace_first(populated_sql, intersects_token_, "1=1");
     }
+    if (boost::algorithm::ifind_first(populated_sql, filter_token_))
+    {
+        boost::algorithm::ireplace_all(populated_sql, filter_token_, "1=1");
+    }
     return populated_sql;
 }
 
@@ -508,7 +514,16 @@ featureset_ptr sqlite_datasource::features(query const& q) const
         }
         s << " FROM ";
 
+        // rows matching none of the rule filters are left in the database
+        std::string filter;
+        mapnik::to_sql_condition(q, desc_, filter);
+
         std::string query(table_);
+        bool has_filter_token = boost::algorithm::ifind_first(query, filter_token_);
+        if (has_filter_token)
+        {
+            boost::algorithm::ireplace_all(query, filter_token_, filter.empty() ? "1=1" : filter);
+        }
 
         if (! key_field_.empty() && has_spatial_index_)
         {
@@ -523,11 +538,19 @@ featureset_ptr sqlite_datasource::features(query const& q) const
         }
         else
         {
-            query = populate_tokens(table_);
+            query = populate_tokens(query);
         }
 
         s << query ;
 
+        if (!filter.empty() && !has_filter_token)
+        {
+            // the filter columns are among the selected ones
+            std::string select = s.str();
+            s.str("");
+            s << "SELECT * FROM (" << select << ") WHERE " << filter;
+        }
+
         if (row_limit_ > 0)
         {
             s << " LIMIT " << row_limit_;
@@ -590,6 +613,7 @@ featureset_ptr sqlite_datasource::features_at_point(coord2d const& pt, double to
         s << " FROM ";
 
         std::string query(table_);
+        boost::algorithm::ireplace_all(query, filter_token_, "1=1");
 
         if (! key_field_.empty() && has_spatial_index_)
         {
@@ -604,7 +628,7 @@ featureset_ptr sqlite_datasource::features_at_point(coord2d const& pt, double to
         }
         else
         {
-            query = populate_tokens(table_);
+            query = populate_tokens(query);
         }
 
         s << query ;
@@ -80,6 +80,7 @@ private:
     mapnik::value_integer row_limit_;
     // TODO - also add to postgis.input
     const std::string intersects_token_;
+    const std::string filter_token_;
     mapnik::layer_descriptor desc_;
     mapnik::wkbFormat format_;
     bool use_spatial_index_;
@@ -0,0 +1,226 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef TOPOJSON_ARCS_HPP
+#define TOPOJSON_ARCS_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/json/topology.hpp>
+
+// stl
+#include <cstddef>
+#include <vector>
+
+// Arcs of a topology decoded once into absolute coordinates, so features
+// sharing an arc don't undo the delta encoding and quantization again.
+// The coordinates of all arcs are kept in one array, along with the
+// bounding box of each arc.
+class topojson_arcs
+{
+public:
+    using coordinate = mapnik::topojson::coordinate;
+    using index_type = mapnik::topojson::index_type;
+
+    topojson_arcs() {}
+
+    explicit topojson_arcs(mapnik::topojson::topology const& topo)
+    {
+        std::size_t num_coords = 0;
+        for (auto const& arc : topo.arcs)
+        {
+            num_coords += arc.coordinates.size();
+        }
+        coords_.reserve(num_coords);
+        offsets_.reserve(topo.arcs.size() + 1);
+        boxes_.reserve(topo.arcs.size());
+        offsets_.push_back(0);
+        for (auto const& arc : topo.arcs)
+        {
+            double px = 0, py = 0;
+            mapnik::box2d<double> box;
+            bool first = true;
+            for (auto const& pt : arc.coordinates)
+            {
+                double x = pt.x;
+                double y = pt.y;
+                if (topo.tr)
+                {
+                    x = (px += x) * (*topo.tr).scale_x + (*topo.tr).translate_x;
+                    y = (py += y) * (*topo.tr).scale_y + (*topo.tr).translate_y;
+                }
+                coords_.push_back(coordinate{x, y});
+                if (first)
+                {
+                    first = false;
+                    box.init(x, y, x, y);
+                }
+                else
+                {
+                    box.expand_to_include(x, y);
+                }
+            }
+            offsets_.push_back(coords_.size());
+            boxes_.push_back(box);
+        }
+    }
+
+    std::size_t size() const
+    {
+        return boxes_.size();
+    }
+
+    // arc referenced by index, negative ones refer to arc ~index reversed
+    static std::size_t arc_index(index_type index)
+    {
+        return static_cast<std::size_t>(index < 0 ? ~index : index);
+    }
+
+    bool valid(index_type index) const
+    {
+        return arc_index(index) < size();
+    }
+
+    coordinate const* begin(std::size_t arc) const
+    {
+        return coords_.data() + offsets_[arc];
+    }
+
+    coordinate const* end(std::size_t arc) const
+    {
+        return coords_.data() + offsets_[arc + 1];
+    }
+
+    std::size_t num_coords(std::size_t arc) const
+    {
+        return offsets_[arc + 1] - offsets_[arc];
+    }
+
+    mapnik::box2d<double> const& box(std::size_t arc) const
+    {
+        return boxes_[arc];
+    }
+
+    // adds the box of the arc referenced by index to bbox
+    void expand(mapnik::box2d<double> & bbox, index_type index) const
+    {
+        if (!valid(index)) return;
+        mapnik::box2d<double> const& arc_box = boxes_[arc_index(index)];
+        if (!arc_box.valid()) return;
+        if (bbox.valid()) bbox.expand_to_include(arc_box);
+        else bbox = arc_box;
+    }
+
+private:
+    std::vector<coordinate> coords_;
+    std::vector<std::size_t> offsets_;
+    std::vector<mapnik::box2d<double> > boxes_;
+};
+
+// Bounding boxes of topology geometries, from the boxes of their arcs.
+struct topojson_bounding_box_visitor
+{
+    topojson_bounding_box_visitor(mapnik::topojson::topology const& topo, topojson_arcs const& arcs)
+        : topo_(topo),
+          arcs_(arcs) {}
+
+    mapnik::box2d<double> operator() (mapnik::topojson::point const& pt) const
+    {
+        double x = pt.coord.x;
+        double y = pt.coord.y;
+        if (topo_.tr)
+        {
+            x =  x * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
+            y =  y * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
+        }
+        return mapnik::box2d<double>(x, y, x, y);
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::multi_point const& multi_pt) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto const& pt : multi_pt.points)
+        {
+            mapnik::box2d<double> box = (*this)(mapnik::topojson::point{pt, boost::none});
+            if (bbox.valid()) bbox.expand_to_include(box);
+            else bbox = box;
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::linestring const& line) const
+    {
+        mapnik::box2d<double> bbox;
+        arcs_.expand(bbox, line.ring);
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::multi_linestring const& multi_line) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto index : multi_line.rings)
+        {
+            arcs_.expand(bbox, index);
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::polygon const& poly) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto const& ring : poly.rings)
+        {
+            for (auto index : ring)
+            {
+                arcs_.expand(bbox, index);
+            }
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::multi_polygon const& multi_poly) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto const& poly : multi_poly.polygons)
+        {
+            for (auto const& ring : poly)
+            {
+                for (auto index : ring)
+                {
+                    arcs_.expand(bbox, index);
+                }
+            }
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::invalid const&) const
+    {
+        return mapnik::box2d<double>();
+    }
+
+private:
+    mapnik::topojson::topology const& topo_;
+    topojson_arcs const& arcs_;
+};
+
+#endif // TOPOJSON_ARCS_HPP
@@ -198,6 +198,10 @@ void topojson_datasource::parse_topojson(T const& buffer)
         throw mapnik::datasource_exception("topojson_datasource: Failed parse TopoJSON file '" + filename_ + "'");
     }
 
+    // decode arcs once, features are built from the decoded coordinates
+    arcs_ = topojson_arcs(topo_);
+    std::vector<mapnik::topojson::arc>().swap(topo_.arcs);
+
     using values_container = std::vector< std::pair<box_type, std::size_t> >;
     values_container values;
     values.reserve(topo_.geometries.size());
@@ -206,7 +210,7 @@ void topojson_datasource::parse_topojson(T const& buffer)
 
     for (auto const& geom : topo_.geometries)
     {
-        mapnik::box2d<double> box = mapnik::util::apply_visitor(mapnik::topojson::bounding_box_visitor(topo_), geom);
+        mapnik::box2d<double> box = mapnik::util::apply_visitor(topojson_bounding_box_visitor(topo_, arcs_), geom);
         if (box.valid())
         {
             if (geometry_index == 0)
@@ -286,7 +290,7 @@ mapnik::featureset_ptr topojson_datasource::features(mapnik::query const& q) con
         if (tree_)
         {
             tree_->query(boost::geometry::index::intersects(box),std::back_inserter(index_array));
-            return std::make_shared<topojson_featureset>(topo_, *tr_, std::move(index_array));
+            return std::make_shared<topojson_featureset>(topo_, arcs_, *tr_, box, std::move(index_array));
         }
     }
     // otherwise return an empty featureset pointer
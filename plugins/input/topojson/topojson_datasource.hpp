@@ -33,6 +33,8 @@
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/json/topology.hpp>
+#include "topojson_arcs.hpp"
+
 // boost
 #include <boost/optional.hpp>
 #pragma GCC diagnostic push
@@ -84,6 +86,7 @@ private:
     mapnik::box2d<double> extent_;
     std::unique_ptr<mapnik::transcoder> tr_;
     mapnik::topojson::topology topo_;
+    topojson_arcs arcs_;
     std::unique_ptr<spatial_index_type> tree_;
 };
 
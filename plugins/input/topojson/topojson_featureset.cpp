@@ -33,14 +33,6 @@
 #include <vector>
 #include <fstream>
 
-// boost
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-#pragma GCC diagnostic ignored "-Wunused-variable"
-#pragma GCC diagnostic ignored "-Wunused-local-typedef"
-#include <boost/range/adaptor/reversed.hpp>
-#pragma GCC diagnostic pop
-
 #include "topojson_featureset.hpp"
 
 namespace mapnik { namespace topojson {
@@ -81,11 +73,13 @@ void assign_properties(mapnik::feature_impl & feature, T const& geom, mapnik::tr
 template <typename Context>
 struct feature_generator
 {
-    feature_generator(Context & ctx,  mapnik::transcoder const& tr, topology const& topo, std::size_t feature_id)
+    feature_generator(Context & ctx,  mapnik::transcoder const& tr, topology const& topo,
+                      topojson_arcs const& arcs, box2d<double> const& box, std::size_t feature_id)
         : ctx_(ctx),
           tr_(tr),
           topo_(topo),
-          num_arcs_(topo.arcs.size()),
+          arcs_(arcs),
+          box_(box),
           feature_id_(feature_id) {}
 
     feature_ptr operator() (point const& pt) const
@@ -128,31 +122,12 @@ struct feature_generator
     feature_ptr operator() (linestring const& line) const
     {
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        if (num_arcs_ > 0)
+        if (arcs_.valid(line.ring))
         {
-            index_type index = line.ring;
-            index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-            if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-            {
-                auto const& arcs = topo_.arcs[arc_index];
-                double px = 0, py = 0;
-                mapnik::geometry::line_string<double> line_string;
-                line_string.reserve(arcs.coordinates.size());
-
-                for (auto pt : arcs.coordinates)
-                {
-                    double x = pt.x;
-                    double y = pt.y;
-                    if (topo_.tr)
-                    {
-                        x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                        y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                    }
-                    line_string.add_coord(x,y);
-                }
-                feature->set_geometry(std::move(line_string));
-                assign_properties(*feature, line, tr_);
-            }
+            mapnik::geometry::line_string<double> line_string;
+            append_arc(line_string, topojson_arcs::arc_index(line.ring), false);
+            feature->set_geometry(std::move(line_string));
+            assign_properties(*feature, line, tr_);
         }
         return feature;
     }
@@ -160,222 +135,143 @@ struct feature_generator
     feature_ptr operator() (multi_linestring const& multi_line) const
     {
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        if (num_arcs_ > 0)
+        mapnik::geometry::multi_line_string<double> multi_line_string;
+        bool hit = false;
+        multi_line_string.reserve(multi_line.rings.size());
+        for (auto const& index : multi_line.rings)
         {
-            mapnik::geometry::multi_line_string<double> multi_line_string;
-            bool hit = false;
-            multi_line_string.reserve(multi_line.rings.size());
-            for (auto const& index : multi_line.rings)
-            {
-                index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                {
-                    hit = true;
-                    double px = 0, py = 0;
-                    mapnik::geometry::line_string<double> line_string;
-                    auto const& arcs = topo_.arcs[arc_index];
-                    line_string.reserve(arcs.coordinates.size());
-                    for (auto pt : arcs.coordinates)
-                    {
-                        double x = pt.x;
-                        double y = pt.y;
-                        if (topo_.tr)
-                        {
-                            x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                            y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                        }
-                        line_string.add_coord(x, y);
-                    }
-                    multi_line_string.push_back(std::move(line_string));
-                }
-            }
-            if (hit)
+            if (arcs_.valid(index))
             {
-                feature->set_geometry(std::move(multi_line_string));
-                assign_properties(*feature, multi_line, tr_);
+                // the parts are independent, those outside of the query can't be seen
+                std::size_t arc = topojson_arcs::arc_index(index);
+                if (!box_.intersects(arcs_.box(arc))) continue;
+                mapnik::geometry::line_string<double> line_string;
+                append_arc(line_string, arc, false);
+                multi_line_string.push_back(std::move(line_string));
+                hit = true;
             }
         }
+        if (hit)
+        {
+            feature->set_geometry(std::move(multi_line_string));
+            assign_properties(*feature, multi_line, tr_);
+        }
         return feature;
     }
 
     feature_ptr operator() (polygon const& poly) const
     {
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        if (num_arcs_ > 0)
+        mapnik::geometry::polygon<double> polygon;
+        bool hit = append_polygon(polygon, poly.rings);
+        if (hit)
+        {
+            mapnik::geometry::correct(polygon);
+            feature->set_geometry(std::move(polygon));
+            assign_properties(*feature, poly, tr_);
+        }
+        return feature;
+    }
+
+    feature_ptr operator() (multi_polygon const& multi_poly) const
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
+        mapnik::geometry::multi_polygon<double> multi_polygon;
+        multi_polygon.reserve(multi_poly.polygons.size());
+        bool hit = false;
+        for (auto const& poly : multi_poly.polygons)
         {
-            std::vector<mapnik::topojson::coordinate> processed_coords;
             mapnik::geometry::polygon<double> polygon;
-            if (poly.rings.size() > 1) polygon.interior_rings.reserve(poly.rings.size() - 1);
-            bool first = true;
-            bool hit = false;
-            for (auto const& ring : poly.rings)
-            {
-                mapnik::geometry::linear_ring<double> linear_ring;
-                for (auto const& index : ring)
-                {
-                    double px = 0, py = 0;
-                    bool reverse = index < 0;
-                    index_type arc_index = reverse ? std::abs(index) - 1 : index;
-                    if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                    {
-                        hit = true;
-                        auto const& arcs = topo_.arcs[arc_index];
-                        auto const& coords = arcs.coordinates;
-                        processed_coords.clear();
-                        processed_coords.reserve(coords.size());
-                        for (auto const& pt : coords )
-                        {
-                            double x = pt.x;
-                            double y = pt.y;
+            if (append_polygon(polygon, poly)) hit = true;
+            multi_polygon.push_back(std::move(polygon));
+        }
+        if (hit)
+        {
+            mapnik::geometry::correct(multi_polygon);
+            feature->set_geometry(std::move(multi_polygon));
+            assign_properties(*feature, multi_poly, tr_);
+        }
+        return feature;
+    }
 
-                            if (topo_.tr)
-                            {
-                                transform const& tr = *topo_.tr;
-                                x =  (px += x) * tr.scale_x + tr.translate_x;
-                                y =  (py += y) * tr.scale_y + tr.translate_y;
-                            }
-                            processed_coords.emplace_back(coordinate{x,y});
-                        }
+    template<typename T>
+    feature_ptr operator() (T const& ) const
+    {
+        return feature_ptr();
+    }
 
-                        if (reverse)
-                        {
-                            for (auto const& c : processed_coords | boost::adaptors::reversed)
-                            {
-                                linear_ring.emplace_back(c.x, c.y);
-                            }
-                        }
-                        else
-                        {
-                            for (auto const& c : processed_coords)
-                            {
-                                linear_ring.emplace_back(c.x, c.y);
-                            }
-                        }
-                    }
-                }
-                if (first)
-                {
-                    first = false;
-                    polygon.set_exterior_ring(std::move(linear_ring));
-                }
-                else
-                {
-                    polygon.add_hole(std::move(linear_ring));
-                }
+private:
+    template <typename Line>
+    void append_arc(Line & line, std::size_t arc, bool reverse) const
+    {
+        line.reserve(line.size() + arcs_.num_coords(arc));
+        if (reverse)
+        {
+            for (auto itr = arcs_.end(arc); itr != arcs_.begin(arc); )
+            {
+                --itr;
+                line.add_coord(itr->x, itr->y);
             }
-            if (hit)
+        }
+        else
+        {
+            for (auto itr = arcs_.begin(arc); itr != arcs_.end(arc); ++itr)
             {
-                mapnik::geometry::correct(polygon);
-                feature->set_geometry(std::move(polygon));
-                assign_properties(*feature, poly, tr_);
+                line.add_coord(itr->x, itr->y);
             }
         }
-        return feature;
     }
 
-    feature_ptr operator() (multi_polygon const& multi_poly) const
+    // rings are whole, their arcs are never clipped
+    bool append_polygon(mapnik::geometry::polygon<double> & polygon,
+                        std::vector<std::vector<index_type> > const& rings) const
     {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        if (num_arcs_ > 0)
+        if (rings.size() > 1) polygon.interior_rings.reserve(rings.size() - 1);
+        bool first = true;
+        bool hit = false;
+        for (auto const& ring : rings)
         {
-            std::vector<mapnik::topojson::coordinate> processed_coords;
-            mapnik::geometry::multi_polygon<double> multi_polygon;
-            multi_polygon.reserve(multi_poly.polygons.size());
-            bool hit = false;
-            for (auto const& poly : multi_poly.polygons)
+            mapnik::geometry::linear_ring<double> linear_ring;
+            for (auto const& index : ring)
             {
-                bool first = true;
-                mapnik::geometry::polygon<double> polygon;
-                if (poly.size() > 1) polygon.interior_rings.reserve(poly.size() - 1);
-
-                for (auto const& ring : poly)
+                if (arcs_.valid(index))
                 {
-                    mapnik::geometry::linear_ring<double> linear_ring;
-                    for (auto const& index : ring)
-                    {
-                        double px = 0, py = 0;
-                        bool reverse = index < 0;
-                        index_type arc_index = reverse ? std::abs(index) - 1 : index;
-                        if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                        {
-                            hit = true;
-                            auto const& arcs = topo_.arcs[arc_index];
-                            auto const& coords = arcs.coordinates;
-                            processed_coords.clear();
-                            processed_coords.reserve(coords.size());
-                            for (auto const& pt : coords )
-                            {
-                                double x = pt.x;
-                                double y = pt.y;
-
-                                if (topo_.tr)
-                                {
-                                    x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                                    y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                                }
-                                processed_coords.emplace_back(coordinate{x,y});
-                            }
-
-                            using namespace boost::adaptors;
-
-                            if (reverse)
-                            {
-                                for (auto const& c : (processed_coords | reversed))
-                                {
-                                    linear_ring.add_coord(c.x, c.y);
-                                }
-                            }
-                            else
-                            {
-                                for (auto const& c : processed_coords)
-                                {
-                                    linear_ring.add_coord(c.x, c.y);
-                                }
-                            }
-                        }
-                    }
-                    if (first)
-                    {
-                        first = false;
-                        polygon.set_exterior_ring(std::move(linear_ring));
-                    }
-                    else
-                    {
-                        polygon.add_hole(std::move(linear_ring));
-                    }
+                    hit = true;
+                    append_arc(linear_ring, topojson_arcs::arc_index(index), index < 0);
                 }
-                multi_polygon.push_back(std::move(polygon));
             }
-            if (hit)
+            if (first)
+            {
+                first = false;
+                polygon.set_exterior_ring(std::move(linear_ring));
+            }
+            else
             {
-                mapnik::geometry::correct(multi_polygon);
-                feature->set_geometry(std::move(multi_polygon));
-                assign_properties(*feature, multi_poly, tr_);
+                polygon.add_hole(std::move(linear_ring));
             }
         }
-        return feature;
-    }
-
-    template<typename T>
-    feature_ptr operator() (T const& ) const
-    {
-        return feature_ptr();
+        return hit;
     }
 
     Context & ctx_;
     mapnik::transcoder const& tr_;
     topology const& topo_;
-    std::size_t num_arcs_;
+    topojson_arcs const& arcs_;
+    box2d<double> const& box_;
     std::size_t feature_id_;
 };
 
 }}
 
 topojson_featureset::topojson_featureset(mapnik::topojson::topology const& topo,
+                                         topojson_arcs const& arcs,
                                          mapnik::transcoder const& tr,
+                                         mapnik::box2d<double> const& box,
                                          array_type && index_array)
     : ctx_(std::make_shared<mapnik::context_type>()),
+      box_(box),
       topo_(topo),
+      arcs_(arcs),
       tr_(tr),
       index_array_(std::move(index_array)),
       index_itr_(index_array_.begin()),
@@ -386,7 +282,7 @@ topojson_featureset::~topojson_featureset() {}
 
 mapnik::feature_ptr topojson_featureset::next()
 {
-    if (index_itr_ != index_end_)
+    while (index_itr_ != index_end_)
     {
         topojson_datasource::item_type const& item = *index_itr_++;
         std::size_t index = item.second;
@@ -394,9 +290,13 @@ mapnik::feature_ptr topojson_featureset::next()
         {
             mapnik::topojson::geometry const& geom = topo_.geometries[index];
             mapnik::feature_ptr feature = mapnik::util::apply_visitor(
-                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx_, tr_, topo_, feature_id_++),
+                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx_, tr_, topo_, arcs_, box_, feature_id_++),
                 geom);
-            return feature;
+            // geometries without arcs or parts in the query box give nothing to draw
+            if (feature && !feature->get_geometry().is<mapnik::geometry::geometry_empty>())
+            {
+                return feature;
+            }
         }
     }
 
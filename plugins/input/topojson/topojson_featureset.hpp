@@ -25,6 +25,7 @@
 
 #include <mapnik/feature.hpp>
 #include "topojson_datasource.hpp"
+#include "topojson_arcs.hpp"
 
 #include <vector>
 #include <deque>
@@ -34,7 +35,9 @@ class topojson_featureset : public mapnik::Featureset
 public:
     typedef std::deque<topojson_datasource::item_type> array_type;
     topojson_featureset(mapnik::topojson::topology const& topo,
+                        topojson_arcs const& arcs,
                         mapnik::transcoder const& tr,
+                        mapnik::box2d<double> const& box,
                         array_type && index_array);
 
     virtual ~topojson_featureset();
@@ -44,6 +47,7 @@ private:
     mapnik::context_ptr ctx_;
     mapnik::box2d<double> box_;
     mapnik::topojson::topology const& topo_;
+    topojson_arcs const& arcs_;
     mapnik::transcoder const& tr_;
     const array_type index_array_;
     array_type::const_iterator index_itr_;
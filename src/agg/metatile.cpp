@@ -0,0 +1,92 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/metatile.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/image_view.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/color.hpp>
+
+// stl
+#include <stdexcept>
+
+namespace mapnik {
+
+metatile_tiles slice_metatile(image_rgba8 const& image,
+                              unsigned tiles_per_side,
+                              unsigned tile_size,
+                              std::string const& format)
+{
+    if (tiles_per_side == 0 || tile_size == 0)
+    {
+        throw std::runtime_error("metatile: tiles_per_side and tile_size must be greater than 0");
+    }
+    std::size_t size = static_cast<std::size_t>(tiles_per_side) * tile_size;
+    if (image.width() < size || image.height() < size)
+    {
+        throw std::runtime_error("metatile: image is smaller than tiles_per_side * tile_size");
+    }
+
+    metatile_tiles tiles;
+    tiles.reserve(tiles_per_side * tiles_per_side);
+    for (unsigned y = 0; y < tiles_per_side; ++y)
+    {
+        for (unsigned x = 0; x < tiles_per_side; ++x)
+        {
+            image_view_rgba8 view(x * tile_size, y * tile_size, tile_size, tile_size, image);
+            metatile_tile tile;
+            tile.x = x;
+            tile.y = y;
+            tile.solid = is_solid(view);
+            tile.empty = tile.solid && get_pixel<color>(image, x * tile_size, y * tile_size).alpha() == 0;
+            tile.data = save_to_string(view, format);
+            tiles.push_back(std::move(tile));
+        }
+    }
+    return tiles;
+}
+
+metatile_tiles render_metatile(Map const& map,
+                               box2d<double> const& extent,
+                               unsigned tiles_per_side,
+                               unsigned tile_size,
+                               std::string const& format,
+                               double scale_factor,
+                               attributes const& vars)
+{
+    if (tiles_per_side == 0 || tile_size == 0)
+    {
+        throw std::runtime_error("metatile: tiles_per_side and tile_size must be greater than 0");
+    }
+    unsigned size = tiles_per_side * tile_size;
+    request req(size, size, extent);
+    req.set_buffer_size(map.buffer_size());
+    image_rgba8 image(size, size);
+    agg_renderer<image_rgba8> ren(map, req, vars, image, scale_factor);
+    ren.apply(req);
+    return slice_metatile(image, tiles_per_side, tile_size, format);
+}
+
+}
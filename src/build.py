@@ -151,6 +151,7 @@ source = Split(
     expression_grammar.cpp
     fs.cpp
     request.cpp
+    render_stats.cpp
     well_known_srs.cpp
     params.cpp
     image_filter_types.cpp
@@ -167,10 +168,14 @@ source = Split(
     geometry_reprojection.cpp
     expression_node.cpp
     expression_string.cpp
+    expression_sql.cpp
     expression.cpp
+    expression_program.cpp
     transform_expression.cpp
     feature_kv_iterator.cpp
     feature_style_processor.cpp
+    featureset_prefetch.cpp
+    feature_arena.cpp
     feature_type_style.cpp
     dasharray_parser.cpp
     font_engine_freetype.cpp
@@ -190,6 +195,7 @@ source = Split(
     image_util_png.cpp
     image_util_tiff.cpp
     image_util_webp.cpp
+    label_collision_detector.cpp
     layer.cpp
     map.cpp
     load_map.cpp
@@ -199,18 +205,22 @@ source = Split(
     geometry_envelope.cpp
     plugin.cpp
     rule.cpp
+    rule_cache.cpp
     save_map.cpp
     wkb.cpp
+    twkb.cpp
     projection.cpp
     proj_transform.cpp
     scale_denominator.cpp
     simplify.cpp
     parse_transform.cpp
     memory_datasource.cpp
+    cache_datasource.cpp
     symbolizer.cpp
     symbolizer_keys.cpp
     symbolizer_enumerations.cpp
     unicode.cpp
+    string_pool.cpp
     raster_colorizer.cpp
     mapped_memory_cache.cpp
     marker_cache.cpp
@@ -338,6 +348,7 @@ source += Split(
     agg/process_markers_symbolizer.cpp
     agg/process_group_symbolizer.cpp
     agg/process_debug_symbolizer.cpp
+    agg/metatile.cpp
     """
     )
 
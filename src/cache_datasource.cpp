@@ -0,0 +1,336 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/cache_datasource.hpp>
+#include <mapnik/memory_featureset.hpp>
+#include <mapnik/expression_string.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_kv_iterator.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry_envelope.hpp>
+#include <mapnik/packed_rtree.hpp>
+#include <mapnik/query.hpp>
+
+// stl
+#include <algorithm>
+#include <deque>
+
+namespace mapnik {
+
+namespace {
+
+// approximate memory held by the coordinates of a geometry
+struct geometry_bytes
+{
+    using point_type = geometry::point<double>;
+
+    std::size_t operator() (geometry::geometry_empty const&) const
+    {
+        return 0;
+    }
+
+    std::size_t operator() (point_type const&) const
+    {
+        return sizeof(point_type);
+    }
+
+    std::size_t operator() (geometry::line_string<double> const& line) const
+    {
+        return line.size() * sizeof(point_type);
+    }
+
+    std::size_t operator() (geometry::polygon<double> const& poly) const
+    {
+        std::size_t bytes = poly.exterior_ring.size() * sizeof(point_type);
+        for (auto const& ring : poly.interior_rings)
+        {
+            bytes += ring.size() * sizeof(point_type);
+        }
+        return bytes;
+    }
+
+    std::size_t operator() (geometry::multi_point<double> const& multi_point) const
+    {
+        return multi_point.size() * sizeof(point_type);
+    }
+
+    std::size_t operator() (geometry::multi_line_string<double> const& multi_line) const
+    {
+        std::size_t bytes = 0;
+        for (auto const& line : multi_line) bytes += (*this)(line);
+        return bytes;
+    }
+
+    std::size_t operator() (geometry::multi_polygon<double> const& multi_poly) const
+    {
+        std::size_t bytes = 0;
+        for (auto const& poly : multi_poly) bytes += (*this)(poly);
+        return bytes;
+    }
+
+    std::size_t operator() (geometry::geometry_collection<double> const& collection) const
+    {
+        std::size_t bytes = 0;
+        for (auto const& geom : collection) bytes += util::apply_visitor(*this, geom);
+        return bytes;
+    }
+};
+
+// heap memory held by an attribute value, strings too long for the
+// buffer inside the value keep their characters elsewhere
+std::size_t value_bytes(value const& val)
+{
+    if (!val.is<value_unicode_string>()) return 0;
+    value_unicode_string const& str = val.get<value_unicode_string>();
+    char const* buffer = reinterpret_cast<char const*>(str.getBuffer());
+    char const* self = reinterpret_cast<char const*>(&str);
+    if (buffer == nullptr || (buffer >= self && buffer < self + sizeof(str))) return 0;
+    return static_cast<std::size_t>(str.getCapacity()) * sizeof(UChar);
+}
+
+std::size_t feature_bytes(feature_impl const& feature)
+{
+    // the feature, its attributes and geometry, plus its slot in the cache
+    std::size_t bytes = sizeof(feature_impl) +
+        feature.size() * sizeof(value) +
+        util::apply_visitor(geometry_bytes(), feature.get_geometry()) +
+        sizeof(feature_ptr) + sizeof(box2d<double>) + sizeof(std::size_t);
+    for (auto const& kv : feature)
+    {
+        bytes += value_bytes(std::get<1>(kv));
+    }
+    return bytes;
+}
+
+// A feature allocated from a featureset's arena keeps the arena's blocks
+// alive, which would be held by the cache long after the featureset is
+// gone. Such features are copied to the heap, others are shared.
+feature_ptr detach(feature_ptr const& feature)
+{
+    if (!feature->in_arena()) return feature;
+    feature_ptr copy(feature_factory::create(feature->context(), feature->id()));
+    feature->copy_data_to(*copy);
+    copy->set_geometry_copy(feature->get_geometry());
+    copy->set_raster(feature->get_raster());
+    return copy;
+}
+
+}
+
+struct cache_datasource::entry
+{
+    using index_type = packed_rtree<std::size_t>;
+
+    entry(key_type && key_, box2d<double> const& bbox_, std::vector<feature_ptr> && features_)
+        : key(std::move(key_)),
+          bbox(bbox_),
+          features(std::move(features_)),
+          index(),
+          unindexed(),
+          size(sizeof(entry))
+    {
+        std::vector<index_type::item_type> items;
+        items.reserve(features.size());
+        for (std::size_t i = 0; i < features.size(); ++i)
+        {
+            box2d<double> box = geometry::envelope(features[i]->get_geometry());
+            // features without a geometry have no place in the index, they
+            // were returned for the whole bbox and so are for any part of it
+            if (box.valid()) items.emplace_back(box, i);
+            else unindexed.push_back(i);
+            size += feature_bytes(*features[i]);
+        }
+        size += unindexed.size() * sizeof(std::size_t);
+        index = index_type(std::move(items));
+    }
+
+    featureset_ptr select(box2d<double> const& box) const
+    {
+        if (box == bbox)
+        {
+            return std::make_shared<memory_featureset>(std::deque<feature_ptr>(features.begin(), features.end()));
+        }
+        std::vector<std::size_t> matches(unindexed);
+        index.query(box, [&matches](std::size_t i) { matches.push_back(i); return true; });
+        // in the order the wrapped datasource returned them
+        std::sort(matches.begin(), matches.end());
+        std::deque<feature_ptr> selected;
+        for (std::size_t i : matches)
+        {
+            selected.push_back(features[i]);
+        }
+        return std::make_shared<memory_featureset>(std::move(selected));
+    }
+
+    key_type key;
+    box2d<double> bbox;
+    std::vector<feature_ptr> features;
+    index_type index;
+    std::vector<std::size_t> unindexed;
+    std::size_t size;
+};
+
+bool cache_datasource::key_type::operator==(key_type const& rhs) const
+{
+    return scale_denominator == rhs.scale_denominator &&
+        resolution == rhs.resolution &&
+        names == rhs.names &&
+        filters == rhs.filters &&
+        vars == rhs.vars;
+}
+
+const char * cache_datasource::name()
+{
+    return "cache";
+}
+
+cache_datasource::cache_datasource(datasource_ptr const& ds, std::size_t max_size)
+    : datasource(ds->params()),
+      ds_(ds),
+      max_size_(max_size),
+      entries_(),
+      size_(0) {}
+
+cache_datasource::~cache_datasource() {}
+
+cache_datasource::key_type cache_datasource::make_key(query const& q)
+{
+    key_type key;
+    // datasources may simplify or pick features by scale, results are only
+    // shared at the very same one
+    key.scale_denominator = q.scale_denominator();
+    key.resolution = q.resolution();
+    key.names = q.property_names();
+    key.vars = q.variables();
+    for (expression_ptr const& filter : q.filters())
+    {
+        key.filters.push_back(filter ? to_expression_string(*filter) : std::string());
+    }
+    return key;
+}
+
+datasource::datasource_t cache_datasource::type() const
+{
+    return ds_->type();
+}
+
+featureset_ptr cache_datasource::features(query const& q) const
+{
+    if (ds_->type() != datasource::Vector)
+    {
+        return ds_->features(q);
+    }
+
+    key_type key = make_key(q);
+    box2d<double> const& box = q.get_bbox();
+    entry_ptr hit;
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        for (auto itr = entries_.begin(); itr != entries_.end(); ++itr)
+        {
+            if ((*itr)->bbox.contains(box) && (*itr)->key == key)
+            {
+                entries_.splice(entries_.begin(), entries_, itr);
+                hit = entries_.front();
+                break;
+            }
+        }
+    }
+    if (hit)
+    {
+        return hit->select(box);
+    }
+
+    // the wrapped datasource is queried without holding the lock
+    std::vector<feature_ptr> features;
+    featureset_ptr fs = ds_->features(q);
+    if (fs)
+    {
+        feature_ptr feature;
+        while ((feature = fs->next()))
+        {
+            features.push_back(detach(feature));
+        }
+    }
+    entry_ptr result = std::make_shared<entry>(std::move(key), box, std::move(features));
+    if (result->size <= max_size_)
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        entries_.push_front(result);
+        size_ += result->size;
+        while (size_ > max_size_)
+        {
+            size_ -= entries_.back()->size;
+            entries_.pop_back();
+        }
+    }
+    return result->select(box);
+}
+
+featureset_ptr cache_datasource::features_at_point(coord2d const& pt, double tol) const
+{
+    return ds_->features_at_point(pt, tol);
+}
+
+box2d<double> cache_datasource::envelope() const
+{
+    return ds_->envelope();
+}
+
+boost::optional<datasource_geometry_t> cache_datasource::get_geometry_type() const
+{
+    return ds_->get_geometry_type();
+}
+
+layer_descriptor cache_datasource::get_descriptor() const
+{
+    return ds_->get_descriptor();
+}
+
+datasource_ptr const& cache_datasource::wrapped() const
+{
+    return ds_;
+}
+
+std::size_t cache_datasource::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return size_;
+}
+
+void cache_datasource::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    size_ = 0;
+}
+
+}
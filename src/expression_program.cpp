@@ -0,0 +1,582 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/expression_program.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/feature.hpp>
+
+// stl
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+namespace mapnik {
+
+namespace detail {
+
+// evaluation stack depth, shared by the copies apply_visitor makes of the compiler
+struct stack_depth
+{
+    std::size_t current = 0;
+    std::size_t max = 0;
+};
+
+struct expression_compiler
+{
+    expression_compiler(expression_program & prog, stack_depth & depth)
+        : prog_(prog),
+          depth_(depth) {}
+
+    void operator() (value_null) { push_const(value_null()); }
+    void operator() (value_bool val) { push_const(val); }
+    void operator() (value_integer val) { push_const(val); }
+    void operator() (value_double val) { push_const(val); }
+    void operator() (value_unicode_string const& val) { push_const(val); }
+
+    void operator() (attribute const& attr)
+    {
+        emit(expr_opcode::push_attr, 1, intern(prog_.attributes_, attr.name()));
+    }
+
+    void operator() (global_attribute const& attr)
+    {
+        emit(expr_opcode::push_global, 1, intern(prog_.globals_, attr.name));
+    }
+
+    void operator() (geometry_type_attribute const&)
+    {
+        emit(expr_opcode::push_geometry_type, 1);
+    }
+
+    void operator() (unary_node<tags::negate> const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(expr_opcode::negate, 0);
+    }
+
+    void operator() (unary_node<tags::logical_not> const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(expr_opcode::logical_not, 0);
+    }
+
+    void operator() (binary_node<tags::plus> const& x) { arithmetic(x.left, x.right, expr_opcode::plus); }
+    void operator() (binary_node<tags::minus> const& x) { arithmetic(x.left, x.right, expr_opcode::minus); }
+    void operator() (binary_node<tags::mult> const& x) { arithmetic(x.left, x.right, expr_opcode::mult); }
+    void operator() (binary_node<tags::div> const& x) { arithmetic(x.left, x.right, expr_opcode::div); }
+    void operator() (binary_node<tags::mod> const& x) { arithmetic(x.left, x.right, expr_opcode::mod); }
+
+    void operator() (binary_node<tags::less> const& x) { compare(x.left, x.right, expr_comparison::less); }
+    void operator() (binary_node<tags::less_equal> const& x) { compare(x.left, x.right, expr_comparison::less_equal); }
+    void operator() (binary_node<tags::greater> const& x) { compare(x.left, x.right, expr_comparison::greater); }
+    void operator() (binary_node<tags::greater_equal> const& x) { compare(x.left, x.right, expr_comparison::greater_equal); }
+    void operator() (binary_node<tags::equal_to> const& x) { compare(x.left, x.right, expr_comparison::equal_to); }
+    void operator() (binary_node<tags::not_equal_to> const& x) { compare(x.left, x.right, expr_comparison::not_equal_to); }
+
+    void operator() (binary_node<tags::logical_and> const& x)
+    {
+        logical(x.left, x.right, expr_opcode::jump_if_false);
+    }
+
+    void operator() (binary_node<tags::logical_or> const& x)
+    {
+        logical(x.left, x.right, expr_opcode::jump_if_true);
+    }
+
+    void operator() (regex_match_node const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(expr_opcode::regex_match, 0, index(prog_.regex_match_nodes_, &x));
+    }
+
+    void operator() (regex_replace_node const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(expr_opcode::regex_replace, 0, index(prog_.regex_replace_nodes_, &x));
+    }
+
+    void operator() (unary_function_call const& call)
+    {
+        util::apply_visitor(*this, call.arg);
+        emit(expr_opcode::unary_call, 0, index(prog_.unary_calls_, &call));
+    }
+
+    void operator() (binary_function_call const& call)
+    {
+        util::apply_visitor(*this, call.arg1);
+        util::apply_visitor(*this, call.arg2);
+        emit(expr_opcode::binary_call, -1, index(prog_.binary_calls_, &call));
+    }
+
+    void compile(expr_node const& root)
+    {
+        util::apply_visitor(*this, root);
+        if (depth_.max > expression_program::max_stack_size)
+        {
+            // too deep for the evaluation stack, let the tree evaluator do it
+            prog_.code_.clear();
+            prog_.constants_.clear();
+            prog_.attributes_.clear();
+            prog_.globals_.clear();
+            prog_.regex_match_nodes_.clear();
+            prog_.regex_replace_nodes_.clear();
+            prog_.unary_calls_.clear();
+            prog_.binary_calls_.clear();
+            emit(expr_opcode::evaluate_tree, 1, index(prog_.tree_nodes_, &root));
+        }
+    }
+
+private:
+    static bool is_literal(expr_node const& node)
+    {
+        return node.is<value_null>() || node.is<value_bool>() || node.is<value_integer>()
+            || node.is<value_double>() || node.is<value_unicode_string>();
+    }
+
+    static value literal(expr_node const& node)
+    {
+        if (node.is<value_bool>()) return node.get<value_bool>();
+        if (node.is<value_integer>()) return node.get<value_integer>();
+        if (node.is<value_double>()) return node.get<value_double>();
+        if (node.is<value_unicode_string>()) return node.get<value_unicode_string>();
+        return value_null();
+    }
+
+    void compare(expr_node const& left, expr_node const& right, expr_comparison cmp)
+    {
+        if (left.is<attribute>() && is_literal(right))
+        {
+            fused_compare(left.get<attribute>(), right, cmp, false);
+        }
+        else if (is_literal(left) && right.is<attribute>())
+        {
+            fused_compare(right.get<attribute>(), left, cmp, true);
+        }
+        else
+        {
+            util::apply_visitor(*this, left);
+            util::apply_visitor(*this, right);
+            std::size_t pos = emit(expr_opcode::compare, -1);
+            prog_.code_[pos].cmp = cmp;
+        }
+    }
+
+    void fused_compare(attribute const& attr, expr_node const& lit, expr_comparison cmp, bool reversed)
+    {
+        std::uint32_t b = static_cast<std::uint32_t>(prog_.constants_.size());
+        prog_.constants_.push_back(literal(lit));
+        std::size_t pos = emit(expr_opcode::compare_attr_const, 1, intern(prog_.attributes_, attr.name()), b);
+        prog_.code_[pos].cmp = cmp;
+        prog_.code_[pos].reversed = reversed;
+    }
+
+    void arithmetic(expr_node const& left, expr_node const& right, expr_opcode op)
+    {
+        util::apply_visitor(*this, left);
+        util::apply_visitor(*this, right);
+        emit(op, -1);
+    }
+
+    void logical(expr_node const& left, expr_node const& right, expr_opcode jump)
+    {
+        util::apply_visitor(*this, left);
+        // the jump pops the left operand, pushing the result only when taken
+        std::size_t pos = emit(jump, -1);
+        util::apply_visitor(*this, right);
+        emit(expr_opcode::to_bool, 0);
+        prog_.code_[pos].a = static_cast<std::uint32_t>(prog_.code_.size());
+    }
+
+    void push_const(value && val)
+    {
+        std::uint32_t a = static_cast<std::uint32_t>(prog_.constants_.size());
+        prog_.constants_.push_back(std::move(val));
+        emit(expr_opcode::push_const, 1, a);
+    }
+
+    std::size_t emit(expr_opcode op, int delta, std::uint32_t a = 0, std::uint32_t b = 0)
+    {
+        prog_.code_.push_back(expr_instruction{op, expr_comparison::equal_to, false, a, b});
+        depth_.current += delta;
+        depth_.max = std::max(depth_.max, depth_.current);
+        return prog_.code_.size() - 1;
+    }
+
+    template <typename T>
+    static std::uint32_t index(std::vector<T> & items, T item)
+    {
+        items.push_back(item);
+        return static_cast<std::uint32_t>(items.size() - 1);
+    }
+
+    static std::uint32_t intern(std::vector<std::string> & names, std::string const& name)
+    {
+        auto itr = std::find(names.begin(), names.end(), name);
+        if (itr != names.end())
+        {
+            return static_cast<std::uint32_t>(itr - names.begin());
+        }
+        names.push_back(name);
+        return static_cast<std::uint32_t>(names.size() - 1);
+    }
+
+    expression_program & prog_;
+    stack_depth & depth_;
+};
+
+namespace {
+
+// Fixed capacity stack of values living on the C++ stack. Slots are only
+// constructed when pushed so an evaluation costs no more than it touches.
+class value_stack
+{
+public:
+    value_stack()
+        : size_(0) {}
+
+    ~value_stack()
+    {
+        while (size_ > 0) pop();
+    }
+
+    void push(value const& val)
+    {
+        new (&data_[size_]) value(val);
+        ++size_;
+    }
+
+    void push(value && val)
+    {
+        new (&data_[size_]) value(std::move(val));
+        ++size_;
+    }
+
+    void pop()
+    {
+        top().~value();
+        --size_;
+    }
+
+    value & top()
+    {
+        return *reinterpret_cast<value*>(&data_[size_ - 1]);
+    }
+
+    value & second()
+    {
+        return *reinterpret_cast<value*>(&data_[size_ - 2]);
+    }
+
+    void replace_top(value val)
+    {
+        pop();
+        push(std::move(val));
+    }
+
+    void replace_two(value val)
+    {
+        pop();
+        pop();
+        push(std::move(val));
+    }
+
+private:
+    typename std::aligned_storage<sizeof(value), alignof(value)>::type data_[expression_program::max_stack_size];
+    std::size_t size_;
+};
+
+template <typename T>
+inline bool compare_same(expr_comparison cmp, T const& lhs, T const& rhs)
+{
+    switch (cmp)
+    {
+    case expr_comparison::less: return lhs < rhs;
+    case expr_comparison::less_equal: return lhs <= rhs;
+    case expr_comparison::greater: return lhs > rhs;
+    case expr_comparison::greater_equal: return lhs >= rhs;
+    case expr_comparison::equal_to: return lhs == rhs;
+    case expr_comparison::not_equal_to: return lhs != rhs;
+    }
+    return false;
+}
+
+// Same results as the value comparison operators, with the common
+// numeric and string cases handled without visiting both variants.
+inline bool compare_values(expr_comparison cmp, value const& lhs, value const& rhs)
+{
+    if (lhs.is<value_integer>())
+    {
+        if (rhs.is<value_integer>())
+        {
+            return compare_same(cmp, lhs.get<value_integer>(), rhs.get<value_integer>());
+        }
+        if (rhs.is<value_double>())
+        {
+            return compare_same<value_double>(cmp, lhs.get<value_integer>(), rhs.get<value_double>());
+        }
+    }
+    else if (lhs.is<value_double>())
+    {
+        if (rhs.is<value_double>())
+        {
+            return compare_same(cmp, lhs.get<value_double>(), rhs.get<value_double>());
+        }
+        if (rhs.is<value_integer>())
+        {
+            return compare_same<value_double>(cmp, lhs.get<value_double>(), rhs.get<value_integer>());
+        }
+    }
+    else if (lhs.is<value_unicode_string>() && rhs.is<value_unicode_string>())
+    {
+        return compare_same(cmp, lhs.get<value_unicode_string>(), rhs.get<value_unicode_string>());
+    }
+    switch (cmp)
+    {
+    case expr_comparison::less: return lhs < rhs;
+    case expr_comparison::less_equal: return lhs <= rhs;
+    case expr_comparison::greater: return lhs > rhs;
+    case expr_comparison::greater_equal: return lhs >= rhs;
+    case expr_comparison::equal_to: return lhs == rhs;
+    case expr_comparison::not_equal_to: return lhs != rhs;
+    }
+    return false;
+}
+
+// attribute reads by name, one context lookup each
+struct attributes_by_name
+{
+    feature_impl const& feature;
+    std::vector<std::string> const& names;
+
+    value const& operator() (std::uint32_t index) const
+    {
+        return feature.get(names[index]);
+    }
+};
+
+// attribute reads through slots bound to the feature's context
+struct attributes_by_slot
+{
+    feature_impl const& feature;
+    std::vector<std::size_t> const& slots;
+
+    value const& operator() (std::uint32_t index) const
+    {
+        return feature.get(slots[index]);
+    }
+};
+
+} // anonymous namespace
+
+} // namespace detail
+
+expression_program::expression_program()
+    : expr_(),
+      code_() {}
+
+expression_program::expression_program(expression_ptr const& expr)
+    : expr_(expr),
+      code_()
+{
+    if (expr_)
+    {
+        detail::stack_depth depth;
+        detail::expression_compiler compiler(*this, depth);
+        compiler.compile(*expr_);
+    }
+}
+
+template <typename Stack, typename Attributes>
+void expression_program::run(Stack & stack, feature_impl const& feature, attributes const& vars, Attributes const& attrs) const
+{
+    using detail::expr_opcode;
+    std::size_t pc = 0;
+    std::size_t const end = code_.size();
+    while (pc < end)
+    {
+        detail::expr_instruction const& ins = code_[pc++];
+        switch (ins.op)
+        {
+        case expr_opcode::push_const:
+            stack.push(constants_[ins.a]);
+            break;
+        case expr_opcode::push_attr:
+            stack.push(attrs(ins.a));
+            break;
+        case expr_opcode::push_global:
+        {
+            auto itr = vars.find(globals_[ins.a]);
+            if (itr != vars.end()) stack.push(itr->second);
+            else stack.push(value());
+            break;
+        }
+        case expr_opcode::push_geometry_type:
+            stack.push(geometry_type_attribute().value<value, feature_impl>(feature));
+            break;
+        case expr_opcode::negate:
+            stack.replace_top(-stack.top());
+            break;
+        case expr_opcode::logical_not:
+            stack.replace_top(value_bool(!stack.top().to_bool()));
+            break;
+        case expr_opcode::to_bool:
+            stack.replace_top(value_bool(stack.top().to_bool()));
+            break;
+        case expr_opcode::plus:
+            stack.replace_two(stack.second() + stack.top());
+            break;
+        case expr_opcode::minus:
+            stack.replace_two(stack.second() - stack.top());
+            break;
+        case expr_opcode::mult:
+            stack.replace_two(stack.second() * stack.top());
+            break;
+        case expr_opcode::div:
+            stack.replace_two(stack.second() / stack.top());
+            break;
+        case expr_opcode::mod:
+            stack.replace_two(stack.second() % stack.top());
+            break;
+        case expr_opcode::compare:
+            stack.replace_two(value_bool(detail::compare_values(ins.cmp, stack.second(), stack.top())));
+            break;
+        case expr_opcode::compare_attr_const:
+        {
+            value const& attr = attrs(ins.a);
+            value const& lit = constants_[ins.b];
+            stack.push(value_bool(ins.reversed ? detail::compare_values(ins.cmp, lit, attr)
+                                               : detail::compare_values(ins.cmp, attr, lit)));
+            break;
+        }
+        case expr_opcode::jump_if_false:
+        {
+            bool result = stack.top().to_bool();
+            stack.pop();
+            if (!result)
+            {
+                stack.push(value_bool(false));
+                pc = ins.a;
+            }
+            break;
+        }
+        case expr_opcode::jump_if_true:
+        {
+            bool result = stack.top().to_bool();
+            stack.pop();
+            if (result)
+            {
+                stack.push(value_bool(true));
+                pc = ins.a;
+            }
+            break;
+        }
+        case expr_opcode::regex_match:
+            stack.replace_top(regex_match_nodes_[ins.a]->apply(stack.top()));
+            break;
+        case expr_opcode::regex_replace:
+            stack.replace_top(regex_replace_nodes_[ins.a]->apply(stack.top()));
+            break;
+        case expr_opcode::unary_call:
+            stack.replace_top(unary_calls_[ins.a]->fun(stack.top()));
+            break;
+        case expr_opcode::binary_call:
+            stack.replace_two(binary_calls_[ins.a]->fun(stack.second(), stack.top()));
+            break;
+        case expr_opcode::evaluate_tree:
+            stack.push(util::apply_visitor(mapnik::evaluate<feature_impl, value, attributes>(feature, vars),
+                                           *tree_nodes_[ins.a]));
+            break;
+        }
+    }
+}
+
+void expression_program::bind(binding & slots, feature_impl const& feature) const
+{
+    context_type const& ctx = feature.get_context();
+    if (slots.ctx.get() == &ctx && slots.ctx_size == ctx.size()) return;
+    slots.ctx = feature.context();
+    slots.ctx_size = ctx.size();
+    slots.slots.clear();
+    for (std::string const& name : attributes_)
+    {
+        auto itr = ctx.find(name);
+        // out of range slots read as the default feature value, like unknown names
+        slots.slots.push_back(itr != ctx.end() ? itr->second : std::numeric_limits<std::size_t>::max());
+    }
+}
+
+template <typename Attributes>
+bool expression_program::to_bool_impl(feature_impl const& feature, attributes const& vars, Attributes const& attrs) const
+{
+    if (code_.size() == 1)
+    {
+        detail::expr_instruction const& ins = code_.front();
+        if (ins.op == detail::expr_opcode::compare_attr_const)
+        {
+            value const& attr = attrs(ins.a);
+            value const& lit = constants_[ins.b];
+            return ins.reversed ? detail::compare_values(ins.cmp, lit, attr)
+                                : detail::compare_values(ins.cmp, attr, lit);
+        }
+        if (ins.op == detail::expr_opcode::push_const)
+        {
+            return constants_[ins.a].to_bool();
+        }
+    }
+    if (code_.empty()) return false;
+    detail::value_stack stack;
+    run(stack, feature, vars, attrs);
+    return stack.top().to_bool();
+}
+
+value expression_program::evaluate(feature_impl const& feature, attributes const& vars) const
+{
+    if (code_.empty()) return value();
+    detail::value_stack stack;
+    run(stack, feature, vars, detail::attributes_by_name{feature, attributes_});
+    return std::move(stack.top());
+}
+
+value expression_program::evaluate(feature_impl const& feature, attributes const& vars, binding & slots) const
+{
+    if (code_.empty()) return value();
+    bind(slots, feature);
+    detail::value_stack stack;
+    run(stack, feature, vars, detail::attributes_by_slot{feature, slots.slots});
+    return std::move(stack.top());
+}
+
+bool expression_program::to_bool(feature_impl const& feature, attributes const& vars) const
+{
+    return to_bool_impl(feature, vars, detail::attributes_by_name{feature, attributes_});
+}
+
+bool expression_program::to_bool(feature_impl const& feature, attributes const& vars, binding & slots) const
+{
+    bind(slots, feature);
+    return to_bool_impl(feature, vars, detail::attributes_by_slot{feature, slots.slots});
+}
+
+}
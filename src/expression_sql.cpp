@@ -0,0 +1,406 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/expression_sql.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/value.hpp>
+
+// stl
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace mapnik
+{
+
+namespace {
+
+enum class sql_op { equal, not_equal, less, less_equal, greater, greater_equal };
+
+sql_op complement(sql_op op)
+{
+    switch (op)
+    {
+    case sql_op::equal: return sql_op::not_equal;
+    case sql_op::not_equal: return sql_op::equal;
+    case sql_op::less: return sql_op::greater_equal;
+    case sql_op::less_equal: return sql_op::greater;
+    case sql_op::greater: return sql_op::less_equal;
+    case sql_op::greater_equal: return sql_op::less;
+    }
+    return op;
+}
+
+// operator with its operands swapped, literal < [a] becomes [a] > literal
+sql_op swapped(sql_op op)
+{
+    switch (op)
+    {
+    case sql_op::less: return sql_op::greater;
+    case sql_op::less_equal: return sql_op::greater_equal;
+    case sql_op::greater: return sql_op::less;
+    case sql_op::greater_equal: return sql_op::less_equal;
+    default: return op;
+    }
+}
+
+char const* op_string(sql_op op)
+{
+    switch (op)
+    {
+    case sql_op::equal: return " = ";
+    case sql_op::not_equal: return " <> ";
+    case sql_op::less: return " < ";
+    case sql_op::less_equal: return " <= ";
+    case sql_op::greater: return " > ";
+    case sql_op::greater_equal: return " >= ";
+    }
+    return " = ";
+}
+
+// arithmetic has no translation
+template <typename Tag>
+bool op_of(Tag, sql_op &) { return false; }
+bool op_of(tags::equal_to, sql_op & op) { op = sql_op::equal; return true; }
+bool op_of(tags::not_equal_to, sql_op & op) { op = sql_op::not_equal; return true; }
+bool op_of(tags::less, sql_op & op) { op = sql_op::less; return true; }
+bool op_of(tags::less_equal, sql_op & op) { op = sql_op::less_equal; return true; }
+bool op_of(tags::greater, sql_op & op) { op = sql_op::greater; return true; }
+bool op_of(tags::greater_equal, sql_op & op) { op = sql_op::greater_equal; return true; }
+
+// shortest form reading back as the same double, 0.1 rather than
+// 0.10000000000000001 which a database may compare as an exact numeric
+void write_double(std::ostream & out, double value)
+{
+    for (int precision = 15; precision < 17; ++precision)
+    {
+        std::ostringstream s;
+        s << std::setprecision(precision) << value;
+        std::istringstream in(s.str());
+        double result;
+        if (in >> result && result == value)
+        {
+            out << s.str();
+            return;
+        }
+    }
+    out << std::setprecision(17) << value;
+}
+
+std::string quote_identifier(std::string const& name)
+{
+    std::string quoted("\"");
+    for (char c : name)
+    {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+// literal operands, query variables are resolved to their value
+struct sql_literal
+{
+    sql_literal(attributes const& vars, value & val)
+        : vars_(vars),
+          val_(val) {}
+
+    bool operator() (value_null) const
+    {
+        val_ = value_null();
+        return true;
+    }
+
+    bool operator() (value_integer v) const
+    {
+        val_ = v;
+        return true;
+    }
+
+    bool operator() (value_double v) const
+    {
+        val_ = v;
+        return true;
+    }
+
+    bool operator() (value_unicode_string const& v) const
+    {
+        val_ = v;
+        return true;
+    }
+
+    bool operator() (global_attribute const& attr) const
+    {
+        auto itr = vars_.find(attr.name);
+        if (itr == vars_.end()) return false;
+        val_ = itr->second;
+        return !val_.is<value_bool>();
+    }
+
+    bool operator() (unary_node<tags::negate> const& x) const
+    {
+        if (!util::apply_visitor(*this, x.expr)) return false;
+        if (val_.is<value_integer>()) val_ = -val_.get<value_integer>();
+        else if (val_.is<value_double>()) val_ = -val_.get<value_double>();
+        else return false;
+        return true;
+    }
+
+    template <typename T>
+    bool operator() (T const&) const
+    {
+        return false;
+    }
+
+    attributes const& vars_;
+    value & val_;
+};
+
+// Writes a condition that holds wherever the expression is true, or false
+// when negated. Boolean logic is pushed down to the comparisons so that
+// SQL's unknown results for NULL columns never meet a NOT.
+struct sql_condition
+{
+    sql_condition(layer_descriptor const& desc, attributes const& vars,
+                  sql_dialect dialect, bool negated, std::string & sql)
+        : desc_(desc),
+          vars_(vars),
+          dialect_(dialect),
+          negated_(negated),
+          sql_(sql) {}
+
+    bool operator() (value_bool v) const
+    {
+        sql_ += (v != negated_) ? "1=1" : "1=0";
+        return true;
+    }
+
+    bool operator() (unary_node<tags::logical_not> const& x) const
+    {
+        return translate(x.expr, !negated_, sql_);
+    }
+
+    bool operator() (binary_node<tags::logical_and> const& x) const
+    {
+        // not (a and b) is (not a) or (not b)
+        return join(x.left, x.right, negated_ ? " OR " : " AND ", !negated_);
+    }
+
+    bool operator() (binary_node<tags::logical_or> const& x) const
+    {
+        return join(x.left, x.right, negated_ ? " AND " : " OR ", negated_);
+    }
+
+    template <typename Tag>
+    bool operator() (binary_node<Tag> const& x) const
+    {
+        sql_op op;
+        if (!op_of(Tag(), op)) return false;
+        return compare(x.left, x.right, op);
+    }
+
+    template <typename T>
+    bool operator() (T const&) const
+    {
+        return false;
+    }
+
+private:
+    bool translate(expr_node const& node, bool negated, std::string & sql) const
+    {
+        return util::apply_visitor(sql_condition(desc_, vars_, dialect_, negated, sql), node);
+    }
+
+    // a conjunction may drop the side it can't translate, the condition
+    // only gets weaker
+    bool join(expr_node const& left, expr_node const& right,
+              char const* op, bool conjunction) const
+    {
+        std::string lhs, rhs;
+        bool has_lhs = translate(left, negated_, lhs);
+        bool has_rhs = translate(right, negated_, rhs);
+        if (has_lhs && has_rhs)
+        {
+            sql_ += "(" + lhs + op + rhs + ")";
+            return true;
+        }
+        if (!conjunction) return false;
+        if (has_lhs) sql_ += lhs;
+        else if (has_rhs) sql_ += rhs;
+        return has_lhs || has_rhs;
+    }
+
+    attribute_descriptor const* column(expr_node const& node) const
+    {
+        if (!node.is<attribute>()) return nullptr;
+        std::string const& name = node.get<attribute>().name();
+        for (attribute_descriptor const& desc : desc_.get_descriptors())
+        {
+            if (desc.get_name() == name) return &desc;
+        }
+        return nullptr;
+    }
+
+    bool compare(expr_node const& left, expr_node const& right, sql_op op) const
+    {
+        value val;
+        bool column_first = true;
+        attribute_descriptor const* desc = column(left);
+        if (desc)
+        {
+            if (!util::apply_visitor(sql_literal(vars_, val), right)) return false;
+        }
+        else if ((desc = column(right)))
+        {
+            if (!util::apply_visitor(sql_literal(vars_, val), left)) return false;
+            op = swapped(op);
+            column_first = false;
+        }
+        else
+        {
+            return false;
+        }
+
+        std::string name = quote_identifier(desc->get_name());
+        if (val.is<value_null>())
+        {
+            // only [a] = null and [a] != null can be true
+            if (op != sql_op::equal && op != sql_op::not_equal)
+            {
+                sql_ += negated_ ? "1=1" : "1=0";
+                return true;
+            }
+            // null != '' is false as well, see value.hpp
+            bool exclude_empty = (op == sql_op::not_equal && !column_first &&
+                                  desc->get_type() == String);
+            if (negated_) op = complement(op);
+            if (!exclude_empty)
+            {
+                sql_ += name + (op == sql_op::equal ? " IS NULL" : " IS NOT NULL");
+            }
+            else if (op == sql_op::equal)
+            {
+                sql_ += "(" + name + " IS NULL OR " + name + " = '')";
+            }
+            else
+            {
+                sql_ += "(" + name + " IS NOT NULL AND " + name + " <> '')";
+            }
+            return true;
+        }
+
+        std::ostringstream literal;
+        bool empty_string = false;
+        switch (desc->get_type())
+        {
+        case Integer:
+        case Float:
+        case Double:
+            if (val.is<value_integer>())
+            {
+                literal << val.get<value_integer>();
+            }
+            else if (val.is<value_double>() && std::isfinite(val.get<value_double>()))
+            {
+                write_double(literal, val.get<value_double>());
+            }
+            else return false;
+            break;
+        case String:
+        {
+            // collations differ, only equality is translated
+            if (!val.is<value_unicode_string>()) return false;
+            if (op != sql_op::equal && op != sql_op::not_equal) return false;
+            std::string str;
+            to_utf8(val.get<value_unicode_string>(), str);
+            // no way to write a NUL into a query string
+            if (str.find('\0') != std::string::npos) return false;
+            empty_string = str.empty();
+            bool escape = dialect_ == sql_dialect::postgresql;
+            if (escape) literal << 'E';
+            literal << '\'';
+            for (char c : str)
+            {
+                if (c == '\'' || (escape && c == '\\')) literal << c;
+                literal << c;
+            }
+            literal << '\'';
+            break;
+        }
+        default:
+            return false;
+        }
+
+        // a missing value is unequal to anything but [a] != ''
+        bool null_matches = (op == sql_op::not_equal && !(empty_string && column_first));
+        if (negated_)
+        {
+            op = complement(op);
+            null_matches = !null_matches;
+        }
+        if (null_matches)
+        {
+            sql_ += "(" + name + op_string(op) + literal.str() + " OR " + name + " IS NULL)";
+        }
+        else
+        {
+            sql_ += name + op_string(op) + literal.str();
+        }
+        return true;
+    }
+
+    layer_descriptor const& desc_;
+    attributes const& vars_;
+    sql_dialect dialect_;
+    bool negated_;
+    std::string & sql_;
+};
+
+}
+
+bool to_sql_condition(query const& q, layer_descriptor const& desc, std::string & sql,
+                      sql_dialect dialect)
+{
+    std::vector<expression_ptr> const& filters = q.filters();
+    if (filters.empty()) return false;
+    std::string condition;
+    for (expression_ptr const& filter : filters)
+    {
+        if (!filter) return false;
+        std::string term;
+        if (!util::apply_visitor(sql_condition(desc, q.variables(), dialect, false, term), *filter))
+        {
+            return false;
+        }
+        if (!condition.empty()) condition += " OR ";
+        condition += term;
+    }
+    sql = filters.size() > 1 ? "(" + condition + ")" : condition;
+    return true;
+}
+
+}
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/feature_arena.hpp>
+
+// stl
+#include <cstdint>
+
+namespace mapnik {
+
+// Every allocation is preceded by a pointer to its block.
+struct feature_arena::block
+{
+    // live allocations, plus one while the arena is filling the block
+    std::atomic<std::size_t> live;
+    std::size_t size;
+    std::size_t used;
+
+    char * data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+feature_arena::feature_arena(std::size_t block_size)
+    : block_size_(block_size),
+      current_(nullptr),
+      blocks_allocated_(0) {}
+
+feature_arena::~feature_arena()
+{
+    if (current_) release(current_);
+}
+
+feature_arena::block * feature_arena::new_block(std::size_t size)
+{
+    void * mem = ::operator new(sizeof(block) + size);
+    block * b = new (mem) block;
+    b->live.store(1, std::memory_order_relaxed);
+    b->size = size;
+    b->used = 0;
+    ++blocks_allocated_;
+    return b;
+}
+
+void feature_arena::release(block * b)
+{
+    if (b->live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        b->~block();
+        ::operator delete(b);
+    }
+}
+
+void * feature_arena::allocate(std::size_t size, std::size_t alignment)
+{
+    std::size_t const header = sizeof(block*);
+    if (alignment < alignof(block*)) alignment = alignof(block*);
+    std::size_t const worst = header + alignment - 1 + size;
+    block * b = current_;
+    if (worst > block_size_ / 4)
+    {
+        // large allocations get a block of their own
+        b = new_block(worst);
+    }
+    else if (!b || b->used + worst > b->size)
+    {
+        if (current_) release(current_);
+        current_ = b = new_block(block_size_);
+    }
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(b->data()) + b->used + header;
+    std::uintptr_t aligned = (start + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+    char * ptr = reinterpret_cast<char*>(aligned);
+    *reinterpret_cast<block**>(ptr - header) = b;
+    if (b == current_)
+    {
+        b->used = static_cast<std::size_t>(ptr + size - b->data());
+        b->live.fetch_add(1, std::memory_order_relaxed);
+    }
+    // a block of its own keeps the reference it was created with
+    return ptr;
+}
+
+void feature_arena::deallocate(void * ptr)
+{
+    if (!ptr) return;
+    block * b = *reinterpret_cast<block**>(static_cast<char*>(ptr) - sizeof(block*));
+    release(b);
+}
+
+}
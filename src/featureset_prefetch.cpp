@@ -0,0 +1,220 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/featureset_prefetch.hpp>
+#include <mapnik/feature.hpp>
+
+namespace mapnik {
+
+prefetch_queue::prefetch_queue(std::size_t capacity)
+    : features_(),
+      error_(),
+      query_time_(0.0),
+      capacity_(capacity > 0 ? capacity : 1),
+      done_(false),
+      closed_(false) {}
+
+bool prefetch_queue::push(feature_ptr const& feature)
+{
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return features_.size() < capacity_ || closed_; });
+#endif
+        if (closed_) return false;
+        features_.push_back(feature);
+    }
+#ifdef MAPNIK_THREADSAFE
+    not_empty_.notify_one();
+#endif
+    return true;
+}
+
+void prefetch_queue::done(std::exception_ptr error)
+{
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        error_ = error;
+        done_ = true;
+    }
+#ifdef MAPNIK_THREADSAFE
+    not_empty_.notify_one();
+#endif
+}
+
+bool prefetch_queue::closed() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return closed_;
+}
+
+void prefetch_queue::add_query_time(double ms)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    query_time_ += ms;
+}
+
+double prefetch_queue::query_time() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return query_time_;
+}
+
+feature_ptr prefetch_queue::pop()
+{
+    feature_ptr feature;
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !features_.empty() || done_; });
+#endif
+        if (features_.empty())
+        {
+            if (error_)
+            {
+                std::exception_ptr error = error_;
+                error_ = std::exception_ptr();
+                std::rethrow_exception(error);
+            }
+            return feature;
+        }
+        feature = std::move(features_.front());
+        features_.pop_front();
+    }
+#ifdef MAPNIK_THREADSAFE
+    not_full_.notify_one();
+#endif
+    return feature;
+}
+
+void prefetch_queue::close()
+{
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        closed_ = true;
+        features_.clear();
+    }
+#ifdef MAPNIK_THREADSAFE
+    not_full_.notify_all();
+#endif
+}
+
+prefetch_featureset::prefetch_featureset(std::size_t capacity)
+    : queue_(std::make_shared<prefetch_queue>(capacity)) {}
+
+prefetch_featureset::~prefetch_featureset()
+{
+    queue_->close();
+}
+
+feature_ptr prefetch_featureset::next()
+{
+    return queue_->pop();
+}
+
+prefetch_queue_ptr const& prefetch_featureset::queue() const
+{
+    return queue_;
+}
+
+prefetch_pool::prefetch_pool(std::size_t num_threads)
+    :
+#ifdef MAPNIK_THREADSAFE
+      workers_(),
+      tasks_(),
+      stop_(false),
+#endif
+      num_threads_(num_threads > 0 ? num_threads : 1)
+{
+#ifdef MAPNIK_THREADSAFE
+    workers_.reserve(num_threads_);
+    for (std::size_t i = 0; i < num_threads_; ++i)
+    {
+        workers_.emplace_back(&prefetch_pool::run, this);
+    }
+#endif
+}
+
+prefetch_pool::~prefetch_pool()
+{
+#ifdef MAPNIK_THREADSAFE
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        tasks_.clear();
+    }
+    cond_.notify_all();
+    for (std::thread & worker : workers_)
+    {
+        worker.join();
+    }
+#endif
+}
+
+void prefetch_pool::post(task_type task)
+{
+#ifdef MAPNIK_THREADSAFE
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cond_.notify_one();
+#else
+    task();
+#endif
+}
+
+std::size_t prefetch_pool::size() const
+{
+    return num_threads_;
+}
+
+#ifdef MAPNIK_THREADSAFE
+void prefetch_pool::run()
+{
+    for (;;)
+    {
+        task_type task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (stop_) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+#endif
+
+}
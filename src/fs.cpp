@@ -29,7 +29,10 @@
 #include <boost/filesystem/path.hpp>    // for path, operator/
 
 // stl
+#include <algorithm>
+#include <fstream>
 #include <stdexcept>
+#include <utility>
 
 namespace mapnik {
 
@@ -71,6 +74,86 @@ namespace util {
 #endif
     }
 
+    void rename(std::string const& from, std::string const& to)
+    {
+#ifdef _WINDOWS
+        boost::filesystem::rename(mapnik::utf8_to_utf16(from), mapnik::utf8_to_utf16(to));
+#else
+        boost::filesystem::rename(from, to);
+#endif
+    }
+
+    std::uintmax_t file_size(std::string const& filepath)
+    {
+#ifdef _WINDOWS
+        return boost::filesystem::file_size(mapnik::utf8_to_utf16(filepath));
+#else
+        return boost::filesystem::file_size(filepath);
+#endif
+    }
+
+    std::time_t last_write_time(std::string const& filepath)
+    {
+#ifdef _WINDOWS
+        return boost::filesystem::last_write_time(mapnik::utf8_to_utf16(filepath));
+#else
+        return boost::filesystem::last_write_time(filepath);
+#endif
+    }
+
+    // FNV-1a over the first and last 64KiB of the file and 4KiB samples
+    // spread in between, reading at most 192KiB. Together with the size
+    // and modification time it tells apart versions of a file edited
+    // within the same second without changing size.
+    std::uint64_t file_fingerprint(std::string const& filepath)
+    {
+#ifdef _WINDOWS
+        std::ifstream in(mapnik::utf8_to_utf16(filepath), std::ios::in | std::ios::binary);
+#else
+        std::ifstream in(filepath.c_str(), std::ios::in | std::ios::binary);
+#endif
+        if (!in) throw std::runtime_error("could not open '" + filepath + "'");
+        in.seekg(0, std::ios::end);
+        std::uint64_t size = static_cast<std::uint64_t>(static_cast<std::streamoff>(in.tellg()));
+        std::uint64_t const edge = 64 * 1024;
+        std::uint64_t const sample = 4 * 1024;
+        std::uint64_t const num_samples = 16;
+        std::vector<std::pair<std::uint64_t, std::uint64_t> > ranges;
+        if (size <= 2 * edge + num_samples * sample)
+        {
+            ranges.emplace_back(0, size);
+        }
+        else
+        {
+            ranges.emplace_back(0, edge);
+            std::uint64_t step = (size - 2 * edge) / num_samples;
+            for (std::uint64_t i = 0; i < num_samples; ++i)
+            {
+                ranges.emplace_back(edge + i * step, sample);
+            }
+            ranges.emplace_back(size - edge, edge);
+        }
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < 8; ++i)
+        {
+            hash = (hash ^ ((size >> (i * 8)) & 0xff)) * 1099511628211ULL;
+        }
+        std::vector<char> buffer(static_cast<std::size_t>(std::min(size, 2 * edge + num_samples * sample)));
+        for (auto const& range : ranges)
+        {
+            in.seekg(static_cast<std::streamoff>(range.first), std::ios::beg);
+            if (!in.read(buffer.data(), static_cast<std::streamsize>(range.second)))
+            {
+                throw std::runtime_error("could not read '" + filepath + "'");
+            }
+            for (std::uint64_t j = 0; j < range.second; ++j)
+            {
+                hash = (hash ^ static_cast<unsigned char>(buffer[j])) * 1099511628211ULL;
+            }
+        }
+        return hash;
+    }
+
     bool is_relative(std::string const& filepath)
     {
 
@@ -36,6 +36,7 @@ template MAPNIK_DECL mapnik::box2d<double> envelope(multi_point<double> const& g
 template MAPNIK_DECL mapnik::box2d<double> envelope(multi_line_string<double> const& geom);
 template MAPNIK_DECL mapnik::box2d<double> envelope(multi_polygon<double> const& geom);
 template MAPNIK_DECL mapnik::box2d<double> envelope(geometry_collection<double> const& geom);
+template MAPNIK_DECL mapnik::box2d<double> envelope(flat_geometry<double> const& geom);
 
 template MAPNIK_DECL mapnik::box2d<double> envelope(geometry<std::int64_t> const& geom);
 template MAPNIK_DECL mapnik::box2d<double> envelope(point<std::int64_t> const& geom);
@@ -133,7 +133,7 @@ void hit_grid<T>::add_feature(mapnik::feature_impl const& feature)
             // to building up a in-memory cache of feature_ptrs
             // https://github.com/mapnik/mapnik/issues/1198
             mapnik::feature_ptr feature2(mapnik::feature_factory::create(ctx_,feature_id));
-            feature2->set_data(feature.get_data());
+            feature.copy_data_to(*feature2);
             features_.emplace(lookup_value,feature2);
         }
     }
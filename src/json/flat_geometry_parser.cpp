@@ -0,0 +1,262 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/json/flat_geometry_parser.hpp>
+#include <mapnik/util/conversions.hpp>
+
+// stl
+#include <cctype>
+#include <cstring>
+
+namespace mapnik { namespace json {
+
+namespace {
+
+using mapnik::geometry::geometry_types;
+
+class flat_geometry_reader
+{
+public:
+    flat_geometry_reader(char const* start, char const* end, mapnik::geometry::flat_geometry<double> & geom)
+        : itr_(start),
+          end_(end),
+          geom_(geom) {}
+
+    bool read()
+    {
+        geom_.clear();
+        char const* coordinates = nullptr;
+        if (!accept('{')) return false;
+        if (peek() == '}') return false;
+        do
+        {
+            std::string key;
+            if (!read_string(key) || !accept(':')) return false;
+            if (key == "type")
+            {
+                std::string type;
+                if (!read_string(type) || !set_type(type)) return false;
+            }
+            else if (key == "coordinates")
+            {
+                skip_space();
+                coordinates = itr_;
+                if (!skip_value()) return false;
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+        }
+        while (accept(','));
+        if (!accept('}') || !coordinates) return false;
+        // coordinates are read once the type is known, wherever it comes
+        itr_ = coordinates;
+        return read_coordinates();
+    }
+
+private:
+    bool set_type(std::string const& type)
+    {
+        if (type == "Point") geom_.set_type(geometry_types::Point);
+        else if (type == "LineString") geom_.set_type(geometry_types::LineString);
+        else if (type == "Polygon") geom_.set_type(geometry_types::Polygon);
+        else if (type == "MultiPoint") geom_.set_type(geometry_types::MultiPoint);
+        else if (type == "MultiLineString") geom_.set_type(geometry_types::MultiLineString);
+        else if (type == "MultiPolygon") geom_.set_type(geometry_types::MultiPolygon);
+        else return false;
+        return true;
+    }
+
+    bool read_coordinates()
+    {
+        switch (geom_.type())
+        {
+        case geometry_types::Point:
+            return read_point();
+        case geometry_types::LineString:
+            geom_.begin_part();
+            geom_.begin_ring();
+            return read_positions();
+        case geometry_types::Polygon:
+            return read_polygon();
+        case geometry_types::MultiPoint:
+            return read_array([this] { return read_point(); });
+        case geometry_types::MultiLineString:
+            return read_array([this] {
+                    geom_.begin_part();
+                    geom_.begin_ring();
+                    return read_positions();
+                });
+        case geometry_types::MultiPolygon:
+            return read_array([this] { return read_polygon(); });
+        default:
+            break;
+        }
+        return false;
+    }
+
+    bool read_point()
+    {
+        geom_.begin_part();
+        geom_.begin_ring();
+        return read_position();
+    }
+
+    bool read_polygon()
+    {
+        geom_.begin_part();
+        bool exterior = true;
+        return read_array([this, &exterior] {
+                geom_.begin_ring();
+                if (!read_positions()) return false;
+                geom_.close_ring(exterior);
+                exterior = false;
+                return true;
+            });
+    }
+
+    bool read_positions()
+    {
+        return read_array([this] { return read_position(); });
+    }
+
+    bool read_position()
+    {
+        double x, y;
+        if (!accept('[') || !read_number(x) || !accept(',') || !read_number(y)) return false;
+        // extra ordinates are ignored
+        while (accept(','))
+        {
+            double z;
+            if (!read_number(z)) return false;
+        }
+        if (!accept(']')) return false;
+        geom_.add_coord(x, y);
+        return true;
+    }
+
+    template <typename ReadElement>
+    bool read_array(ReadElement read_element)
+    {
+        if (!accept('[')) return false;
+        if (accept(']')) return true;
+        do
+        {
+            if (!read_element()) return false;
+        }
+        while (accept(','));
+        return accept(']');
+    }
+
+    bool read_number(double & value)
+    {
+        skip_space();
+        char const* start = itr_;
+        while (itr_ != end_ && *itr_ != '\0' && std::strchr("+-.0123456789eE", *itr_)) ++itr_;
+        return start != itr_ && mapnik::util::string2double(start, itr_, value);
+    }
+
+    bool read_string(std::string & str)
+    {
+        if (!accept('"')) return false;
+        while (itr_ != end_ && *itr_ != '"')
+        {
+            if (*itr_ == '\\' && ++itr_ == end_) return false;
+            str += *itr_++;
+        }
+        if (itr_ == end_) return false;
+        ++itr_;
+        return true;
+    }
+
+    bool skip_value()
+    {
+        skip_space();
+        if (itr_ == end_) return false;
+        if (*itr_ == '"')
+        {
+            std::string str;
+            return read_string(str);
+        }
+        if (*itr_ == '{' || *itr_ == '[')
+        {
+            // objects and arrays nest, strings may hold brackets
+            std::size_t depth = 0;
+            while (itr_ != end_)
+            {
+                char c = *itr_;
+                if (c == '"')
+                {
+                    std::string str;
+                    if (!read_string(str)) return false;
+                    continue;
+                }
+                ++itr_;
+                if (c == '{' || c == '[') ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0) return true;
+            }
+            return false;
+        }
+        // number, true, false or null
+        char const* start = itr_;
+        while (itr_ != end_ && *itr_ != ',' && *itr_ != '}' && *itr_ != ']' &&
+               !std::isspace(static_cast<unsigned char>(*itr_))) ++itr_;
+        return start != itr_;
+    }
+
+    void skip_space()
+    {
+        while (itr_ != end_ && std::isspace(static_cast<unsigned char>(*itr_))) ++itr_;
+    }
+
+    char peek()
+    {
+        skip_space();
+        return itr_ != end_ ? *itr_ : '\0';
+    }
+
+    bool accept(char c)
+    {
+        if (peek() != c) return false;
+        ++itr_;
+        return true;
+    }
+
+    char const* itr_;
+    char const* end_;
+    mapnik::geometry::flat_geometry<double> & geom_;
+};
+
+}
+
+bool from_geojson(char const* start, char const* end, mapnik::geometry::flat_geometry<double> & geom)
+{
+    flat_geometry_reader reader(start, end, geom);
+    if (reader.read()) return true;
+    geom.clear();
+    return false;
+}
+
+}}
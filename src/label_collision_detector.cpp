@@ -0,0 +1,207 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/label_collision_detector.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+
+namespace mapnik {
+
+namespace {
+
+// upper bound on the grid size, cells grow beyond it
+constexpr std::size_t max_cells = 1 << 20;
+
+box2d<double> pad_box(box2d<double> const& box, double margin)
+{
+    if (margin > 0)
+    {
+        return box2d<double>(box.minx() - margin, box.miny() - margin,
+                             box.maxx() + margin, box.maxy() + margin);
+    }
+    return box;
+}
+
+}
+
+constexpr double label_collision_detector4::default_cell_size;
+
+label_collision_detector4::label_collision_detector4(box2d<double> const& extent, double cell_size)
+    : extent_(),
+      base_cell_size_(cell_size > 0 ? cell_size : default_cell_size),
+      cell_size_(base_cell_size_),
+      columns_(0),
+      rows_(0)
+{
+    reset(extent);
+}
+
+void label_collision_detector4::reset(box2d<double> const& extent)
+{
+    clear();
+    extent_ = extent;
+    cell_size_ = base_cell_size_;
+    for (;;)
+    {
+        columns_ = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(extent_.width() / cell_size_)));
+        rows_ = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(extent_.height() / cell_size_)));
+        if (columns_ * rows_ <= max_cells) break;
+        cell_size_ *= 2;
+    }
+    // cells beyond the new grid keep their storage for later reuse
+    if (cells_.size() < columns_ * rows_)
+    {
+        cells_.resize(columns_ * rows_);
+    }
+}
+
+void label_collision_detector4::clear()
+{
+    for (std::size_t cell : used_cells_)
+    {
+        cells_[cell].clear();
+    }
+    used_cells_.clear();
+    labels_.clear();
+}
+
+std::size_t label_collision_detector4::column(double x) const
+{
+    double c = std::floor((x - extent_.minx()) / cell_size_);
+    if (!(c > 0)) return 0;
+    if (c >= static_cast<double>(columns_)) return columns_ - 1;
+    return static_cast<std::size_t>(c);
+}
+
+std::size_t label_collision_detector4::row(double y) const
+{
+    double r = std::floor((y - extent_.miny()) / cell_size_);
+    if (!(r > 0)) return 0;
+    if (r >= static_cast<double>(rows_)) return rows_ - 1;
+    return static_cast<std::size_t>(r);
+}
+
+template <typename Predicate>
+bool label_collision_detector4::none_in_box(box2d<double> const& box, Predicate pred) const
+{
+    if (labels_.empty() || !extent_.intersects(box)) return true;
+    std::size_t x0 = column(box.minx());
+    std::size_t x1 = column(box.maxx());
+    std::size_t y0 = row(box.miny());
+    std::size_t y1 = row(box.maxy());
+    for (std::size_t y = y0; y <= y1; ++y)
+    {
+        for (std::size_t x = x0; x <= x1; ++x)
+        {
+            // labels spanning several cells may be tested more than once
+            for (std::uint32_t index : cells_[y * columns_ + x])
+            {
+                if (pred(labels_[index])) return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool label_collision_detector4::has_placement(box2d<double> const& box) const
+{
+    return none_in_box(box, [&box](label const& other) { return other.box.intersects(box); });
+}
+
+bool label_collision_detector4::has_placement(box2d<double> const& box, double margin) const
+{
+    box2d<double> margin_box = pad_box(box, margin);
+    return none_in_box(margin_box, [&margin_box](label const& other) { return other.box.intersects(margin_box); });
+}
+
+bool label_collision_detector4::has_placement(box2d<double> const& box, double margin,
+                                              mapnik::value_unicode_string const& text, double repeat_distance) const
+{
+    // Don't bother with any of the repeat checking unless the repeat distance is greater than the margin
+    if (repeat_distance <= margin)
+    {
+        return has_placement(box, margin);
+    }
+    box2d<double> repeat_box = pad_box(box, repeat_distance);
+    box2d<double> margin_box = pad_box(box, margin);
+    std::size_t key = repeat_key(text);
+    return none_in_box(repeat_box, [&](label const& other)
+                       {
+                           return other.box.intersects(margin_box) ||
+                               (key == other.repeat_key && other.box.intersects(repeat_box));
+                       });
+}
+
+void label_collision_detector4::insert(box2d<double> const& box)
+{
+    if (extent_.intersects(box))
+    {
+        insert(label(box));
+    }
+}
+
+void label_collision_detector4::insert(box2d<double> const& box, mapnik::value_unicode_string const& text)
+{
+    if (extent_.intersects(box))
+    {
+        insert(label(box, repeat_key(text)));
+    }
+}
+
+void label_collision_detector4::insert(label const& lbl)
+{
+    std::uint32_t index = static_cast<std::uint32_t>(labels_.size());
+    labels_.push_back(lbl);
+    std::size_t x0 = column(lbl.box.minx());
+    std::size_t x1 = column(lbl.box.maxx());
+    std::size_t y0 = row(lbl.box.miny());
+    std::size_t y1 = row(lbl.box.maxy());
+    for (std::size_t y = y0; y <= y1; ++y)
+    {
+        for (std::size_t x = x0; x <= x1; ++x)
+        {
+            std::size_t cell = y * columns_ + x;
+            if (cells_[cell].empty()) used_cells_.push_back(cell);
+            cells_[cell].push_back(index);
+        }
+    }
+}
+
+std::size_t label_collision_detector4::repeat_key(mapnik::value_unicode_string const& text)
+{
+    if (text.isEmpty()) return 0;
+    // FNV-1a over the UTF-16 code units
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (std::int32_t i = 0; i < text.length(); ++i)
+    {
+        hash ^= static_cast<std::uint16_t>(text.charAt(i));
+        hash *= 1099511628211ULL;
+    }
+    std::size_t key = static_cast<std::size_t>(hash ^ (hash >> 32));
+    return key != 0 ? key : 1;
+}
+
+}
@@ -31,6 +31,7 @@
 
 // stl
 #include <algorithm>
+#include <vector>
 
 using mapnik::datasource;
 using mapnik::parameters;
@@ -83,6 +84,7 @@ void memory_datasource::push(feature_ptr feature)
     //desc_.add_descriptor(attribute_descriptor(fld_name,mapnik::Integer));
     features_.push_back(feature);
     dirty_extent_ = true;
+    spatial_index_.reset();
 }
 
 datasource::datasource_t memory_datasource::type() const
@@ -90,8 +92,45 @@ datasource::datasource_t memory_datasource::type() const
     return type_;
 }
 
+std::shared_ptr<memory_datasource::spatial_index_type const> memory_datasource::spatial_index() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(spatial_index_mutex_);
+#endif
+    if (!spatial_index_)
+    {
+        std::vector<spatial_index_type::item_type> items;
+        items.reserve(features_.size());
+        for (std::size_t i = 0; i < features_.size(); ++i)
+        {
+            items.emplace_back(geometry::envelope(features_[i]->get_geometry()), i);
+        }
+        spatial_index_ = std::make_shared<spatial_index_type>(std::move(items));
+    }
+    return spatial_index_;
+}
+
+featureset_ptr memory_datasource::query_index(box2d<double> const& box) const
+{
+    std::shared_ptr<spatial_index_type const> index = spatial_index();
+    std::vector<std::size_t> matches;
+    index->query(box, [&matches](std::size_t i) { matches.push_back(i); return true; });
+    // in insertion order, as without the index
+    std::sort(matches.begin(), matches.end());
+    std::deque<feature_ptr> selected;
+    for (std::size_t i : matches)
+    {
+        selected.push_back(features_[i]);
+    }
+    return std::make_shared<memory_featureset>(std::move(selected));
+}
+
 featureset_ptr memory_datasource::features(const query& q) const
 {
+    if (bbox_check_ && type_ == datasource::Vector && features_.size() >= min_indexed_features)
+    {
+        return query_index(q.get_bbox());
+    }
     return std::make_shared<memory_featureset>(q.get_bbox(),*this,bbox_check_);
 }
 
@@ -101,6 +140,10 @@ featureset_ptr memory_datasource::features_at_point(coord2d const& pt, double to
     box2d<double> box = box2d<double>(pt.x, pt.y, pt.x, pt.y);
     box.pad(tol);
     MAPNIK_LOG_DEBUG(memory_datasource) << "memory_datasource: Box=" << box << ", Point x=" << pt.x << ",y=" << pt.y;
+    if (type_ == datasource::Vector && features_.size() >= min_indexed_features)
+    {
+        return query_index(box);
+    }
     return std::make_shared<memory_featureset>(box,*this);
 }
 
@@ -139,6 +182,7 @@ size_t memory_datasource::size() const
 void memory_datasource::clear()
 {
     features_.clear();
+    spatial_index_.reset();
 }
 
 }
@@ -0,0 +1,121 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/render_stats.hpp>
+
+// stl
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+namespace mapnik {
+
+namespace {
+
+void write_string(std::ostream & out, std::string const& str)
+{
+    out << '"';
+    for (char c : str)
+    {
+        switch (c)
+        {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                out << buf;
+            }
+            else
+            {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+void write_style(std::ostream & out, style_stats const& style)
+{
+    out << "{\"name\":";
+    write_string(out, style.name);
+    out << ",\"first_feature_time\":" << style.first_feature_time
+        << ",\"render_time\":" << style.render_time
+        << ",\"compositing_time\":" << style.compositing_time
+        << ",\"features_fetched\":" << style.features_fetched
+        << ",\"filters_evaluated\":" << style.filters_evaluated
+        << ",\"features_painted\":" << style.features_painted
+        << ",\"symbolizer_times\":{";
+    bool first = true;
+    for (auto const& kv : style.symbolizer_times)
+    {
+        if (!first) out << ',';
+        first = false;
+        write_string(out, kv.first);
+        out << ':' << kv.second;
+    }
+    out << "}}";
+}
+
+void write_layer(std::ostream & out, layer_stats const& layer)
+{
+    out << "{\"name\":";
+    write_string(out, layer.name);
+    out << ",\"query_time\":" << layer.query_time
+        << ",\"render_time\":" << layer.render_time
+        << ",\"compositing_time\":" << layer.compositing_time
+        << ",\"styles\":[";
+    bool first = true;
+    for (style_stats const& style : layer.styles)
+    {
+        if (!first) out << ',';
+        first = false;
+        write_style(out, style);
+    }
+    out << "]}";
+}
+
+}
+
+std::string to_json(render_stats const& stats)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"layers\":[";
+    bool first = true;
+    for (layer_stats const& layer : stats.layers)
+    {
+        if (!first) out << ',';
+        first = false;
+        write_layer(out, layer);
+    }
+    out << "]}";
+    return out.str();
+}
+
+}
@@ -37,6 +37,7 @@ rule::rule()
       max_scale_(std::numeric_limits<double>::infinity()),
       syms_(),
       filter_(std::make_shared<expr_node>(true)),
+      filter_program_(filter_),
       else_filter_(false),
       also_filter_(false) {}
 
@@ -48,6 +49,7 @@ rule::rule(std::string const& name,
       max_scale_(max_scale_denominator),
       syms_(),
       filter_(std::make_shared<mapnik::expr_node>(true)),
+      filter_program_(filter_),
       else_filter_(false),
       also_filter_(false)  {}
 
@@ -57,6 +59,7 @@ rule::rule(rule const& rhs)
       max_scale_(rhs.max_scale_),
       syms_(rhs.syms_),
       filter_(std::make_shared<expr_node>(*rhs.filter_)),
+      filter_program_(filter_),
       else_filter_(rhs.else_filter_),
       also_filter_(rhs.also_filter_) {}
 
@@ -66,6 +69,7 @@ rule::rule(rule && rhs)
       max_scale_(std::move(rhs.max_scale_)),
       syms_(std::move(rhs.syms_)),
       filter_(std::move(rhs.filter_)),
+      filter_program_(std::move(rhs.filter_program_)),
       else_filter_(std::move(rhs.else_filter_)),
       also_filter_(std::move(rhs.also_filter_)) {}
 
@@ -77,6 +81,7 @@ rule& rule::operator=(rule rhs)
     swap(this->max_scale_, rhs.max_scale_);
     swap(this->syms_, rhs.syms_);
     swap(this->filter_, rhs.filter_);
+    swap(this->filter_program_, rhs.filter_program_);
     swap(this->else_filter_, rhs.else_filter_);
     swap(this->also_filter_, rhs.also_filter_);
     return *this;
@@ -165,6 +170,7 @@ rule::symbolizers::iterator rule::end()
 void rule::set_filter(expression_ptr const& filter)
 {
     filter_=filter;
+    filter_program_ = expression_program(filter_);
 }
 
 expression_ptr const& rule::get_filter() const
@@ -172,6 +178,11 @@ expression_ptr const& rule::get_filter() const
     return filter_;
 }
 
+expression_program const& rule::get_filter_program() const
+{
+    return filter_program_;
+}
+
 void rule::set_else(bool else_filter)
 {
     else_filter_=else_filter;
@@ -0,0 +1,189 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/rule_cache.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/feature.hpp>
+
+// stl
+#include <algorithm>
+#include <iterator>
+
+namespace mapnik {
+
+namespace {
+
+// an attribute a filter can only match when it equals the literal
+struct equality_key
+{
+    std::string name;
+    value key;
+};
+
+// Collects [attr] = literal tests a filter cannot be true without.
+// Numeric literals are kept as doubles: values of different numeric
+// types that compare equal convert to the same double.
+struct collect_equality_keys
+{
+    explicit collect_equality_keys(std::vector<equality_key> & keys)
+        : keys_(keys) {}
+
+    void operator() (binary_node<tags::logical_and> const& x) const
+    {
+        util::apply_visitor(*this, x.left);
+        util::apply_visitor(*this, x.right);
+    }
+
+    void operator() (binary_node<tags::equal_to> const& x) const
+    {
+        add(x.left, x.right);
+        add(x.right, x.left);
+    }
+
+    template <typename T>
+    void operator() (T const&) const {}
+
+private:
+    void add(expr_node const& attr, expr_node const& lit) const
+    {
+        if (!attr.is<attribute>()) return;
+        std::string const& name = attr.get<attribute>().name();
+        if (lit.is<value_unicode_string>())
+        {
+            keys_.push_back(equality_key{name, lit.get<value_unicode_string>()});
+        }
+        else if (lit.is<value_integer>())
+        {
+            keys_.push_back(equality_key{name, static_cast<value_double>(lit.get<value_integer>())});
+        }
+        else if (lit.is<value_double>())
+        {
+            keys_.push_back(equality_key{name, lit.get<value_double>()});
+        }
+        else if (lit.is<value_bool>())
+        {
+            keys_.push_back(equality_key{name, lit.get<value_bool>() ? 1.0 : 0.0});
+        }
+    }
+
+    std::vector<equality_key> & keys_;
+};
+
+equality_key const* find_key(std::vector<equality_key> const& keys, std::string const& name)
+{
+    for (equality_key const& key : keys)
+    {
+        if (key.name == name) return &key;
+    }
+    return nullptr;
+}
+
+template <typename Map>
+void merge_unkeyed(Map & buckets, rule_cache::rule_indices const& unkeyed)
+{
+    for (auto & kv : buckets)
+    {
+        rule_cache::rule_indices merged;
+        merged.reserve(kv.second.size() + unkeyed.size());
+        std::merge(kv.second.begin(), kv.second.end(),
+                   unkeyed.begin(), unkeyed.end(),
+                   std::back_inserter(merged));
+        kv.second.swap(merged);
+    }
+}
+
+}
+
+void rule_cache::build_index()
+{
+    index_key_.clear();
+    unkeyed_rules_.clear();
+    string_rules_.clear();
+    number_rules_.clear();
+
+    std::vector<std::vector<equality_key> > rule_keys(if_rules_.size());
+    std::vector<std::pair<std::string, std::size_t> > counts;
+    for (std::size_t i = 0; i < if_rules_.size(); ++i)
+    {
+        expression_ptr const& filter = if_rules_[i]->get_filter();
+        if (!filter) continue;
+        util::apply_visitor(collect_equality_keys(rule_keys[i]), *filter);
+        for (std::size_t k = 0; k < rule_keys[i].size(); ++k)
+        {
+            std::string const& name = rule_keys[i][k].name;
+            // count every attribute once per rule
+            if (find_key(rule_keys[i], name) != &rule_keys[i][k]) continue;
+            auto itr = std::find_if(counts.begin(), counts.end(),
+                                    [&name](std::pair<std::string, std::size_t> const& count)
+                                    { return count.first == name; });
+            if (itr == counts.end()) counts.emplace_back(name, 1);
+            else ++itr->second;
+        }
+    }
+
+    // dispatch on the attribute keyed by most rules, the first one on ties
+    auto best = std::max_element(counts.begin(), counts.end(),
+                                 [](std::pair<std::string, std::size_t> const& lhs,
+                                    std::pair<std::string, std::size_t> const& rhs)
+                                 { return lhs.second < rhs.second; });
+    if (best == counts.end() || best->second < min_indexed_rules) return;
+    index_key_ = best->first;
+
+    for (std::size_t i = 0; i < if_rules_.size(); ++i)
+    {
+        equality_key const* key = find_key(rule_keys[i], index_key_);
+        if (!key)
+        {
+            unkeyed_rules_.push_back(i);
+        }
+        else if (key->key.is<value_unicode_string>())
+        {
+            string_rules_[key->key.get<value_unicode_string>()].push_back(i);
+        }
+        else
+        {
+            number_rules_[key->key.get<value_double>()].push_back(i);
+        }
+    }
+    merge_unkeyed(string_rules_, unkeyed_rules_);
+    merge_unkeyed(number_rules_, unkeyed_rules_);
+}
+
+rule_cache::rule_indices const& rule_cache::candidates(feature_impl const& feature) const
+{
+    if (index_key_.empty()) return all_rules_;
+    value const& val = feature.get(index_key_);
+    if (val.is<value_unicode_string>())
+    {
+        auto itr = string_rules_.find(val.get<value_unicode_string>());
+        if (itr != string_rules_.end()) return itr->second;
+    }
+    else if (val.is<value_integer>() || val.is<value_double>() || val.is<value_bool>())
+    {
+        auto itr = number_rules_.find(val.to_double());
+        if (itr != number_rules_.end()) return itr->second;
+    }
+    return unkeyed_rules_;
+}
+
+}
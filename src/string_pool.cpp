@@ -0,0 +1,64 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/string_pool.hpp>
+
+// boost
+#include <boost/functional/hash.hpp>
+
+// stl
+#include <cstring>
+
+namespace mapnik {
+
+string_pool::string_pool(transcoder const& tr, std::size_t max_strings)
+    : tr_(tr),
+      max_strings_(max_strings),
+      keys_(),
+      strings_() {}
+
+std::size_t string_pool::key_hash::operator()(boost::string_ref const& key) const
+{
+    return boost::hash_range(key.begin(), key.end());
+}
+
+mapnik::value_unicode_string string_pool::intern(const char* data, std::int32_t length)
+{
+    if (length < 0) length = static_cast<std::int32_t>(std::strlen(data));
+    boost::string_ref key(data, static_cast<std::size_t>(length));
+    auto itr = strings_.find(key);
+    if (itr != strings_.end())
+    {
+        return itr->second;
+    }
+    mapnik::value_unicode_string ustr = tr_.transcode(data, length);
+    if (strings_.size() < max_strings_)
+    {
+        keys_.emplace_back(data, static_cast<std::size_t>(length));
+        std::string const& owned = keys_.back();
+        strings_.emplace(boost::string_ref(owned.data(), owned.size()), ustr);
+    }
+    return ustr;
+}
+
+}
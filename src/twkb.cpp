@@ -0,0 +1,285 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/wkb.hpp>
+#include <mapnik/geometry_correct.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cmath>
+#include <cstdint>
+
+namespace mapnik
+{
+
+/*!
+ * Tiny WKB, the compact encoding returned by PostGIS ST_AsTWKB: coordinates
+ * are rounded to a decimal precision and stored as zigzag encoded varint
+ * deltas from the previous coordinate.
+ *
+ * https://github.com/TWKB/Specification
+ */
+struct twkb_reader : util::noncopyable
+{
+private:
+    const char* twkb_;
+    std::size_t size_;
+    std::size_t pos_;
+    bool valid_;
+    double factor_;
+    std::size_t dims_;
+    bool has_idlist_;
+    std::int64_t x_;
+    std::int64_t y_;
+
+public:
+
+    enum twkbGeometryType : std::uint8_t
+    {
+        twkbPoint = 1,
+        twkbLineString = 2,
+        twkbPolygon = 3,
+        twkbMultiPoint = 4,
+        twkbMultiLineString = 5,
+        twkbMultiPolygon = 6,
+        twkbGeometryCollection = 7
+    };
+
+    twkb_reader(const char* twkb, std::size_t size)
+        : twkb_(twkb),
+          size_(size),
+          pos_(0),
+          valid_(true),
+          factor_(1.0),
+          dims_(2),
+          has_idlist_(false),
+          x_(0),
+          y_(0) {}
+
+    mapnik::geometry::geometry<double> read()
+    {
+        mapnik::geometry::geometry<double> geom = read_geometry();
+        if (!valid_) return mapnik::geometry::geometry_empty();
+        return geom;
+    }
+
+private:
+
+    std::uint8_t read_byte()
+    {
+        if (pos_ >= size_)
+        {
+            valid_ = false;
+            return 0;
+        }
+        return static_cast<std::uint8_t>(twkb_[pos_++]);
+    }
+
+    std::uint64_t read_unsigned()
+    {
+        std::uint64_t val = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            std::uint8_t byte = read_byte();
+            val |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return val;
+        }
+        valid_ = false;
+        return 0;
+    }
+
+    std::int64_t read_signed()
+    {
+        std::uint64_t val = read_unsigned();
+        return static_cast<std::int64_t>(val >> 1) ^ -static_cast<std::int64_t>(val & 1);
+    }
+
+    // a count can't exceed the number of bytes left, each item takes at least one
+    std::size_t read_count()
+    {
+        std::uint64_t count = read_unsigned();
+        if (count > size_ - pos_)
+        {
+            valid_ = false;
+            return 0;
+        }
+        return static_cast<std::size_t>(count);
+    }
+
+    template <typename Ring>
+    void read_coords(Ring & ring, std::size_t num_points)
+    {
+        ring.reserve(num_points);
+        for (std::size_t i = 0; i < num_points && valid_; ++i)
+        {
+            x_ += read_signed();
+            y_ += read_signed();
+            // Z and M ordinates are skipped
+            for (std::size_t d = 2; d < dims_; ++d) read_signed();
+            ring.emplace_back(x_ / factor_, y_ / factor_);
+        }
+    }
+
+    mapnik::geometry::point<double> read_point()
+    {
+        mapnik::geometry::line_string<double> coords;
+        read_coords(coords, 1);
+        if (coords.empty()) return mapnik::geometry::point<double>();
+        return coords.front();
+    }
+
+    mapnik::geometry::line_string<double> read_linestring()
+    {
+        mapnik::geometry::line_string<double> line;
+        read_coords(line, read_count());
+        return line;
+    }
+
+    mapnik::geometry::polygon<double> read_polygon()
+    {
+        mapnik::geometry::polygon<double> poly;
+        std::size_t num_rings = read_count();
+        if (num_rings > 1) poly.interior_rings.reserve(num_rings - 1);
+        for (std::size_t i = 0; i < num_rings && valid_; ++i)
+        {
+            mapnik::geometry::linear_ring<double> ring;
+            read_coords(ring, read_count());
+            if (i == 0) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+        }
+        return poly;
+    }
+
+    std::size_t read_multi_header()
+    {
+        std::size_t num_geoms = read_count();
+        if (has_idlist_)
+        {
+            for (std::size_t i = 0; i < num_geoms && valid_; ++i) read_signed();
+        }
+        return num_geoms;
+    }
+
+    mapnik::geometry::geometry<double> read_geometry()
+    {
+        std::uint8_t type_and_precision = read_byte();
+        std::uint8_t metadata = read_byte();
+        if (!valid_) return mapnik::geometry::geometry_empty();
+
+        // precision is zigzag encoded in the upper four bits
+        std::uint8_t zigzag = type_and_precision >> 4;
+        int precision = (zigzag >> 1) ^ -(zigzag & 1);
+        factor_ = std::pow(10.0, precision);
+        dims_ = 2;
+        has_idlist_ = (metadata & 0x04) != 0;
+        x_ = 0;
+        y_ = 0;
+
+        if (metadata & 0x08)
+        {
+            std::uint8_t extended = read_byte();
+            if (extended & 0x01) ++dims_;
+            if (extended & 0x02) ++dims_;
+        }
+        if (metadata & 0x02)
+        {
+            // size of the rest of the geometry, not needed here
+            read_unsigned();
+        }
+        if (metadata & 0x01)
+        {
+            // bounding box, min and delta per dimension
+            for (std::size_t d = 0; d < dims_ * 2; ++d) read_signed();
+        }
+        if (!valid_ || (metadata & 0x10))
+        {
+            return mapnik::geometry::geometry_empty();
+        }
+
+        switch (type_and_precision & 0x0f)
+        {
+        case twkbPoint:
+            return read_point();
+        case twkbLineString:
+            return read_linestring();
+        case twkbPolygon:
+            return read_polygon();
+        case twkbMultiPoint:
+        {
+            mapnik::geometry::multi_point<double> multi_point;
+            read_coords(multi_point, read_multi_header());
+            return multi_point;
+        }
+        case twkbMultiLineString:
+        {
+            std::size_t num_lines = read_multi_header();
+            mapnik::geometry::multi_line_string<double> multi_line;
+            multi_line.reserve(num_lines);
+            for (std::size_t i = 0; i < num_lines && valid_; ++i)
+            {
+                multi_line.push_back(read_linestring());
+            }
+            return multi_line;
+        }
+        case twkbMultiPolygon:
+        {
+            std::size_t num_polys = read_multi_header();
+            mapnik::geometry::multi_polygon<double> multi_poly;
+            multi_poly.reserve(num_polys);
+            for (std::size_t i = 0; i < num_polys && valid_; ++i)
+            {
+                multi_poly.push_back(read_polygon());
+            }
+            return multi_poly;
+        }
+        case twkbGeometryCollection:
+        {
+            // members are complete geometries with their own header
+            std::size_t num_geoms = read_multi_header();
+            mapnik::geometry::geometry_collection<double> collection;
+            collection.reserve(num_geoms);
+            for (std::size_t i = 0; i < num_geoms && valid_; ++i)
+            {
+                collection.push_back(read_geometry());
+            }
+            return collection;
+        }
+        default:
+            valid_ = false;
+            break;
+        }
+        return mapnik::geometry::geometry_empty();
+    }
+};
+
+mapnik::geometry::geometry<double> geometry_utils::from_twkb(const char* twkb,
+                                                             std::size_t size)
+{
+    twkb_reader reader(twkb, size);
+    mapnik::geometry::geometry<double> geom(reader.read());
+    // note: this will only be applied to polygons
+    mapnik::geometry::correct(geom);
+    return geom;
+}
+
+} // namespace mapnik
@@ -25,15 +25,33 @@
 #include <mapnik/value_types.hpp>
 
 // std
+#include <cstring>
 #include <stdexcept>
 
 // icu
 #include <unicode/ucnv.h>
+#include <unicode/unistr.h>
+#include <unicode/stringpiece.h>
 
 namespace mapnik {
 
+namespace {
+
+inline bool is_ascii(const char* data, std::int32_t length)
+{
+    for (std::int32_t i = 0; i < length; ++i)
+    {
+        if (static_cast<unsigned char>(data[i]) > 0x7f) return false;
+    }
+    return true;
+}
+
+}
+
 transcoder::transcoder (std::string const& encoding)
-    : conv_(0)
+    : conv_(0),
+      utf8_(false),
+      ascii_(false)
 {
     UErrorCode err = U_ZERO_ERROR;
     conv_ = ucnv_open(encoding.c_str(),&err);
@@ -42,10 +60,31 @@ transcoder::transcoder (std::string const& encoding)
         // NOT: conv_ should be null on error so no need to call ucnv_close
         throw std::runtime_error(std::string("could not create converter for ") + encoding);
     }
+    utf8_ = ucnv_getType(conv_) == UCNV_UTF8;
+    if (!utf8_)
+    {
+        char ascii[128];
+        for (int i = 0; i < 128; ++i) ascii[i] = static_cast<char>(i);
+        mapnik::value_unicode_string ustr(ascii, 128, conv_, err);
+        ascii_ = U_SUCCESS(err) && ustr.length() == 128;
+        for (int i = 0; ascii_ && i < 128; ++i)
+        {
+            ascii_ = ustr.charAt(i) == i;
+        }
+    }
 }
 
 mapnik::value_unicode_string transcoder::transcode(const char* data, std::int32_t length) const
 {
+    if (utf8_ || ascii_)
+    {
+        if (length < 0) length = static_cast<std::int32_t>(std::strlen(data));
+    }
+    if (utf8_ || (ascii_ && is_ascii(data, length)))
+    {
+        return mapnik::value_unicode_string::fromUTF8(U_NAMESPACE_QUALIFIER StringPiece(data, length));
+    }
+
     UErrorCode err = U_ZERO_ERROR;
 
     mapnik::value_unicode_string ustr(data,length,conv_,err);
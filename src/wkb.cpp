@@ -197,8 +197,71 @@ public:
         return geom;
     }
 
+    bool read(mapnik::geometry::flat_geometry<double> & geom)
+    {
+        if (pos_ + 4 > size_) return false;
+        int type = read_integer();
+        // Z and M ordinates are skipped
+        std::size_t dims = 2;
+        if (type > 3000) dims = 4;
+        else if (type > 1000) dims = 3;
+        std::size_t point_size = dims * 8;
+        geom.reserve(geom.num_points() + (size_ - pos_) / point_size);
+        switch (type % 1000)
+        {
+        case wkbPoint:
+            geom.set_type(mapnik::geometry::geometry_types::Point);
+            return read_flat_point(geom, point_size);
+        case wkbLineString:
+            geom.set_type(mapnik::geometry::geometry_types::LineString);
+            return read_flat_linestring(geom, point_size);
+        case wkbPolygon:
+            geom.set_type(mapnik::geometry::geometry_types::Polygon);
+            return read_flat_polygon(geom, point_size);
+        case wkbMultiPoint:
+            geom.set_type(mapnik::geometry::geometry_types::MultiPoint);
+            return read_flat_multi(geom, point_size, type - wkbMultiPoint + wkbPoint, &wkb_reader::read_flat_point);
+        case wkbMultiLineString:
+            geom.set_type(mapnik::geometry::geometry_types::MultiLineString);
+            return read_flat_multi(geom, point_size, type - wkbMultiLineString + wkbLineString, &wkb_reader::read_flat_linestring);
+        case wkbMultiPolygon:
+            geom.set_type(mapnik::geometry::geometry_types::MultiPolygon);
+            return read_flat_multi(geom, point_size, type - wkbMultiPolygon + wkbPolygon, &wkb_reader::read_flat_polygon);
+        default:
+            break;
+        }
+        return false;
+    }
+
 private:
 
+    // Each part of a multi geometry or collection carries its own byte
+    // order, which need not match the one of its parent. SpatiaLite
+    // blobs start parts with an entity marker instead.
+    bool read_byte_order()
+    {
+        if (pos_ + 1 > size_) return false;
+        std::uint8_t order = static_cast<std::uint8_t>(wkb_[pos_]);
+        if (format_ == wkbSpatiaLite)
+        {
+            if (order != 0x69) return false;
+            ++pos_;
+            return true;
+        }
+        if (order != wkbXDR && order != wkbNDR) return false;
+        byteOrder_ = static_cast<wkbByteOrder>(order);
+        needSwap_ = byteOrder_ ? wkbXDR : wkbNDR;
+        ++pos_;
+        return true;
+    }
+
+    bool read_part_header(int & type)
+    {
+        if (pos_ + 5 > size_ || !read_byte_order()) return false;
+        type = read_integer();
+        return true;
+    }
+
     int read_integer()
     {
         std::int32_t n;
@@ -261,6 +324,77 @@ private:
         }
     }
 
+    bool read_flat_coords(mapnik::geometry::flat_geometry<double> & geom, std::size_t point_size)
+    {
+        if (pos_ + 4 > size_) return false;
+        std::size_t num_points = static_cast<std::size_t>(read_integer());
+        if (num_points > (size_ - pos_) / point_size) return false;
+        double x,y;
+        for (std::size_t i = 0; i < num_points; ++i)
+        {
+            if (needSwap_)
+            {
+                read_double_xdr(wkb_ + pos_, x);
+                read_double_xdr(wkb_ + pos_ + 8, y);
+            }
+            else
+            {
+                read_double_ndr(wkb_ + pos_, x);
+                read_double_ndr(wkb_ + pos_ + 8, y);
+            }
+            geom.add_coord(x, y);
+            pos_ += point_size;
+        }
+        return true;
+    }
+
+    bool read_flat_point(mapnik::geometry::flat_geometry<double> & geom, std::size_t point_size)
+    {
+        if (pos_ + point_size > size_) return false;
+        geom.begin_part();
+        geom.begin_ring();
+        double x = read_double();
+        double y = read_double();
+        pos_ += point_size - 16;
+        geom.add_coord(x, y);
+        return true;
+    }
+
+    bool read_flat_linestring(mapnik::geometry::flat_geometry<double> & geom, std::size_t point_size)
+    {
+        geom.begin_part();
+        geom.begin_ring();
+        return read_flat_coords(geom, point_size);
+    }
+
+    bool read_flat_polygon(mapnik::geometry::flat_geometry<double> & geom, std::size_t point_size)
+    {
+        if (pos_ + 4 > size_) return false;
+        int num_rings = read_integer();
+        geom.begin_part();
+        for (int i = 0; i < num_rings; ++i)
+        {
+            geom.begin_ring();
+            if (!read_flat_coords(geom, point_size)) return false;
+            geom.close_ring(i == 0);
+        }
+        return true;
+    }
+
+    bool read_flat_multi(mapnik::geometry::flat_geometry<double> & geom, std::size_t point_size, int part_type,
+                         bool (wkb_reader::*read_part)(mapnik::geometry::flat_geometry<double> &, std::size_t))
+    {
+        if (pos_ + 4 > size_) return false;
+        int num_parts = read_integer();
+        for (int i = 0; i < num_parts; ++i)
+        {
+            int type;
+            if (!read_part_header(type) || type != part_type) return false;
+            if (!(this->*read_part)(geom, point_size)) return false;
+        }
+        return true;
+    }
+
     template <bool Z = false, bool M = false>
     mapnik::geometry::point<double> read_point()
     {
@@ -279,7 +413,8 @@ private:
         multi_point.reserve(num_points);
         for (int i = 0; i < num_points; ++i)
         {
-            pos_ += 5;
+            int type;
+            if (!read_part_header(type) || type % 1000 != wkbPoint) break;
             multi_point.emplace_back(read_point<Z,M>());
         }
         return multi_point;
@@ -306,7 +441,8 @@ private:
         multi_line.reserve(num_lines);
         for (int i = 0; i < num_lines; ++i)
         {
-            pos_ += 5;
+            int type;
+            if (!read_part_header(type) || type % 1000 != wkbLineString) break;
             multi_line.push_back(read_linestring<M, Z>());
         }
         return multi_line;
@@ -344,7 +480,8 @@ private:
         mapnik::geometry::multi_polygon<double> multi_poly;
         for (int i = 0; i < num_polys; ++i)
         {
-            pos_ += 5;
+            int type;
+            if (!read_part_header(type) || type % 1000 != wkbPolygon) break;
             multi_poly.push_back(read_polygon<M, Z>());
         }
         return multi_poly;
@@ -356,7 +493,7 @@ private:
         mapnik::geometry::geometry_collection<double> collection;
         for (int i = 0; i < num_geometries; ++i)
         {
-            pos_ += 1; // skip byte order
+            if (!read_byte_order()) break;
             collection.push_back(read());
          }
         return collection;
@@ -415,4 +552,15 @@ mapnik::geometry::geometry<double> geometry_utils::from_wkb(const char* wkb,
     return geom;
 }
 
+bool geometry_utils::from_wkb(const char* wkb,
+                              std::size_t size,
+                              mapnik::geometry::flat_geometry<double> & geom,
+                              wkbFormat format)
+{
+    if (size == 0) return false;
+    wkb_reader reader(wkb, size, format);
+    // polygon rings are corrected while reading
+    return reader.read(geom);
+}
+
 } // namespace mapnik
@@ -0,0 +1,273 @@
+#include "catch.hpp"
+
+#include <mapnik/cache_datasource.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/memory_featureset.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/params.hpp>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// counts the queries reaching the wrapped datasource
+class counting_datasource : public mapnik::memory_datasource
+{
+public:
+    counting_datasource(mapnik::parameters const& params)
+        : mapnik::memory_datasource(params),
+          queries(0) {}
+
+    mapnik::featureset_ptr features(mapnik::query const& q) const
+    {
+        ++queries;
+        return mapnik::memory_datasource::features(q);
+    }
+
+    mutable int queries;
+};
+
+// features with a string of length characters, allocated from a new
+// arena for each query like the featuresets of file plugins
+class arena_datasource : public mapnik::memory_datasource
+{
+public:
+    arena_datasource(mapnik::parameters const& params, std::size_t length)
+        : mapnik::memory_datasource(params),
+          length_(length) {}
+
+    mapnik::featureset_ptr features(mapnik::query const& q) const
+    {
+        auto arena = std::make_shared<mapnik::feature_arena>();
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        ctx->push("name");
+        std::deque<mapnik::feature_ptr> features;
+        for (int i = 0; i < 10; ++i)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1, arena));
+            feature->put("name", mapnik::value_unicode_string(std::string(length_, 'a' + i).c_str()));
+            feature->set_geometry(mapnik::geometry::point<double>(i, i));
+            features.push_back(feature);
+        }
+        return std::make_shared<mapnik::memory_featureset>(std::move(features));
+    }
+
+private:
+    std::size_t length_;
+};
+
+// points along the diagonal, every third feature without a geometry
+class sparse_datasource : public mapnik::memory_datasource
+{
+public:
+    sparse_datasource(mapnik::parameters const& params)
+        : mapnik::memory_datasource(params) {}
+
+    mapnik::featureset_ptr features(mapnik::query const& q) const
+    {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        std::deque<mapnik::feature_ptr> features;
+        for (int i = 0; i < 10; ++i)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1));
+            if (i % 3 != 0) feature->set_geometry(mapnik::geometry::point<double>(i, i));
+            features.push_back(feature);
+        }
+        return std::make_shared<mapnik::memory_featureset>(std::move(features));
+    }
+};
+
+std::shared_ptr<counting_datasource> make_grid(int size)
+{
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<counting_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    mapnik::value_integer id = 0;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, ++id));
+            feature->put("name", id);
+            feature->set_geometry(mapnik::geometry::point<double>(x, y));
+            ds->push(feature);
+        }
+    }
+    return ds;
+}
+
+mapnik::query make_query(mapnik::box2d<double> const& box, double scale_denom = 1000.0)
+{
+    mapnik::query q(box, mapnik::query::resolution_type(1.0, 1.0), scale_denom);
+    q.add_property_name("name");
+    return q;
+}
+
+std::vector<mapnik::value_integer> ids(mapnik::featureset_ptr const& fs)
+{
+    std::vector<mapnik::value_integer> result;
+    mapnik::feature_ptr feature;
+    while (fs && (feature = fs->next()))
+    {
+        result.push_back(feature->id());
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("cache_datasource") {
+
+SECTION("queries within a cached bbox are answered from the cache") {
+    auto ds = make_grid(20);
+    mapnik::cache_datasource cache(ds);
+    mapnik::box2d<double> outer(0, 0, 10, 10);
+    CHECK(ids(cache.features(make_query(outer))) == ids(ds->features(make_query(outer))));
+    CHECK(ds->queries == 2);
+    CHECK(cache.size() > 0);
+
+    mapnik::box2d<double> inner(2.5, 2.5, 5.5, 7);
+    auto cached = ids(cache.features(make_query(inner)));
+    CHECK(ds->queries == 2);
+    CHECK(cached.size() == 15);
+    CHECK(cached == ids(ds->features(make_query(inner))));
+    CHECK(ds->queries == 3);
+
+    // another scale or resolution, even a close one, is another query
+    cache.features(make_query(inner, 1100.0));
+    CHECK(ds->queries == 4);
+    mapnik::query hidpi(inner, mapnik::query::resolution_type(2.0, 2.0), 1000.0);
+    hidpi.add_property_name("name");
+    cache.features(hidpi);
+    CHECK(ds->queries == 5);
+    CHECK(ids(cache.features(make_query(inner, 1100.0))) == cached);
+    CHECK(ds->queries == 5);
+
+    // sticking out of the cached bbox
+    cache.features(make_query(mapnik::box2d<double>(5, 5, 12, 8)));
+    CHECK(ds->queries == 6);
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+    cache.features(make_query(inner));
+    CHECK(ds->queries == 7);
+}
+
+SECTION("features are copied out of arenas and their strings counted") {
+    mapnik::parameters params;
+    params["type"] = "memory";
+    mapnik::box2d<double> box(0, 0, 10, 10);
+    auto short_ds = std::make_shared<arena_datasource>(params, 1);
+    auto long_ds = std::make_shared<arena_datasource>(params, 1000);
+    mapnik::cache_datasource short_cache(short_ds);
+    mapnik::cache_datasource long_cache(long_ds);
+
+    auto fs = long_cache.features(make_query(box));
+    mapnik::value_integer id = 0;
+    mapnik::feature_ptr feature;
+    while (fs && (feature = fs->next()))
+    {
+        CHECK(feature->id() == ++id);
+        CHECK(!feature->in_arena());
+        CHECK(feature->get("name") == mapnik::value_unicode_string(std::string(1000, 'a' + id - 1).c_str()));
+        CHECK(feature->envelope() == mapnik::box2d<double>(id - 1, id - 1, id - 1, id - 1));
+    }
+    CHECK(id == 10);
+
+    short_cache.features(make_query(box));
+    CHECK(long_cache.size() >= short_cache.size() + 10 * 999 * sizeof(UChar));
+}
+
+SECTION("features without a geometry are returned for any part of the bbox") {
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<sparse_datasource>(params);
+    mapnik::cache_datasource cache(ds);
+    mapnik::box2d<double> box(0, 0, 10, 10);
+    std::vector<mapnik::value_integer> all = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    CHECK(ids(cache.features(make_query(box))) == all);
+    CHECK(ids(cache.features(make_query(box))) == all);
+    std::vector<mapnik::value_integer> part = {1, 4, 5, 6, 7, 10};
+    CHECK(ids(cache.features(make_query(mapnik::box2d<double>(3.5, 3.5, 5.5, 5.5)))) == part);
+}
+
+SECTION("queries differing in more than their bbox are not shared") {
+    auto ds = make_grid(10);
+    mapnik::cache_datasource cache(ds);
+    mapnik::box2d<double> box(0, 0, 9, 9);
+    cache.features(make_query(box));
+    CHECK(ds->queries == 1);
+
+    // another zoom level
+    cache.features(make_query(box, 3000.0));
+    CHECK(ds->queries == 2);
+
+    mapnik::query props = make_query(box);
+    props.add_property_name("other");
+    cache.features(props);
+    CHECK(ds->queries == 3);
+
+    mapnik::query vars = make_query(box);
+    mapnik::attributes attrs;
+    attrs["zoom"] = mapnik::value_integer(3);
+    vars.set_variables(attrs);
+    cache.features(vars);
+    CHECK(ds->queries == 4);
+
+    mapnik::query filtered = make_query(box);
+    filtered.add_filter(std::make_shared<mapnik::expr_node>(mapnik::value_integer(1)));
+    cache.features(filtered);
+    CHECK(ds->queries == 5);
+    cache.features(filtered);
+    CHECK(ds->queries == 5);
+    mapnik::query refiltered = make_query(box);
+    refiltered.add_filter(std::make_shared<mapnik::expr_node>(mapnik::value_integer(2)));
+    cache.features(refiltered);
+    CHECK(ds->queries == 6);
+}
+
+SECTION("least recently used results are dropped first") {
+    auto ds = make_grid(20);
+    mapnik::box2d<double> a(0, 0, 4, 4);
+    mapnik::box2d<double> b(10, 10, 14, 14);
+    mapnik::box2d<double> c(0, 10, 4, 14);
+
+    // room for two of the three results
+    mapnik::cache_datasource probe(ds);
+    probe.features(make_query(a));
+    std::size_t entry_size = probe.size();
+    REQUIRE(entry_size > 0);
+    ds->queries = 0;
+
+    mapnik::cache_datasource cache(ds, entry_size * 2 + entry_size / 2);
+    cache.features(make_query(a));
+    cache.features(make_query(b));
+    cache.features(make_query(a));
+    CHECK(ds->queries == 2);
+    cache.features(make_query(c));
+    CHECK(ds->queries == 3);
+    CHECK(cache.size() <= entry_size * 2 + entry_size / 2);
+    // b was used least recently
+    cache.features(make_query(a));
+    CHECK(ds->queries == 3);
+    cache.features(make_query(b));
+    CHECK(ds->queries == 4);
+
+    // results larger than the whole cache are not kept
+    mapnik::cache_datasource tiny(ds, entry_size / 2);
+    tiny.features(make_query(a));
+    tiny.features(make_query(a));
+    CHECK(ds->queries == 6);
+    CHECK(tiny.size() == 0);
+}
+
+}
@@ -0,0 +1,183 @@
+#include "catch.hpp"
+
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_program.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/expression_string.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/rule.hpp>
+#include <vector>
+#include <string>
+
+namespace {
+
+std::vector<mapnik::feature_ptr> make_features()
+{
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("int");
+    ctx->push("double");
+    ctx->push("name");
+    ctx->push("flag");
+    ctx->push("null");
+    mapnik::transcoder tr("utf-8");
+    std::vector<mapnik::feature_ptr> features;
+    std::vector<std::string> names = { "motorway", "trunk", "", "Straße" };
+    for (mapnik::value_integer i = -2; i < 6; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+        feature->put("int", i);
+        feature->put("double", i * 1.5);
+        feature->put("name", tr.transcode(names[static_cast<std::size_t>(i + 2) % names.size()].c_str()));
+        feature->put("flag", i % 2 == 0);
+        feature->set_geometry(mapnik::geometry::point<double>(i, i));
+        features.push_back(feature);
+    }
+    // a feature with values of unexpected types
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 100));
+    feature->put("int", tr.transcode("3"));
+    feature->put("double", mapnik::value_integer(3));
+    feature->put("name", mapnik::value_integer(0));
+    features.push_back(feature);
+    return features;
+}
+
+}
+
+TEST_CASE("expression_program") {
+
+SECTION("same results as the tree evaluator") {
+    std::vector<std::string> exprs = {
+        "true",
+        "false",
+        "null",
+        "1 + 2 * 3",
+        "[int] = 2",
+        "2 = [int]",
+        "[int] != 2",
+        "[int] < 2.5",
+        "2.5 > [int]",
+        "[int] >= 1 and [int] <= 3",
+        "[int] = 1 or [int] = 4 or [int] = -2",
+        "not ([int] = 1)",
+        "[double] = 3",
+        "[double] > [int]",
+        "[name] = 'motorway'",
+        "'trunk' = [name]",
+        "[name] != ''",
+        "'' != [null]",
+        "[null] != ''",
+        "[null] = null",
+        "[name] > 'm'",
+        "[flag]",
+        "[flag] = true",
+        "[int] % 2 = 0",
+        "-[int] < 0",
+        "[int] + [double]",
+        "[name] + '!'",
+        "[int] / 0",
+        "[double] % 2",
+        "[name].match('mo.*')",
+        "[name].replace('o','0')",
+        "pow([int],2) > 4",
+        "abs([int]) = 2",
+        "[mapnik::geometry_type] = point",
+        "[@zoom] > 3",
+        "[@zoom] + [int]",
+        "[missing] = 1",
+        "[int] and [flag]",
+        "[int] or [name]",
+        "([int] > 0) = ([double] > 0)",
+    };
+    mapnik::attributes vars;
+    vars["zoom"] = mapnik::value_integer(4);
+    auto features = make_features();
+    for (auto const& str : exprs)
+    {
+        mapnik::expression_ptr expr = mapnik::parse_expression(str);
+        mapnik::expression_program prog(expr);
+        INFO(str);
+        CHECK(!prog.fallback());
+        for (auto const& feature : features)
+        {
+            mapnik::value expected = mapnik::util::apply_visitor(
+                mapnik::evaluate<mapnik::feature_impl, mapnik::value, mapnik::attributes>(*feature, vars), *expr);
+            mapnik::value actual = prog.evaluate(*feature, vars);
+            INFO(feature->to_string());
+            CHECK(expected.which() == actual.which());
+            CHECK(expected.to_string() == actual.to_string());
+            CHECK(expected.to_bool() == prog.to_bool(*feature, vars));
+        }
+    }
+}
+
+SECTION("slot binding follows the feature context") {
+    mapnik::expression_program prog(mapnik::parse_expression("[b] = 2 or [a] = 1"));
+    mapnik::expression_program::binding slots;
+    mapnik::attributes vars;
+
+    mapnik::context_ptr ctx1 = std::make_shared<mapnik::context_type>();
+    ctx1->push("a");
+    ctx1->push("b");
+    mapnik::feature_ptr f1(mapnik::feature_factory::create(ctx1, 1));
+    f1->put("a", mapnik::value_integer(1));
+    f1->put("b", mapnik::value_integer(0));
+    CHECK(prog.to_bool(*f1, vars, slots));
+    CHECK(slots.ctx == ctx1);
+
+    // same names in other slots
+    mapnik::context_ptr ctx2 = std::make_shared<mapnik::context_type>();
+    ctx2->push("b");
+    ctx2->push("a");
+    mapnik::feature_ptr f2(mapnik::feature_factory::create(ctx2, 2));
+    f2->put("a", mapnik::value_integer(0));
+    f2->put("b", mapnik::value_integer(2));
+    CHECK(prog.to_bool(*f2, vars, slots));
+    CHECK(slots.ctx == ctx2);
+    f2->put("b", mapnik::value_integer(3));
+    CHECK(!prog.to_bool(*f2, vars, slots));
+
+    // missing names read as null until the context grows
+    mapnik::context_ptr ctx3 = std::make_shared<mapnik::context_type>();
+    ctx3->push("b");
+    mapnik::feature_ptr f3(mapnik::feature_factory::create(ctx3, 3));
+    f3->put("b", mapnik::value_integer(0));
+    CHECK(!prog.to_bool(*f3, vars, slots));
+    f3->put_new("a", mapnik::value_integer(1));
+    CHECK(prog.to_bool(*f3, vars, slots));
+    CHECK(prog.evaluate(*f3, vars, slots) == prog.evaluate(*f3, vars));
+}
+
+SECTION("fused comparison") {
+    mapnik::expression_program prog(mapnik::parse_expression("[highway] = 'motorway'"));
+    REQUIRE(prog.code().size() == 1);
+    REQUIRE(prog.code().front().op == mapnik::detail::expr_opcode::compare_attr_const);
+}
+
+SECTION("deep expressions fall back to the tree evaluator") {
+    std::string str = "[int]";
+    for (std::size_t i = 0; i < mapnik::expression_program::max_stack_size + 1; ++i)
+    {
+        str = "1 + (" + str + ")";
+    }
+    mapnik::expression_ptr expr = mapnik::parse_expression(str);
+    mapnik::expression_program prog(expr);
+    REQUIRE(prog.fallback());
+    auto features = make_features();
+    mapnik::attributes vars;
+    mapnik::value actual = prog.evaluate(*features.front(), vars);
+    REQUIRE(actual == mapnik::value_integer(31));
+}
+
+SECTION("rule keeps the program in sync with its filter") {
+    mapnik::rule r;
+    REQUIRE(r.get_filter_program().expression() == r.get_filter());
+    r.set_filter(mapnik::parse_expression("[int] = 1"));
+    REQUIRE(r.get_filter_program().expression() == r.get_filter());
+    mapnik::rule copy(r);
+    REQUIRE(copy.get_filter_program().expression() == copy.get_filter());
+    REQUIRE(copy.get_filter_program().expression() != r.get_filter());
+}
+
+}
@@ -0,0 +1,96 @@
+#include "catch.hpp"
+
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_sql.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/value.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+mapnik::layer_descriptor make_descriptor()
+{
+    mapnik::layer_descriptor desc("test", "utf-8");
+    desc.add_descriptor(mapnik::attribute_descriptor("lanes", mapnik::Integer));
+    desc.add_descriptor(mapnik::attribute_descriptor("width", mapnik::Double));
+    desc.add_descriptor(mapnik::attribute_descriptor("highway", mapnik::String));
+    desc.add_descriptor(mapnik::attribute_descriptor("bridge", mapnik::Boolean));
+    return desc;
+}
+
+std::string translate(std::vector<std::string> const& filters,
+                      mapnik::attributes const& vars = mapnik::attributes(),
+                      mapnik::sql_dialect dialect = mapnik::sql_dialect::standard)
+{
+    mapnik::query q(mapnik::box2d<double>(0, 0, 1, 1));
+    q.set_variables(vars);
+    for (auto const& filter : filters)
+    {
+        q.add_filter(mapnik::parse_expression(filter));
+    }
+    std::string sql;
+    if (!mapnik::to_sql_condition(q, make_descriptor(), sql, dialect)) return "<none>";
+    return sql;
+}
+
+}
+
+TEST_CASE("expression sql") {
+
+SECTION("comparisons with literals") {
+    CHECK(translate({"[lanes] = 2"}) == "\"lanes\" = 2");
+    CHECK(translate({"[width] >= 2.5"}) == "\"width\" >= 2.5");
+    CHECK(translate({"[width] = 0.1"}) == "\"width\" = 0.1");
+    CHECK(translate({"3 < [lanes]"}) == "\"lanes\" > 3");
+    CHECK(translate({"[highway] = 'it''s'"}) == "\"highway\" = 'it''s'");
+    CHECK(translate({"[highway] = null"}) == "\"highway\" IS NULL");
+    // missing values are unequal to anything but the empty string
+    CHECK(translate({"[highway] != 'motorway'"}) == "(\"highway\" <> 'motorway' OR \"highway\" IS NULL)");
+    CHECK(translate({"[highway] != ''"}) == "\"highway\" <> ''");
+    CHECK(translate({"'' != [highway]"}) == "(\"highway\" <> '' OR \"highway\" IS NULL)");
+    CHECK(translate({"null != [highway]"}) == "(\"highway\" IS NOT NULL AND \"highway\" <> '')");
+}
+
+SECTION("negation is pushed down to the comparisons") {
+    CHECK(translate({"not ([lanes] < 2)"}) == "(\"lanes\" >= 2 OR \"lanes\" IS NULL)");
+    CHECK(translate({"not ([lanes] = 1 or [highway] = 'trunk')"})
+          == "((\"lanes\" <> 1 OR \"lanes\" IS NULL) AND (\"highway\" <> 'trunk' OR \"highway\" IS NULL))");
+    CHECK(translate({"not ([lanes] != 1)"}) == "\"lanes\" = 1");
+}
+
+SECTION("rule filters are combined, variables resolved") {
+    mapnik::attributes vars;
+    vars["min_lanes"] = mapnik::value_integer(4);
+    CHECK(translate({"[lanes] >= @min_lanes", "[highway] = 'motorway'"}, vars)
+          == "(\"lanes\" >= 4 OR \"highway\" = 'motorway')");
+    CHECK(translate({"[lanes] >= @unknown"}) == "<none>");
+}
+
+SECTION("string literals are escaped for the dialect") {
+    mapnik::attributes vars;
+    vars["name"] = mapnik::value_unicode_string("it's a\\b");
+    CHECK(translate({"[highway] = @name"}, vars) == "\"highway\" = 'it''s a\\b'");
+    CHECK(translate({"[highway] = @name"}, vars, mapnik::sql_dialect::postgresql)
+          == "\"highway\" = E'it''s a\\\\b'");
+    CHECK(translate({"[highway] = 'x'"}, vars, mapnik::sql_dialect::postgresql) == "\"highway\" = E'x'");
+    vars["name"] = mapnik::value_unicode_string::fromUTF8(std::string("a\0b", 3));
+    CHECK(translate({"[highway] = @name"}, vars) == "<none>");
+}
+
+SECTION("untranslatable parts weaken conjunctions only") {
+    CHECK(translate({"[lanes] = 2 and [name] = 'x'"}) == "\"lanes\" = 2");
+    CHECK(translate({"[highway] = 'trunk' and [mapnik::geometry_type] = linestring"}) == "\"highway\" = 'trunk'");
+    CHECK(translate({"[lanes] = 2 or [name] = 'x'"}) == "<none>");
+    CHECK(translate({"not ([lanes] = 2 and [name] = 'x')"}) == "<none>");
+    CHECK(translate({"[lanes] = 2", "[highway].match('^m')"}) == "<none>");
+    // column types the comparison can't be checked against
+    CHECK(translate({"[lanes] = '2'"}) == "<none>");
+    CHECK(translate({"[highway] < 'm'"}) == "<none>");
+    CHECK(translate({"[bridge] = true"}) == "<none>");
+    CHECK(translate({"[lanes] + 1 = 2"}) == "<none>");
+    CHECK(translate({}) == "<none>");
+}
+
+}
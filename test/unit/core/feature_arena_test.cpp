@@ -0,0 +1,73 @@
+#include "catch.hpp"
+
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <cstdint>
+#include <vector>
+
+TEST_CASE("feature_arena") {
+
+SECTION("allocations are aligned and share blocks") {
+    mapnik::feature_arena arena(1024);
+    std::vector<void*> ptrs;
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        void * ptr = arena.allocate(24, 16);
+        CHECK((reinterpret_cast<std::uintptr_t>(ptr) % 16) == 0);
+        ptrs.push_back(ptr);
+    }
+    CHECK(arena.blocks_allocated() == 1);
+    // large allocations get a block of their own
+    void * large = arena.allocate(4096, 8);
+    CHECK(arena.blocks_allocated() == 2);
+    mapnik::feature_arena::deallocate(large);
+    for (void * ptr : ptrs) mapnik::feature_arena::deallocate(ptr);
+    mapnik::feature_arena::deallocate(nullptr);
+}
+
+SECTION("features allocated from an arena") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    ctx->push("id");
+    mapnik::transcoder tr("utf-8");
+    auto arena = std::make_shared<mapnik::feature_arena>();
+    std::vector<mapnik::feature_ptr> features;
+    for (mapnik::value_integer i = 0; i < 100; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i, arena));
+        feature->put("name", tr.transcode("feature"));
+        feature->put("id", i);
+        feature->put_new("extra", i * 2);
+        features.push_back(feature);
+    }
+    // features outlive the featureset holding the arena
+    arena.reset();
+    for (mapnik::value_integer i = 0; i < 100; ++i)
+    {
+        mapnik::feature_ptr const& feature = features[static_cast<std::size_t>(i)];
+        CHECK(feature->id() == i);
+        CHECK(feature->get("name").to_string() == "feature");
+        CHECK(feature->get("id") == i);
+        CHECK(feature->get("extra") == i * 2);
+    }
+    // get_data() hands out a plain heap copy of the attribute values
+    mapnik::feature_impl::cont_type data(features.front()->get_data());
+    features.clear();
+    REQUIRE(data.size() == 3);
+    CHECK(data[1] == mapnik::value_integer(0));
+
+    mapnik::feature_ptr plain(mapnik::feature_factory::create(ctx, 1, mapnik::feature_arena_ptr()));
+    plain->set_data(data);
+    CHECK(plain->get("name").to_string() == "feature");
+
+    // and feature to feature without one
+    mapnik::feature_ptr other(mapnik::feature_factory::create(ctx, 2, mapnik::feature_arena_ptr()));
+    plain->copy_data_to(*other);
+    CHECK(other->size() == 3);
+    CHECK(other->get("name").to_string() == "feature");
+    CHECK(other->get("extra") == mapnik::value_integer(0));
+}
+
+}
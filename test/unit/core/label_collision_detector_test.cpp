@@ -0,0 +1,108 @@
+#include "catch.hpp"
+
+#include <mapnik/label_collision_detector.hpp>
+#include <mapnik/unicode.hpp>
+
+#include <random>
+#include <vector>
+
+TEST_CASE("label_collision_detector4") {
+
+SECTION("same answers as a linear scan") {
+    mapnik::box2d<double> extent(-128, -128, 1152, 1152);
+    mapnik::label_collision_detector4 detector(extent, 32);
+    std::vector<mapnik::box2d<double> > placed;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> pos(-200, 1200);
+    std::uniform_real_distribution<double> size(1, 120);
+    std::size_t rejected = 0;
+    for (std::size_t i = 0; i < 2000; ++i)
+    {
+        double x = pos(gen);
+        double y = pos(gen);
+        mapnik::box2d<double> box(x, y, x + size(gen), y + size(gen) / 4);
+        // queries outside the extent find nothing, as with the quad tree
+        bool expected = true;
+        for (auto const& other : placed)
+        {
+            if (extent.intersects(box) && other.intersects(box)) expected = false;
+        }
+        REQUIRE(detector.has_placement(box) == expected);
+        if (expected && extent.intersects(box))
+        {
+            detector.insert(box);
+            placed.push_back(box);
+        }
+        else if (!expected)
+        {
+            ++rejected;
+        }
+    }
+    REQUIRE(rejected > 0);
+    REQUIRE(detector.size() == placed.size());
+    std::size_t count = 0;
+    for (auto const& label : detector)
+    {
+        REQUIRE(label.box == placed[count++]);
+    }
+}
+
+SECTION("margin and repeat distance") {
+    mapnik::label_collision_detector4 detector(mapnik::box2d<double>(0, 0, 256, 256));
+    mapnik::transcoder tr("utf-8");
+    mapnik::value_unicode_string main_street = tr.transcode("Main Street");
+    detector.insert(mapnik::box2d<double>(100, 100, 140, 110), main_street);
+
+    mapnik::box2d<double> nearby(150, 100, 190, 110);
+    CHECK(detector.has_placement(nearby));
+    CHECK(detector.has_placement(nearby, 5));
+    CHECK(!detector.has_placement(nearby, 15));
+    CHECK(!detector.has_placement(nearby, 0, main_street, 50));
+    CHECK(detector.has_placement(nearby, 0, tr.transcode("High Street"), 50));
+    CHECK(detector.has_placement(mapnik::box2d<double>(230, 230, 250, 250), 0, main_street, 50));
+    CHECK(mapnik::label_collision_detector4::repeat_key(main_street) != 0);
+    CHECK(mapnik::label_collision_detector4::repeat_key(mapnik::value_unicode_string()) == 0);
+}
+
+SECTION("labels outside the extent are ignored") {
+    mapnik::label_collision_detector4 detector(mapnik::box2d<double>(0, 0, 256, 256));
+    detector.insert(mapnik::box2d<double>(300, 300, 310, 310));
+    REQUIRE(detector.size() == 0);
+    // partly outside
+    detector.insert(mapnik::box2d<double>(250, 250, 300, 300));
+    REQUIRE(detector.size() == 1);
+    REQUIRE(!detector.has_placement(mapnik::box2d<double>(255, 255, 290, 290)));
+    REQUIRE(detector.has_placement(mapnik::box2d<double>(-20, -20, -10, -10)));
+}
+
+SECTION("reuse") {
+    mapnik::label_collision_detector4 detector(mapnik::box2d<double>(0, 0, 256, 256));
+    mapnik::box2d<double> box(10, 10, 20, 20);
+    detector.insert(box);
+    REQUIRE(!detector.has_placement(box));
+    detector.clear();
+    REQUIRE(detector.size() == 0);
+    REQUIRE(detector.has_placement(box));
+    detector.insert(box);
+    detector.reset(mapnik::box2d<double>(0, 0, 2048, 2048));
+    REQUIRE(detector.extent() == mapnik::box2d<double>(0, 0, 2048, 2048));
+    REQUIRE(detector.has_placement(box));
+    detector.insert(mapnik::box2d<double>(1000, 1000, 1100, 1010));
+    REQUIRE(!detector.has_placement(mapnik::box2d<double>(1050, 1005, 1060, 1020)));
+}
+
+SECTION("cell size is recomputed on reset") {
+    mapnik::label_collision_detector4 detector(mapnik::box2d<double>(0, 0, 256, 256), 32.0);
+    REQUIRE(detector.cell_size() == 32.0);
+    // too many cells at the configured size
+    detector.reset(mapnik::box2d<double>(0, 0, 1e6, 1e6));
+    REQUIRE(detector.cell_size() > 32.0);
+    detector.reset(mapnik::box2d<double>(0, 0, 256, 256));
+    REQUIRE(detector.cell_size() == 32.0);
+    mapnik::box2d<double> box(10, 10, 20, 20);
+    detector.insert(box);
+    REQUIRE(!detector.has_placement(box));
+    REQUIRE(detector.has_placement(mapnik::box2d<double>(40, 40, 50, 50)));
+}
+
+}
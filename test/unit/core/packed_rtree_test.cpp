@@ -0,0 +1,159 @@
+#include "catch.hpp"
+
+#include <mapnik/packed_rtree.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/params.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<mapnik::packed_rtree<std::size_t>::item_type> make_items(std::size_t count)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> pos(-1000, 1000);
+    std::uniform_real_distribution<double> size(0, 20);
+    std::vector<mapnik::packed_rtree<std::size_t>::item_type> items;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double x = pos(gen);
+        double y = pos(gen);
+        items.emplace_back(mapnik::box2d<double>(x, y, x + size(gen), y + size(gen)), i);
+    }
+    return items;
+}
+
+std::vector<std::size_t> brute_force(std::vector<mapnik::packed_rtree<std::size_t>::item_type> const& items,
+                                     mapnik::box2d<double> const& box)
+{
+    std::vector<std::size_t> result;
+    for (auto const& item : items)
+    {
+        if (box.intersects(item.first)) result.push_back(item.second);
+    }
+    return result;
+}
+
+std::vector<std::size_t> query(mapnik::packed_rtree<std::size_t> const& tree, mapnik::box2d<double> const& box)
+{
+    std::vector<std::size_t> result;
+    tree.query(box, [&result](std::size_t i) { result.push_back(i); return true; });
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+}
+
+TEST_CASE("packed_rtree") {
+
+SECTION("empty and single item trees") {
+    mapnik::packed_rtree<std::size_t> empty;
+    REQUIRE(empty.empty());
+    REQUIRE(query(empty, mapnik::box2d<double>(-1, -1, 1, 1)).empty());
+
+    std::vector<mapnik::packed_rtree<std::size_t>::item_type> items;
+    items.emplace_back(mapnik::box2d<double>(0, 0, 1, 1), 7);
+    mapnik::packed_rtree<std::size_t> single(items);
+    REQUIRE(single.size() == 1);
+    REQUIRE(single.extent() == mapnik::box2d<double>(0, 0, 1, 1));
+    REQUIRE(query(single, mapnik::box2d<double>(1, 1, 2, 2)) == std::vector<std::size_t>{7});
+    REQUIRE(query(single, mapnik::box2d<double>(2, 2, 3, 3)).empty());
+}
+
+SECTION("same results as a linear scan") {
+    auto items = make_items(5000);
+    for (std::size_t node_size : { 2, 4, 16, 64 })
+    {
+        mapnik::packed_rtree<std::size_t> tree(items, node_size);
+        REQUIRE(tree.size() == items.size());
+        REQUIRE(tree.level_bounds().back() == tree.boxes().size());
+        std::mt19937 gen(node_size);
+        std::uniform_real_distribution<double> pos(-1100, 1100);
+        std::uniform_real_distribution<double> size(0, 300);
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            double x = pos(gen);
+            double y = pos(gen);
+            mapnik::box2d<double> box(x, y, x + size(gen), y + size(gen));
+            REQUIRE(query(tree, box) == brute_force(items, box));
+        }
+    }
+}
+
+SECTION("visitor stops the query") {
+    auto items = make_items(1000);
+    mapnik::packed_rtree<std::size_t> tree(items);
+    std::size_t visited = 0;
+    REQUIRE(!tree.query(tree.extent(), [&visited](std::size_t) { return ++visited < 10; }));
+    REQUIRE(visited == 10);
+    REQUIRE(tree.query(tree.extent(), [](std::size_t) { return true; }));
+}
+
+SECTION("concurrent queries") {
+    auto items = make_items(10000);
+    mapnik::packed_rtree<std::size_t> tree(items);
+    std::atomic<std::size_t> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 50; ++i)
+            {
+                double x = -1000 + (t * 50 + i) * 8;
+                mapnik::box2d<double> box(x, x, x + 100, x + 100);
+                if (query(tree, box) != brute_force(items, box)) ++failures;
+            }
+        });
+    }
+    for (auto & thread : threads) thread.join();
+    REQUIRE(failures == 0);
+}
+
+SECTION("memory_datasource queries through the index") {
+    mapnik::parameters params;
+    params["type"] = "memory";
+    mapnik::memory_datasource ds(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    auto items = make_items(mapnik::memory_datasource::min_indexed_features * 4);
+    for (auto const& item : items)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, static_cast<mapnik::value_integer>(item.second)));
+        feature->set_geometry(mapnik::geometry::point<double>(item.first.minx(), item.first.miny()));
+        ds.push(feature);
+    }
+    mapnik::box2d<double> box(-500, -500, 500, 500);
+    std::vector<mapnik::value_integer> expected;
+    for (auto const& item : items)
+    {
+        if (box.intersects(item.first.minx(), item.first.miny()))
+        {
+            expected.push_back(static_cast<mapnik::value_integer>(item.second));
+        }
+    }
+    REQUIRE(!expected.empty());
+    std::vector<mapnik::value_integer> ids;
+    mapnik::featureset_ptr fs = ds.features(mapnik::query(box));
+    while (mapnik::feature_ptr feature = fs->next())
+    {
+        ids.push_back(feature->id());
+    }
+    REQUIRE(ids == expected);
+
+    // features pushed later show up
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 100000));
+    feature->set_geometry(mapnik::geometry::point<double>(0, 0));
+    ds.push(feature);
+    fs = ds.features(mapnik::query(box));
+    std::size_t count = 0;
+    while (fs->next()) ++count;
+    REQUIRE(count == expected.size() + 1);
+}
+
+}
@@ -0,0 +1,186 @@
+#include "catch.hpp"
+
+#include <mapnik/featureset_prefetch.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/color.hpp>
+#include <stdexcept>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+mapnik::Map make_map(std::size_t num_layers)
+{
+    mapnik::Map m(256, 256);
+    mapnik::feature_type_style style;
+    {
+        mapnik::rule r;
+        r.set_filter(mapnik::parse_expression("[value] % 2 = 0"));
+        mapnik::polygon_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+        r.append(std::move(sym));
+        style.add_rule(std::move(r));
+    }
+    {
+        mapnik::rule r;
+        r.set_else(true);
+        mapnik::polygon_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::fill, mapnik::color(0, 0, 255));
+        mapnik::put(sym, mapnik::keys::fill_opacity, 0.5);
+        r.append(std::move(sym));
+        style.add_rule(std::move(r));
+    }
+    m.insert_style("style", std::move(style));
+
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("value");
+    for (std::size_t i = 0; i < num_layers; ++i)
+    {
+        mapnik::parameters params;
+        params["type"] = "memory";
+        auto ds = std::make_shared<mapnik::memory_datasource>(params);
+        for (std::size_t j = 0; j < 10; ++j)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i * 10 + j));
+            feature->put("value", static_cast<mapnik::value_integer>(i + j));
+            double x = static_cast<double>(j * 20 + i);
+            double y = static_cast<double>(i * 20 + j);
+            mapnik::geometry::linear_ring<double> ring;
+            ring.add_coord(x, y);
+            ring.add_coord(x + 40, y);
+            ring.add_coord(x + 40, y + 40);
+            ring.add_coord(x, y + 40);
+            ring.add_coord(x, y);
+            mapnik::geometry::polygon<double> poly;
+            poly.set_exterior_ring(std::move(ring));
+            feature->set_geometry(std::move(poly));
+            ds->push(feature);
+        }
+        mapnik::layer lyr("layer");
+        lyr.set_datasource(ds);
+        lyr.add_style("style");
+        m.add_layer(lyr);
+    }
+    m.zoom_to_box(mapnik::box2d<double>(0, 0, 256, 256));
+    return m;
+}
+
+}
+
+TEST_CASE("prefetch") {
+
+SECTION("featureset") {
+    mapnik::prefetch_pool pool(2);
+    REQUIRE(pool.size() == 2);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    auto features = std::make_shared<mapnik::prefetch_featureset>(8);
+    mapnik::prefetch_queue_ptr target = features->queue();
+    pool.post([ctx, target]() {
+        for (mapnik::value_integer i = 0; i < 100; ++i)
+        {
+            if (!target->push(mapnik::feature_factory::create(ctx, i))) return;
+        }
+        target->done();
+    });
+    mapnik::value_integer count = 0;
+    mapnik::feature_ptr feature;
+    while ((feature = features->next()))
+    {
+        CHECK(feature->id() == count);
+        ++count;
+    }
+    REQUIRE(count == 100);
+    REQUIRE(!features->next());
+}
+
+SECTION("error") {
+    mapnik::prefetch_pool pool(1);
+    auto features = std::make_shared<mapnik::prefetch_featureset>();
+    mapnik::prefetch_queue_ptr target = features->queue();
+    pool.post([target]() {
+        target->done(std::make_exception_ptr(std::runtime_error("query failed")));
+    });
+    REQUIRE_THROWS(features->next());
+}
+
+SECTION("query time") {
+    mapnik::prefetch_pool pool(1);
+    auto features = std::make_shared<mapnik::prefetch_featureset>();
+    mapnik::prefetch_queue_ptr target = features->queue();
+    pool.post([target]() {
+        target->add_query_time(1.5);
+        target->add_query_time(2.0);
+        target->done();
+    });
+    REQUIRE(!features->next());
+    CHECK(features->queue()->query_time() == 3.5);
+}
+
+#ifdef MAPNIK_THREADSAFE
+SECTION("bounded") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    auto features = std::make_shared<mapnik::prefetch_featureset>(4);
+    mapnik::prefetch_queue_ptr target = features->queue();
+    std::atomic<int> pushed(0);
+    bool stopped = false;
+    {
+        mapnik::prefetch_pool pool(1);
+        pool.post([ctx, target, &pushed, &stopped]() {
+            for (mapnik::value_integer i = 0; i < 100; ++i)
+            {
+                if (!target->push(mapnik::feature_factory::create(ctx, i)))
+                {
+                    stopped = true;
+                    return;
+                }
+                ++pushed;
+            }
+            target->done();
+        });
+        // the producer stalls once the queue holds `capacity` features
+        while (pushed < 4) std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(pushed == 4);
+        REQUIRE(features->next()->id() == 0);
+        while (pushed < 5) std::this_thread::yield();
+        // dropping the featureset releases the blocked producer
+        features.reset();
+        REQUIRE(target->closed());
+    }
+    CHECK(stopped);
+    CHECK(pushed < 100);
+}
+#endif
+
+SECTION("render") {
+    mapnik::Map m = make_map(8);
+    mapnik::image_rgba8 expected(m.width(), m.height());
+    {
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(m, expected);
+        ren.apply();
+    }
+    REQUIRE(expected.painted());
+    mapnik::image_rgba8 actual(m.width(), m.height());
+    {
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(m, actual);
+        ren.set_prefetch_threads(3);
+        REQUIRE(ren.prefetch_threads() == 3);
+        ren.apply();
+    }
+    REQUIRE(actual.painted());
+    REQUIRE(actual == expected);
+}
+
+}
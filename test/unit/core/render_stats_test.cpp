@@ -0,0 +1,98 @@
+#include "catch.hpp"
+
+#include <mapnik/render_stats.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/color.hpp>
+#include <memory>
+
+TEST_CASE("render_stats") {
+
+SECTION("agg renderer") {
+    mapnik::Map m(256, 256);
+    mapnik::feature_type_style style;
+    {
+        mapnik::rule r;
+        r.set_filter(mapnik::parse_expression("[value] = 1"));
+        mapnik::polygon_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+        r.append(std::move(sym));
+        style.add_rule(std::move(r));
+    }
+    {
+        mapnik::rule r;
+        r.set_filter(mapnik::parse_expression("[value] = 2"));
+        mapnik::line_symbolizer sym;
+        r.append(std::move(sym));
+        style.add_rule(std::move(r));
+    }
+    m.insert_style("style", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("value");
+    for (mapnik::value_integer i = 0; i < 4; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+        feature->put("value", i);
+        mapnik::geometry::linear_ring<double> ring;
+        ring.add_coord(i * 10, 0);
+        ring.add_coord(i * 10 + 5, 0);
+        ring.add_coord(i * 10 + 5, 5);
+        ring.add_coord(i * 10, 5);
+        ring.add_coord(i * 10, 0);
+        mapnik::geometry::polygon<double> poly;
+        poly.set_exterior_ring(std::move(ring));
+        feature->set_geometry(std::move(poly));
+        ds->push(feature);
+    }
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("style");
+    m.add_layer(lyr);
+    m.zoom_all();
+
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 image(m.width(), m.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(m, image);
+    ren.set_stats(&stats);
+    REQUIRE(ren.stats() == &stats);
+    ren.apply();
+
+    REQUIRE(stats.layers.size() == 1);
+    mapnik::layer_stats const& layer = stats.layers.front();
+    CHECK(layer.name == "layer");
+    CHECK(layer.render_time >= 0.0);
+    REQUIRE(layer.styles.size() == 1);
+    mapnik::style_stats const& s = layer.styles.front();
+    CHECK(s.name == "style");
+    CHECK(s.features_fetched == 4);
+    CHECK(s.filters_evaluated == 8);
+    CHECK(s.features_painted == 2);
+    CHECK(s.symbolizer_times.count("PolygonSymbolizer") == 1);
+    CHECK(s.symbolizer_times.count("LineSymbolizer") == 1);
+    CHECK(s.render_time >= s.compositing_time);
+
+    std::string json = mapnik::to_json(stats);
+    CHECK(json.find("\"name\":\"layer\"") != std::string::npos);
+    CHECK(json.find("\"features_painted\":2") != std::string::npos);
+
+    // another apply appends
+    ren.apply();
+    CHECK(stats.layers.size() == 2);
+    stats.clear();
+    CHECK(stats.layers.empty());
+}
+
+}
@@ -0,0 +1,120 @@
+#include "catch.hpp"
+
+#include <mapnik/rule_cache.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <vector>
+#include <string>
+
+namespace {
+
+std::vector<mapnik::rule> make_rules(std::vector<std::string> const& filters)
+{
+    std::vector<mapnik::rule> rules;
+    for (auto const& filter : filters)
+    {
+        mapnik::rule r;
+        r.set_filter(mapnik::parse_expression(filter));
+        rules.push_back(std::move(r));
+    }
+    return rules;
+}
+
+}
+
+TEST_CASE("rule_cache") {
+
+SECTION("equality index") {
+    std::vector<mapnik::rule> rules = make_rules({
+        "[highway] = 'motorway'",
+        "'trunk' = [highway]",
+        "[highway] = 'primary' and [tunnel] = 1",
+        "[lanes] > 2",
+        "[highway] = 3",
+        "[highway] = 'motorway' and [bridge] = true",
+    });
+    mapnik::rule else_rule;
+    else_rule.set_else(true);
+    mapnik::rule_cache rc;
+    for (auto const& r : rules) rc.add_rule(r);
+    rc.add_rule(else_rule);
+    rc.build_index();
+    REQUIRE(rc.index_key() == "highway");
+    REQUIRE(rc.get_if_rules().size() == rules.size());
+    REQUIRE(rc.get_else_rules().size() == 1);
+
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("highway");
+    ctx->push("tunnel");
+    ctx->push("bridge");
+    ctx->push("lanes");
+    mapnik::transcoder tr("utf-8");
+    std::vector<mapnik::value> highways = {
+        tr.transcode("motorway"), tr.transcode("trunk"), tr.transcode("primary"),
+        tr.transcode("residential"), mapnik::value_integer(3), mapnik::value_double(3.0),
+        mapnik::value_bool(true), mapnik::value_null()
+    };
+    mapnik::attributes vars;
+    mapnik::value_integer id = 0;
+    for (auto const& highway : highways)
+    {
+        for (mapnik::value_integer lanes = 1; lanes < 4; lanes += 2)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, ++id));
+            feature->put("highway", highway);
+            feature->put("tunnel", mapnik::value_integer(1));
+            feature->put("bridge", true);
+            feature->put("lanes", lanes);
+            std::vector<std::size_t> expected;
+            for (std::size_t i = 0; i < rc.get_if_rules().size(); ++i)
+            {
+                if (rc.get_if_rules()[i]->get_filter_program().to_bool(*feature, vars))
+                {
+                    expected.push_back(i);
+                }
+            }
+            std::vector<std::size_t> actual;
+            std::size_t last = 0;
+            for (std::size_t i : rc.candidates(*feature))
+            {
+                // candidates stay in rule order
+                if (!actual.empty()) CHECK(i > last);
+                last = i;
+                if (rc.get_if_rules()[i]->get_filter_program().to_bool(*feature, vars))
+                {
+                    actual.push_back(i);
+                }
+            }
+            INFO(feature->to_string());
+            CHECK(expected == actual);
+        }
+    }
+
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, ++id));
+    feature->put("highway", tr.transcode("residential"));
+    CHECK(rc.candidates(*feature) == std::vector<std::size_t>({3}));
+    feature->put("highway", tr.transcode("motorway"));
+    CHECK(rc.candidates(*feature) == std::vector<std::size_t>({0, 3, 5}));
+    feature->put("highway", mapnik::value_integer(3));
+    CHECK(rc.candidates(*feature) == std::vector<std::size_t>({3, 4}));
+}
+
+SECTION("no index for few keyed rules") {
+    std::vector<mapnik::rule> rules = make_rules({
+        "[highway] = 'motorway'",
+        "[highway] = 'trunk'",
+        "[lanes] > 2",
+    });
+    mapnik::rule_cache rc;
+    for (auto const& r : rules) rc.add_rule(r);
+    rc.build_index();
+    CHECK(rc.index_key().empty());
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    CHECK(rc.candidates(*feature) == std::vector<std::size_t>({0, 1, 2}));
+}
+
+}
@@ -0,0 +1,56 @@
+#include "catch.hpp"
+
+#include <mapnik/string_pool.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/value.hpp>
+#include <string>
+
+TEST_CASE("string_pool") {
+
+SECTION("utf-8 transcoding") {
+    mapnik::transcoder utf8("utf-8");
+    mapnik::transcoder latin1("ISO-8859-1");
+    mapnik::value_unicode_string ustr = utf8.transcode("Stra\xc3\x9f" "e");
+    CHECK(ustr.length() == 6);
+    CHECK(ustr == latin1.transcode("Stra\xdf" "e"));
+    CHECK(utf8.transcode("abcdef", 3) == utf8.transcode("abc"));
+    CHECK(utf8.transcode("").isEmpty());
+    // invalid sequences are replaced rather than dropped
+    CHECK(!utf8.transcode("a\xff" "b").isEmpty());
+}
+
+SECTION("ascii input skips the converter") {
+    mapnik::transcoder latin1("ISO-8859-1");
+    CHECK(latin1.transcode("plain text").length() == 10);
+    mapnik::value_unicode_string ustr = latin1.transcode("caf\xe9");
+    REQUIRE(ustr.length() == 4);
+    CHECK(ustr.charAt(3) == 0xe9);
+    mapnik::transcoder utf16("UTF-16LE");
+    CHECK(utf16.transcode("a\0b\0", 4).length() == 2);
+}
+
+SECTION("interning") {
+    mapnik::transcoder tr("utf-8");
+    mapnik::string_pool pool(tr, 2);
+    std::string name(64, 'x');
+    mapnik::value_unicode_string a = pool.intern(name.c_str());
+    mapnik::value_unicode_string b = pool.intern(name.data(), static_cast<std::int32_t>(name.size()));
+    // long strings share one buffer between interned copies
+    CHECK(a.getBuffer() == b.getBuffer());
+    CHECK(a == tr.transcode(name.c_str()));
+    CHECK(pool.size() == 1);
+    CHECK(pool.intern("trunk") == tr.transcode("trunk"));
+    CHECK(pool.size() == 2);
+    // full pool still transcodes, and the result outlives later calls
+    mapnik::value_unicode_string primary = pool.intern("primary");
+    mapnik::value_unicode_string secondary = pool.intern("secondary");
+    CHECK(primary == tr.transcode("primary"));
+    CHECK(secondary == tr.transcode("secondary"));
+    CHECK(pool.size() == 2);
+    CHECK(pool.intern(name.c_str()).getBuffer() == a.getBuffer());
+    // keys are not required to be null terminated
+    CHECK(pool.intern("trunk_link", 5) == tr.transcode("trunk"));
+    CHECK(pool.size() == 2);
+}
+
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#include "catch.hpp"
+
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// schema, extent and every feature of the datasource in reading order
+std::string describe(mapnik::datasource_ptr const& ds)
+{
+    std::ostringstream s;
+    mapnik::query query(ds->envelope());
+    mapnik::layer_descriptor layer = ds->get_descriptor();
+    for (auto const& desc : layer.get_descriptors())
+    {
+        s << desc.get_name() << ":" << desc.get_type() << "\n";
+        query.add_property_name(desc.get_name());
+    }
+    s << ds->envelope() << "\n";
+    auto features = ds->features(query);
+    while (features)
+    {
+        auto feature = features->next();
+        if (!feature) break;
+        s << feature->id() << " " << feature->to_string() << "\n";
+    }
+    return s.str();
+}
+
+}
+
+TEST_CASE("csv") {
+
+    std::string csv_plugin("./plugins/input/csv.input");
+    if (mapnik::util::exists(csv_plugin))
+    {
+        SECTION("parse threads do not change the features read")
+        {
+            boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                boost::filesystem::unique_path("mapnik-csv-%%%%-%%%%");
+            boost::filesystem::create_directories(dir);
+            std::string filename = (dir / "points.csv").string();
+            {
+                // several chunks of rows, with blank lines in between
+                std::ofstream out(filename.c_str());
+                out << "x,y,name,value\n";
+                for (int i = 0; i < 100000; ++i)
+                {
+                    if (i % 1000 == 0) out << "\n";
+                    out << i % 360 - 180 << "," << i % 180 - 90 << ",name" << i << "," << i + 0.25 << "\n";
+                }
+            }
+
+            std::string expected;
+            for (mapnik::value_integer threads : { 1, 2, 4 })
+            {
+                mapnik::parameters params;
+                params["type"] = std::string("csv");
+                params["file"] = filename;
+                params["filesize_max"] = 0.0;
+                params["parse_threads"] = threads;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                std::string result = describe(ds);
+                if (threads == 1) expected = result;
+                else CHECK(result == expected);
+            }
+            CHECK(expected.size() > 100000);
+            boost::filesystem::remove_all(dir);
+        }
+    }
+}
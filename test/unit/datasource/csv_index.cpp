@@ -0,0 +1,144 @@
+#include "catch.hpp"
+
+#include <mapnik/packed_rtree.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/util/fs.hpp>
+#include "../../../plugins/input/csv/csv_index.hpp"
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// three rows from (offset, offset), named prefix0 to prefix2
+void write_rows(std::string const& filename, std::string const& prefix, int offset)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::trunc);
+    out << "x,y,name\n";
+    for (int i = 0; i < 3; ++i)
+    {
+        out << i + offset << "," << i + offset << "," << prefix << i << "\n";
+    }
+}
+
+std::string read_names(mapnik::datasource_ptr const& ds)
+{
+    mapnik::query query(ds->envelope());
+    query.add_property_name("name");
+    auto features = ds->features(query);
+    std::string names;
+    if (!features) return names;
+    while (auto feature = features->next())
+    {
+        names += feature->get("name").to_string();
+    }
+    return names;
+}
+
+}
+
+TEST_CASE("csv index") {
+
+    std::vector<std::pair<mapnik::box2d<double>, csv_index::row_type> > rows;
+    mapnik::box2d<double> extent(0, 0, 99, 9);
+    for (std::uint64_t i = 0; i < 100; ++i)
+    {
+        double x = static_cast<double>(i);
+        double y = static_cast<double>(i % 10);
+        rows.emplace_back(mapnik::box2d<double>(x, y, x, y), csv_index::row_type(i * 20 + 8, i + 1));
+    }
+    std::vector<mapnik::attribute_descriptor> schema;
+    schema.emplace_back("name", mapnik::String);
+    std::ostringstream out;
+    csv_index::write(out, mapnik::packed_rtree<csv_index::row_type>(rows), extent, schema, 2008, 1234, 99, 42);
+    std::string data = out.str();
+
+SECTION("index is tied to the options the file was read with") {
+    csv_index index(data.data(), data.size());
+    REQUIRE(index.valid());
+    CHECK(index.matches(2008, 1234, 99, 42));
+    CHECK(!index.matches(2008, 1234, 99, 43));
+    CHECK(!index.matches(2008, 1234, 99));
+    CHECK(!index.matches(2008, 1234, 98, 42));
+    CHECK(index.schema().size() == 1);
+}
+
+SECTION("rows are found by point") {
+    csv_index index(data.data(), data.size());
+    std::vector<csv_index::row_type> result;
+    CHECK(index.query(mapnik::box2d<double>(9.5, 0, 11.5, 2), [&result](mapnik::box2d<double> const&, std::uint64_t offset, std::uint64_t id)
+                      {
+                          result.emplace_back(offset, id);
+                          return true;
+                      }));
+    std::sort(result.begin(), result.end());
+    REQUIRE(result.size() == 2);
+    CHECK(result[0] == csv_index::row_type(208, 11));
+    CHECK(result[1] == csv_index::row_type(228, 12));
+}
+
+SECTION("sidecar index is written, reused and rebuilt once the file changed") {
+    if (mapnik::util::exists("./plugins/input/csv.input"))
+    {
+        boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("mapnik-csv-%%%%-%%%%");
+        boost::filesystem::create_directories(dir);
+        std::string filename = (dir / "points.csv").string();
+        std::string index_file = filename + ".index";
+        write_rows(filename, "a", 1);
+        std::time_t mtime = boost::filesystem::last_write_time(filename);
+
+        mapnik::parameters params;
+        params["type"] = "csv";
+        params["file"] = filename;
+        params["cache_features"] = false;
+        {
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(bool(ds));
+            REQUIRE(mapnik::util::exists(index_file));
+            CHECK(ds->envelope() == mapnik::box2d<double>(1, 1, 3, 3));
+            CHECK(read_names(ds) == "a0a1a2");
+        }
+
+        // a current index is used as it is
+        std::time_t written = mtime - 3600;
+        boost::filesystem::last_write_time(index_file, written);
+        {
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(bool(ds));
+            CHECK(boost::filesystem::last_write_time(index_file) == written);
+            CHECK(ds->envelope() == mapnik::box2d<double>(1, 1, 3, 3));
+            CHECK(read_names(ds) == "a0a1a2");
+        }
+
+        // other contents with the same size and modification time
+        std::uintmax_t size = mapnik::util::file_size(filename);
+        write_rows(filename, "b", 2);
+        boost::filesystem::last_write_time(filename, mtime);
+        REQUIRE(mapnik::util::file_size(filename) == size);
+        {
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(bool(ds));
+            CHECK(boost::filesystem::last_write_time(index_file) != written);
+            CHECK(ds->envelope() == mapnik::box2d<double>(2, 2, 4, 4));
+            CHECK(read_names(ds) == "b0b1b2");
+        }
+
+        boost::filesystem::remove_all(dir);
+    }
+}
+
+SECTION("geojson indexes are not mistaken for csv ones") {
+    std::string other(data);
+    other[7] = 'g';
+    CHECK(!csv_index(other.data(), other.size()).valid());
+}
+
+}
@@ -28,6 +28,64 @@
 #include <mapnik/geometry.hpp>
 #include <mapnik/util/fs.hpp>
 
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// three points from (offset, offset), named prefix0 to prefix2
+void write_points(std::string const& filename, std::string const& prefix, int offset)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::trunc);
+    out << "{\"type\":\"FeatureCollection\",\"features\":[";
+    for (int i = 0; i < 3; ++i)
+    {
+        if (i > 0) out << ",";
+        out << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":["
+            << i + offset << "," << i + offset << "]},\"properties\":{\"name\":\"" << prefix << i << "\"}}";
+    }
+    out << "]}";
+}
+
+// ids, attributes and envelopes of every feature and the extent
+std::string describe(mapnik::datasource_ptr const& ds)
+{
+    std::ostringstream s;
+    mapnik::query query(ds->envelope());
+    mapnik::layer_descriptor layer = ds->get_descriptor();
+    for (auto const& desc : layer.get_descriptors())
+    {
+        query.add_property_name(desc.get_name());
+    }
+    s << ds->envelope() << "\n";
+    auto features = ds->features(query);
+    while (features)
+    {
+        auto feature = features->next();
+        if (!feature) break;
+        s << feature->id() << " " << feature->envelope() << " " << feature->to_string() << "\n";
+    }
+    return s.str();
+}
+
+std::string read_names(mapnik::datasource_ptr const& ds)
+{
+    mapnik::query query(ds->envelope());
+    query.add_property_name("name");
+    auto features = ds->features(query);
+    std::string names;
+    if (!features) return names;
+    while (auto feature = features->next())
+    {
+        names += feature->get("name").to_string();
+    }
+    return names;
+}
+
+}
+
 TEST_CASE("geojson") {
 
     std::string geojson_plugin("./plugins/input/geojson.input");
@@ -118,5 +176,123 @@ TEST_CASE("geojson") {
             REQUIRE(feature->envelope() == mapnik::box2d<double>(123,456,123,456));
         }
 
+        SECTION("sidecar index is written, reused and rebuilt once the file changed")
+        {
+            boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                boost::filesystem::unique_path("mapnik-geojson-%%%%-%%%%");
+            boost::filesystem::create_directories(dir);
+            std::string filename = (dir / "points.json").string();
+            std::string index_file = filename + ".index";
+            write_points(filename, "a", 1);
+            std::time_t mtime = boost::filesystem::last_write_time(filename);
+
+            mapnik::parameters params;
+            params["type"] = "geojson";
+            params["file"] = filename;
+            params["cache_features"] = false;
+            {
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                REQUIRE(mapnik::util::exists(index_file));
+                CHECK(ds->envelope() == mapnik::box2d<double>(1, 1, 3, 3));
+                CHECK(read_names(ds) == "a0a1a2");
+            }
+
+            // a current index is used as it is
+            std::time_t written = mtime - 3600;
+            boost::filesystem::last_write_time(index_file, written);
+            {
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                CHECK(boost::filesystem::last_write_time(index_file) == written);
+                CHECK(ds->envelope() == mapnik::box2d<double>(1, 1, 3, 3));
+                CHECK(ds->get_descriptor().get_descriptors().size() == 1);
+                CHECK(read_names(ds) == "a0a1a2");
+            }
+
+            // other contents with the same size and modification time
+            std::uintmax_t size = mapnik::util::file_size(filename);
+            write_points(filename, "b", 2);
+            boost::filesystem::last_write_time(filename, mtime);
+            REQUIRE(mapnik::util::file_size(filename) == size);
+            {
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                CHECK(boost::filesystem::last_write_time(index_file) != written);
+                CHECK(ds->envelope() == mapnik::box2d<double>(2, 2, 4, 4));
+                CHECK(read_names(ds) == "b0b1b2");
+            }
+            boost::filesystem::remove_all(dir);
+        }
+
+        SECTION("collections parsed in parallel give the features of a sequential parse")
+        {
+            boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                boost::filesystem::unique_path("mapnik-geojson-%%%%-%%%%");
+            boost::filesystem::create_directories(dir);
+            std::string filename = (dir / "points.json").string();
+            {
+                // enough features to be split in several ranges
+                std::ofstream out(filename.c_str());
+                out << "{\"type\":\"FeatureCollection\",\"features\":[";
+                for (int i = 0; i < 30000; ++i)
+                {
+                    if (i > 0) out << ",\n";
+                    out << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":["
+                        << i % 360 - 180 << "," << i % 180 - 90 << "]},\"properties\":{\"name\":\"name"
+                        << i << "\",\"value\":" << i + 0.25 << "}}";
+                }
+                out << "]}";
+            }
+
+            std::string expected;
+            for (mapnik::value_integer threads : { 1, 4 })
+            {
+                mapnik::parameters params;
+                params["type"] = "geojson";
+                params["file"] = filename;
+                params["parse_threads"] = threads;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                std::string result = describe(ds);
+                if (threads == 1) expected = result;
+                else CHECK(result == expected);
+            }
+            CHECK(expected.size() > 30000);
+            boost::filesystem::remove_all(dir);
+        }
+
+#ifdef MAPNIK_THREADSAFE
+        // parse_threads is ignored otherwise
+        SECTION("errors of a parallel parse name the file")
+        {
+            boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                boost::filesystem::unique_path("mapnik-geojson-%%%%-%%%%");
+            boost::filesystem::create_directories(dir);
+            std::string filename = (dir / "broken.json").string();
+            {
+                std::ofstream out(filename.c_str());
+                out << "{\"type\":\"FeatureCollection\",\"features\":["
+                    << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[1,2]}},"
+                    << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[1,2]},\"bogus\"}]}";
+            }
+            mapnik::parameters params;
+            params["type"] = "geojson";
+            params["file"] = filename;
+            params["parse_threads"] = mapnik::value_integer(2);
+            std::string message;
+            try
+            {
+                mapnik::datasource_cache::instance().create(params);
+            }
+            catch (std::exception const& ex)
+            {
+                message = ex.what();
+            }
+            CHECK(message.find("feature 2") != std::string::npos);
+            CHECK(message.find(filename) != std::string::npos);
+            boost::filesystem::remove_all(dir);
+        }
+#endif
     }
 }
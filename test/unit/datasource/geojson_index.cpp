@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include <mapnik/packed_rtree.hpp>
+#include "../../../plugins/input/geojson/geojson_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// index values are little endian
+void put_uint64(std::string & data, std::size_t pos, std::uint64_t value)
+{
+    for (std::size_t i = 0; i < 8; ++i) data[pos + i] = static_cast<char>((value >> (i * 8)) & 0xff);
+}
+
+}
+
+TEST_CASE("geojson index") {
+
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> pos(-180, 180);
+    std::uniform_real_distribution<double> size(0, 5);
+    std::vector<std::pair<mapnik::box2d<double>, geojson_index::feature_type> > items;
+    mapnik::box2d<double> extent;
+    for (std::uint64_t i = 0; i < 1000; ++i)
+    {
+        double x = pos(gen);
+        double y = pos(gen) / 2;
+        mapnik::box2d<double> box(x, y, x + size(gen), y + size(gen));
+        if (i == 0) extent = box;
+        else extent.expand_to_include(box);
+        items.emplace_back(box, geojson_index::feature_type(i * 100, 100 - i % 7));
+    }
+    std::vector<mapnik::attribute_descriptor> schema;
+    schema.emplace_back("name", mapnik::String);
+    schema.emplace_back("population", mapnik::Integer);
+    std::ostringstream out;
+    geojson_index::write(out, mapnik::packed_rtree<geojson_index::feature_type>(items, 8),
+                         extent, schema, 100000, 67890, 555);
+    std::string data = out.str();
+
+SECTION("index round trips extent, schema and features") {
+    geojson_index index(data.data(), data.size());
+    REQUIRE(index.valid());
+    CHECK(index.size() == items.size());
+    CHECK(index.matches(100000, 67890, 555));
+    CHECK(!index.matches(100000, 67891, 555));
+    CHECK(!index.matches(100000, 67890, 556));
+    CHECK(index.extent() == extent);
+    auto descriptors = index.schema();
+    REQUIRE(descriptors.size() == 2);
+    CHECK(descriptors[0].get_name() == "name");
+    CHECK(descriptors[1].get_type() == mapnik::Integer);
+
+    mapnik::box2d<double> box(-10, -10, 10, 10);
+    std::vector<geojson_index::feature_type> expected;
+    for (auto const& item : items)
+    {
+        if (item.first.intersects(box)) expected.push_back(item.second);
+    }
+    std::vector<geojson_index::feature_type> result;
+    CHECK(index.query(box, [&result](mapnik::box2d<double> const&, std::uint64_t offset, std::uint64_t size)
+                      {
+                          result.emplace_back(offset, size);
+                          return true;
+                      }));
+    std::sort(result.begin(), result.end());
+    CHECK(result == expected);
+
+    // the visitor stops the query
+    std::size_t count = 0;
+    index.query(extent, [&count](mapnik::box2d<double> const&, std::uint64_t, std::uint64_t)
+                {
+                    return ++count < 5;
+                });
+    CHECK(count == 5);
+}
+
+SECTION("truncated or foreign data is rejected") {
+    CHECK(!geojson_index(data.data(), data.size() - 1).valid());
+    CHECK(!geojson_index(data.data(), 16).valid());
+    std::string other(data);
+    other[0] = 'x';
+    CHECK(!geojson_index(other.data(), other.size()).valid());
+    CHECK(!geojson_index().valid());
+}
+
+SECTION("damaged level bounds are rejected") {
+    // 1000 items in nodes of 8 make levels ending at 1000, 1125, 1141, 1143 and 1144
+    std::string other(data);
+    put_uint64(other, mapnik::packed_index_file::header_size + 8, 1124);
+    CHECK(!geojson_index(other.data(), other.size()).valid());
+}
+
+SECTION("items outside of the data file fail the query") {
+    std::size_t items_start = data.size() - 30 - items.size() * 16;
+    for (std::size_t field : { 0, 8 })
+    {
+        std::string other(data);
+        put_uint64(other, items_start + field, 100001);
+        geojson_index index(other.data(), other.size());
+        REQUIRE(index.valid());
+        std::size_t count = 0;
+        CHECK(!index.query(extent, [&count](mapnik::box2d<double> const&, std::uint64_t, std::uint64_t)
+                           {
+                               ++count;
+                               return true;
+                           }));
+        CHECK(count < items.size());
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#include "catch.hpp"
+
+#include "../../../plugins/input/geojson/geojson_scanner.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> scan(std::string const& json, bool & result)
+{
+    std::vector<geojson_scanner::range_type> ranges;
+    result = geojson_scanner::scan_features(json.data(), json.data() + json.size(), ranges);
+    std::vector<std::string> features;
+    for (auto const& range : ranges)
+    {
+        features.push_back(json.substr(range.first, range.second));
+    }
+    return features;
+}
+
+}
+
+TEST_CASE("geojson scanner") {
+
+SECTION("features of a collection are found") {
+    bool result = false;
+    auto features = scan(" { \"type\" : \"FeatureCollection\", \"bbox\":[0, 1, 2, 3],\n"
+                         "\"features\" : [ {\"a\":\"}]\\\"{\"}, {\"b\":[[1,2],{\"c\":null}]} ],"
+                         "\"crs\":{\"properties\":{\"name\":\"x\"}} } ", result);
+    CHECK(result);
+    REQUIRE(features.size() == 2);
+    CHECK(features[0] == "{\"a\":\"}]\\\"{\"}");
+    CHECK(features[1] == "{\"b\":[[1,2],{\"c\":null}]}");
+    features = scan("{\"features\":[],\"type\":\"FeatureCollection\"}", result);
+    CHECK(result);
+    CHECK(features.empty());
+}
+
+SECTION("other documents are left to the grammar") {
+    bool result = true;
+    scan("{\"type\":\"Feature\",\"geometry\":null}", result);
+    CHECK(!result);
+    scan("{\"type\":\"Point\",\"coordinates\":[1,2]}", result);
+    CHECK(!result);
+    scan("{\"features\":[{\"a\":1}", result);
+    CHECK(!result);
+    scan("{\"features\":[{\"a\":\"1}]}", result);
+    CHECK(!result);
+    scan("{\"features\":[1,2]}", result);
+    CHECK(!result);
+    scan("{\"features\":[{}]} trailing", result);
+    CHECK(!result);
+}
+
+SECTION("collections must say so in their type") {
+    bool result = true;
+    scan("{\"features\":[{}]}", result);
+    CHECK(!result);
+    scan("{\"type\":\"Feature\",\"features\":[{}]}", result);
+    CHECK(!result);
+    scan("{\"features\":[{}],\"type\":{\"FeatureCollection\":1}}", result);
+    CHECK(!result);
+    scan("{\"features\":[{}],\"type\":\"FeatureCollection\"}", result);
+    CHECK(result);
+}
+
+}
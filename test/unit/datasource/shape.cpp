@@ -0,0 +1,151 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/packed_rtree.hpp>
+#include <mapnik/util/fs.hpp>
+#include "../../../plugins/input/shape/shp_packed_index.hpp"
+
+#include <boost/filesystem/operations.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+void put_int32(std::ostream & out, std::int32_t value, bool big_endian)
+{
+    char bytes[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes[big_endian ? 3 - i : i] = static_cast<char>((static_cast<std::uint32_t>(value) >> (i * 8)) & 0xff);
+    }
+    out.write(bytes, 4);
+}
+
+void put_double(std::ostream & out, double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_int32(out, static_cast<std::int32_t>(bits & 0xffffffff), false);
+    put_int32(out, static_cast<std::int32_t>(bits >> 32), false);
+}
+
+// count points from (0, 0) to (count - 1, count - 1), each with an "id"
+// attribute one more than its coordinates, and a version 2 index,
+// missing its last bytes if damaged
+void write_points(std::string const& base, int count, bool damaged)
+{
+    int const record_size = 8 + 20;
+    std::ofstream shp((base + ".shp").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    put_int32(shp, 9994, true);
+    for (int i = 0; i < 5; ++i) put_int32(shp, 0, true);
+    put_int32(shp, (100 + count * record_size) / 2, true);
+    put_int32(shp, 1000, false);
+    put_int32(shp, 1, false);
+    for (double v : { 0.0, 0.0, count - 1.0, count - 1.0, 0.0, 0.0, 0.0, 0.0 }) put_double(shp, v);
+    std::vector<std::pair<mapnik::box2d<double>, shp_packed_index::item_type> > items;
+    for (int i = 0; i < count; ++i)
+    {
+        std::uint64_t offset = static_cast<std::uint64_t>(shp.tellp());
+        items.emplace_back(mapnik::box2d<double>(i, i, i, i), shp_packed_index::item_type(offset, i + 1));
+        put_int32(shp, i + 1, true);
+        put_int32(shp, 10, true);
+        put_int32(shp, 1, false);
+        put_double(shp, i);
+        put_double(shp, i);
+    }
+
+    std::ofstream dbf((base + ".dbf").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    dbf.put('\3');
+    dbf.write("\x70\x01\x01", 3);
+    put_int32(dbf, count, false);
+    dbf.put(static_cast<char>(65));
+    dbf.put('\0');
+    dbf.put(static_cast<char>(5));
+    dbf.put('\0');
+    dbf << std::string(20, '\0');
+    dbf.write("id\0\0\0\0\0\0\0\0\0", 11);
+    dbf.put('N');
+    dbf << std::string(4, '\0');
+    dbf.put(static_cast<char>(4));
+    dbf.put('\0');
+    dbf << std::string(14, '\0');
+    dbf.put('\x0d');
+    for (int i = 0; i < count; ++i)
+    {
+        std::ostringstream value;
+        value.width(4);
+        value << i + 1;
+        dbf << ' ' << value.str();
+    }
+    dbf.put('\x1a');
+
+    std::ostringstream index;
+    shp_packed_index::write(index, mapnik::packed_rtree<shp_packed_index::item_type>(items, 4),
+                            100 + count * record_size, 0, 0);
+    std::string data = index.str();
+    std::ofstream out((base + ".index").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size() - (damaged ? 4 : 0)));
+}
+
+// ids and "id" attributes of the features in box
+std::string describe(mapnik::datasource_ptr const& ds, mapnik::box2d<double> const& box)
+{
+    std::ostringstream s;
+    mapnik::query query(box);
+    query.add_property_name("id");
+    auto features = ds->features(query);
+    while (features)
+    {
+        auto feature = features->next();
+        if (!feature) break;
+        s << feature->id() << "=" << feature->get("id") << " ";
+    }
+    return s.str();
+}
+
+// the same features are found with a good and a damaged index
+void check_points(bool damaged)
+{
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("mapnik-shape-%%%%-%%%%");
+    boost::filesystem::create_directories(dir);
+    std::string base = (dir / "points").string();
+    write_points(base, 10, damaged);
+
+    mapnik::parameters params;
+    params["type"] = "shape";
+    params["file"] = base;
+    {
+        auto ds = mapnik::datasource_cache::instance().create(params);
+        REQUIRE(bool(ds));
+        CHECK(ds->envelope() == mapnik::box2d<double>(0, 0, 9, 9));
+        CHECK(describe(ds, mapnik::box2d<double>(2.5, 2.5, 6.5, 6.5)) == "4=4 5=5 6=6 7=7 ");
+        CHECK(describe(ds, ds->envelope()) == "1=1 2=2 3=3 4=4 5=5 6=6 7=7 8=8 9=9 10=10 ");
+    }
+    boost::filesystem::remove_all(dir);
+}
+
+}
+
+TEST_CASE("shape") {
+
+    std::string shape_plugin("./plugins/input/shape.input");
+    if (mapnik::util::exists(shape_plugin))
+    {
+        SECTION("records are found through a packed index")
+        {
+            check_points(false);
+        }
+
+        SECTION("records are scanned when the index is damaged")
+        {
+            check_points(true);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include "catch.hpp"
+
+#include <mapnik/geom_util.hpp>
+#include <mapnik/packed_rtree.hpp>
+#include "../../../plugins/input/shape/shp_packed_index.hpp"
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("shape packed index") {
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> pos(-180, 180);
+    std::uniform_real_distribution<double> size(0, 5);
+    std::vector<std::pair<mapnik::box2d<double>, shp_packed_index::item_type> > items;
+    for (std::uint64_t i = 0; i < 2000; ++i)
+    {
+        double x = pos(gen);
+        double y = pos(gen) / 2;
+        items.emplace_back(mapnik::box2d<double>(x, y, x + size(gen), y + size(gen)),
+                           shp_packed_index::item_type(100 + i * 56, i + 1));
+    }
+    std::uint64_t file_size = 100 + items.size() * 56;
+    std::ostringstream out;
+    shp_packed_index::write(out, mapnik::packed_rtree<shp_packed_index::item_type>(items, 8), file_size, 1234, 5678);
+    std::string data = out.str();
+
+SECTION("queries return matching offsets in file order") {
+    shp_packed_index index(data.data(), data.size());
+    REQUIRE(index.valid());
+    REQUIRE(index.size() == items.size());
+    CHECK(index.matches(file_size, 1234, 5678));
+    std::istringstream in(data);
+    shp_packed_index streamed(in);
+    REQUIRE(streamed.valid());
+    for (auto const& box : { mapnik::box2d<double>(-10, -10, 10, 10),
+                             mapnik::box2d<double>(-180, -90, 180, 90),
+                             mapnik::box2d<double>(500, 500, 600, 600) })
+    {
+        mapnik::filter_in_box filter(box);
+        std::vector<std::streampos> expected;
+        for (auto const& item : items)
+        {
+            if (filter.pass(item.first)) expected.push_back(static_cast<std::streamoff>(item.second.first));
+        }
+        std::vector<std::streampos> result;
+        REQUIRE(index.query(filter, result));
+        REQUIRE(result == expected);
+        result.clear();
+        REQUIRE(streamed.query(filter, result));
+        REQUIRE(result == expected);
+    }
+}
+
+SECTION("single item") {
+    std::ostringstream single;
+    std::vector<std::pair<mapnik::box2d<double>, shp_packed_index::item_type> > one = { items.front() };
+    shp_packed_index::write(single, mapnik::packed_rtree<shp_packed_index::item_type>(one, 8), file_size, 0, 0);
+    std::string bytes = single.str();
+    shp_packed_index index(bytes.data(), bytes.size());
+    REQUIRE(index.valid());
+    std::vector<std::streampos> result;
+    REQUIRE(index.query(mapnik::filter_in_box(items.front().first), result));
+    REQUIRE(result.size() == 1);
+    CHECK(result.front() == std::streampos(100));
+}
+
+SECTION("values are little endian") {
+    // node_size right after magic and version
+    CHECK(data[12] == 3);
+    CHECK(data[16] == 8);
+    CHECK(data[17] == 0);
+    CHECK(data[19] == 0);
+}
+
+SECTION("other files are rejected") {
+    std::string v1("mapnik\0\0\0\0\0\0\0\0\0\0", 16);
+    CHECK(!shp_packed_index::is_packed(v1.data(), v1.size()));
+    CHECK(!shp_packed_index(v1.data(), v1.size()).valid());
+    CHECK(shp_packed_index::is_packed(data.data(), data.size() - 4));
+    CHECK(!shp_packed_index(data.data(), data.size() - 4).valid());
+
+    std::istringstream in(v1);
+    CHECK(!shp_packed_index::is_packed(in));
+    CHECK(in.tellg() == 0);
+    std::istringstream in2(data);
+    CHECK(shp_packed_index::is_packed(in2));
+    CHECK(in2.tellg() == 0);
+    std::istringstream truncated(data.substr(0, data.size() - 4));
+    CHECK(!shp_packed_index(truncated).valid());
+
+    // packed, but written by another version
+    std::string other_version(data);
+    other_version[12] = 2;
+    CHECK(shp_packed_index::is_packed(other_version.data(), other_version.size()));
+    CHECK(!shp_packed_index(other_version.data(), other_version.size()).valid());
+}
+
+SECTION("corrupt indexes are rejected") {
+    // every level bound is checked, not only the last one
+    std::string bad_bound(data);
+    std::size_t bounds = mapnik::packed_index_file::header_size;
+    bad_bound[bounds] = static_cast<char>(bad_bound[bounds] + 1);
+    CHECK(!shp_packed_index(bad_bound.data(), bad_bound.size()).valid());
+
+    // records past the end of the shp file fail the query
+    std::string bad_offset(data);
+    std::size_t last_item = bad_offset.size() - 16;
+    bad_offset[last_item + 7] = static_cast<char>(0x7f);
+    shp_packed_index index(bad_offset.data(), bad_offset.size());
+    REQUIRE(index.valid());
+    std::vector<std::streampos> result;
+    CHECK(!index.query(mapnik::filter_in_box(mapnik::box2d<double>(-180, -90, 180, 90)), result));
+    CHECK(result.empty());
+}
+
+}
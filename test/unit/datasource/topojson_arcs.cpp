@@ -0,0 +1,68 @@
+#include "catch.hpp"
+
+#include <mapnik/util/variant.hpp>
+#include "../../../plugins/input/topojson/topojson_arcs.hpp"
+
+#include <vector>
+
+namespace {
+
+mapnik::topojson::arc make_arc(std::vector<mapnik::topojson::coordinate> const& coords)
+{
+    mapnik::topojson::arc arc;
+    arc.coordinates.assign(coords.begin(), coords.end());
+    return arc;
+}
+
+}
+
+TEST_CASE("topojson arcs") {
+
+SECTION("quantized arcs are decoded once with their boxes") {
+    mapnik::topojson::topology topo;
+    topo.tr = mapnik::topojson::transform{2.0, 0.5, 10.0, -10.0};
+    topo.arcs.push_back(make_arc({{1, 2}, {3, 4}, {-2, 0}}));
+    topo.arcs.push_back(make_arc({{0, 0}, {5, -4}}));
+    topojson_arcs arcs(topo);
+    REQUIRE(arcs.size() == 2);
+    REQUIRE(arcs.num_coords(0) == 3);
+    auto itr = arcs.begin(0);
+    CHECK(itr[0].x == 12.0);
+    CHECK(itr[0].y == -9.0);
+    CHECK(itr[1].x == 18.0);
+    CHECK(itr[1].y == -7.0);
+    CHECK(itr[2].x == 14.0);
+    CHECK(itr[2].y == -7.0);
+    CHECK(arcs.box(0) == mapnik::box2d<double>(12, -9, 18, -7));
+    CHECK(arcs.box(1) == mapnik::box2d<double>(10, -12, 20, -10));
+    CHECK(arcs.end(0) == arcs.begin(1));
+    // negative indices refer to reversed arcs
+    CHECK(arcs.arc_index(-1) == 0);
+    CHECK(arcs.arc_index(~1) == 1);
+    CHECK(arcs.valid(-2));
+    CHECK(!arcs.valid(2));
+    CHECK(!arcs.valid(-3));
+}
+
+SECTION("geometry boxes are the union of their arc boxes") {
+    mapnik::topojson::topology topo;
+    topo.arcs.push_back(make_arc({{0, 0}, {1, 1}}));
+    topo.arcs.push_back(make_arc({{5, 5}, {6, 4}}));
+    topojson_arcs arcs(topo);
+    topojson_bounding_box_visitor visitor(topo, arcs);
+
+    mapnik::topojson::multi_linestring multi_line;
+    multi_line.rings = {0, ~1, 7};
+    mapnik::topojson::geometry geom(multi_line);
+    CHECK(mapnik::util::apply_visitor(visitor, geom) == mapnik::box2d<double>(0, 0, 6, 5));
+
+    mapnik::topojson::linestring line;
+    line.ring = 7;
+    CHECK(!visitor(line).valid());
+
+    mapnik::topojson::multi_point multi_pt;
+    multi_pt.points = {{3, 3}, {-1, 2}};
+    CHECK(visitor(multi_pt) == mapnik::box2d<double>(-1, 2, 3, 3));
+}
+
+}
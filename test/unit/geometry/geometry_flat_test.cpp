@@ -0,0 +1,262 @@
+#include "catch.hpp"
+#include "geometry_equal.hpp"
+
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry_flat.hpp>
+#include <mapnik/geometry_envelope.hpp>
+#include <mapnik/vertex_processor.hpp>
+#include <mapnik/wkb.hpp>
+#include <mapnik/json/geometry_parser.hpp>
+#include <mapnik/json/flat_geometry_parser.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using vertices = std::vector<std::tuple<unsigned, double, double> >;
+
+struct collect_vertices
+{
+    collect_vertices(vertices & out)
+        : out_(out) {}
+
+    template <typename Adapter>
+    void operator() (Adapter & va)
+    {
+        va.rewind(0);
+        double x, y;
+        unsigned cmd;
+        while ((cmd = va.vertex(&x, &y)) != mapnik::SEG_END)
+        {
+            out_.emplace_back(cmd, x, y);
+        }
+        out_.emplace_back(mapnik::SEG_END, 0, 0);
+    }
+
+    vertices & out_;
+};
+
+template <typename Geometry>
+vertices get_vertices(Geometry const& geom)
+{
+    vertices out;
+    collect_vertices collect(out);
+    mapnik::geometry::vertex_processor<collect_vertices> processor(collect);
+    processor(geom);
+    return out;
+}
+
+mapnik::geometry::polygon<double> make_polygon(double x, double y)
+{
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> exterior;
+    exterior.add_coord(x, y);
+    exterior.add_coord(x + 10, y);
+    exterior.add_coord(x + 10, y + 10);
+    exterior.add_coord(x, y + 10);
+    exterior.add_coord(x, y);
+    poly.set_exterior_ring(std::move(exterior));
+    mapnik::geometry::linear_ring<double> hole;
+    hole.add_coord(x + 2, y + 2);
+    hole.add_coord(x + 2, y + 4);
+    hole.add_coord(x + 4, y + 4);
+    hole.add_coord(x + 2, y + 2);
+    poly.add_hole(std::move(hole));
+    return poly;
+}
+
+// big endian wkb, unless switched to little endian
+struct wkb_buffer
+{
+    void add_byte(std::uint8_t b) { data.push_back(static_cast<char>(b)); }
+    void add_bytes(std::uint64_t n, int size)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            int shift = little_endian ? i * 8 : (size - 1 - i) * 8;
+            add_byte(static_cast<std::uint8_t>(n >> shift));
+        }
+    }
+    void add_integer(std::uint32_t n) { add_bytes(n, 4); }
+    void add_double(double d)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        add_bytes(bits, 8);
+    }
+    void add_header(std::uint32_t type)
+    {
+        add_byte(little_endian ? 1 : 0);
+        add_integer(type);
+    }
+    std::string data;
+    bool little_endian = false;
+};
+
+}
+
+TEST_CASE("flat geometry") {
+
+SECTION("round trip through nested geometries") {
+    using namespace mapnik::geometry;
+    std::vector<geometry<double> > geoms;
+    geoms.emplace_back(point<double>(1, 2));
+    line_string<double> line;
+    line.add_coord(0, 0);
+    line.add_coord(1, 1);
+    line.add_coord(2, 0);
+    geoms.emplace_back(line);
+    geoms.emplace_back(make_polygon(0, 0));
+    multi_point<double> multi_pt;
+    multi_pt.add_coord(1, 1);
+    multi_pt.add_coord(2, 2);
+    geoms.emplace_back(multi_pt);
+    multi_line_string<double> multi_line;
+    multi_line.push_back(line);
+    multi_line.push_back(line);
+    geoms.emplace_back(multi_line);
+    multi_polygon<double> multi_poly;
+    multi_poly.push_back(make_polygon(0, 0));
+    multi_poly.push_back(make_polygon(20, 20));
+    geoms.emplace_back(multi_poly);
+
+    for (auto const& geom : geoms)
+    {
+        flat_geometry<double> flat;
+        REQUIRE(to_flat(geom, flat));
+        assert_g_equal(from_flat(flat), geom);
+        CHECK(get_vertices(flat) == get_vertices(geom));
+        CHECK(envelope(flat) == envelope(geom));
+    }
+
+    flat_geometry<double> flat;
+    REQUIRE(!to_flat(geometry<double>(geometry_collection<double>()), flat));
+    REQUIRE(from_flat(flat_geometry<double>()).is<geometry_empty>());
+}
+
+SECTION("parts, rings and points") {
+    using namespace mapnik::geometry;
+    multi_polygon<double> multi_poly;
+    multi_poly.push_back(make_polygon(0, 0));
+    multi_poly.push_back(make_polygon(20, 20));
+    flat_geometry<double> flat;
+    REQUIRE(to_flat(geometry<double>(multi_poly), flat));
+    REQUIRE(flat.type() == geometry_types::MultiPolygon);
+    REQUIRE(flat.part_type() == geometry_types::Polygon);
+    REQUIRE(flat.num_parts() == 2);
+    REQUIRE(flat.num_rings() == 4);
+    REQUIRE(flat.num_points() == 18);
+    REQUIRE(flat.part_begin(1) == 2);
+    REQUIRE(flat.part_end(1) == 4);
+    REQUIRE(flat.ring_begin(3) == 14);
+    REQUIRE(flat.ring_end(3) == 18);
+    REQUIRE(flat[14].x == 22);
+}
+
+SECTION("wkb") {
+    using namespace mapnik::geometry;
+    wkb_buffer wkb;
+    // multipolygon with an open, clockwise exterior ring
+    wkb.add_header(6);
+    wkb.add_integer(1);
+    wkb.add_header(3);
+    wkb.add_integer(1);
+    wkb.add_integer(4);
+    wkb.add_double(0); wkb.add_double(0);
+    wkb.add_double(0); wkb.add_double(10);
+    wkb.add_double(10); wkb.add_double(10);
+    wkb.add_double(10); wkb.add_double(0);
+
+    flat_geometry<double> flat;
+    REQUIRE(mapnik::geometry_utils::from_wkb(wkb.data.data(), wkb.data.size(), flat));
+    REQUIRE(flat.type() == geometry_types::MultiPolygon);
+    REQUIRE(flat.num_points() == 5);
+    REQUIRE(flat[1] == point<double>(10, 0));
+    geometry<double> nested = mapnik::geometry_utils::from_wkb(wkb.data.data(), wkb.data.size());
+    assert_g_equal(from_flat(flat), nested);
+
+    // truncated
+    REQUIRE(!mapnik::geometry_utils::from_wkb(wkb.data.data(), wkb.data.size() - 8, flat));
+
+    wkb_buffer wkb_z;
+    wkb_z.add_header(1002);
+    wkb_z.add_integer(2);
+    wkb_z.add_double(1); wkb_z.add_double(2); wkb_z.add_double(100);
+    wkb_z.add_double(3); wkb_z.add_double(4); wkb_z.add_double(100);
+    flat_geometry<double> line;
+    REQUIRE(mapnik::geometry_utils::from_wkb(wkb_z.data.data(), wkb_z.data.size(), line));
+    REQUIRE(line.type() == geometry_types::LineString);
+    REQUIRE(line.num_points() == 2);
+    REQUIRE(line[1] == point<double>(3, 4));
+
+    // parts may use another byte order than their parent
+    wkb_buffer mixed;
+    mixed.add_header(5);
+    mixed.add_integer(2);
+    for (int i = 0; i < 2; ++i)
+    {
+        mixed.little_endian = (i == 1);
+        mixed.add_header(2);
+        mixed.add_integer(2);
+        mixed.add_double(i); mixed.add_double(0);
+        mixed.add_double(i); mixed.add_double(1);
+    }
+    flat_geometry<double> lines;
+    REQUIRE(mapnik::geometry_utils::from_wkb(mixed.data.data(), mixed.data.size(), lines));
+    REQUIRE(lines.num_parts() == 2);
+    REQUIRE(lines[3] == point<double>(1, 1));
+    assert_g_equal(from_flat(lines), mapnik::geometry_utils::from_wkb(mixed.data.data(), mixed.data.size()));
+
+    // part type must match the multi geometry, part headers must fit
+    wkb_buffer bad_part;
+    bad_part.add_header(4);
+    bad_part.add_integer(1);
+    bad_part.add_header(2);
+    bad_part.add_integer(0);
+    flat_geometry<double> points;
+    REQUIRE(!mapnik::geometry_utils::from_wkb(bad_part.data.data(), bad_part.data.size(), points));
+    wkb_buffer short_header;
+    short_header.add_header(4);
+    short_header.add_integer(1);
+    short_header.add_byte(0);
+    REQUIRE(!mapnik::geometry_utils::from_wkb(short_header.data.data(), short_header.data.size(), points));
+}
+
+SECTION("geojson") {
+    using namespace mapnik::geometry;
+    std::vector<std::string> jsons = {
+        "{\"type\":\"Point\",\"coordinates\":[30,10]}",
+        "{\"coordinates\":[30.5,-10e2],\"type\":\"Point\"}",
+        "{\"type\":\"LineString\",\"coordinates\":[[30,10],[10,30],[40,40]]}",
+        "{ \"type\" : \"Polygon\" , \"coordinates\" : [ [ [0,0], [0,10], [10,10], [10,0], [0,0] ] ] }",
+        "{\"type\":\"Polygon\",\"coordinates\":[[[35,10],[45,45],[15,40],[10,20],[35,10]],[[20,30],[35,35],[30,20],[20,30]]]}",
+        "{\"type\":\"MultiPoint\",\"coordinates\":[[10,40],[40,30,5],[20,20],[30,10]]}",
+        "{\"type\":\"MultiLineString\",\"coordinates\":[[[10,10],[20,20],[10,40]],[[40,40],[30,30],[40,20],[30,10]]]}",
+        "{\"type\":\"MultiPolygon\",\"coordinates\":[[[[30,20],[45,40],[10,40],[30,20]]],[[[15,5],[40,10],[10,20],[5,10],[15,5]]]]}"
+    };
+    for (auto const& json : jsons)
+    {
+        INFO(json);
+        flat_geometry<double> flat;
+        REQUIRE(mapnik::json::from_geojson(json, flat));
+        geometry<double> nested;
+        REQUIRE(mapnik::json::from_geojson(json, nested));
+        assert_g_equal(from_flat(flat), nested);
+    }
+
+    // other members are skipped
+    flat_geometry<double> flat;
+    REQUIRE(mapnik::json::from_geojson(std::string("{\"bbox\":[0,0,1,1],\"type\":\"LineString\",\"crs\":{\"a\":\"]}\"},\"coordinates\":[[0,0],[1,1]],\"b\":null}"), flat));
+    REQUIRE(flat.num_points() == 2);
+
+    CHECK(!mapnik::json::from_geojson(std::string("{\"type\":\"Point\"}"), flat));
+    CHECK(!mapnik::json::from_geojson(std::string("{\"type\":\"Point\",\"coordinates\":[30]}"), flat));
+    CHECK(!mapnik::json::from_geojson(std::string("{\"type\":\"LineString\",\"coordinates\":[[30,10],[10,30]"), flat));
+    CHECK(!mapnik::json::from_geojson(std::string("{\"type\":\"GeometryCollection\",\"geometries\":[]}"), flat));
+}
+
+}
@@ -0,0 +1,92 @@
+#include "catch.hpp"
+
+#include <mapnik/geometry.hpp>
+#include <mapnik/wkb.hpp>
+
+#include <string>
+
+namespace {
+
+mapnik::geometry::geometry<double> decode(std::string const& twkb)
+{
+    return mapnik::geometry_utils::from_twkb(twkb.data(), twkb.size());
+}
+
+}
+
+TEST_CASE("twkb") {
+
+SECTION("points with precision, varints and header metadata") {
+    auto geom = decode(std::string("\x01\x00\x02\x04", 4));
+    REQUIRE(geom.is<mapnik::geometry::point<double> >());
+    auto const& pt = geom.get<mapnik::geometry::point<double> >();
+    CHECK(pt.x == 1);
+    CHECK(pt.y == 2);
+
+    // precision 1
+    auto pt1 = decode(std::string("\x21\x00\x1e\x31", 4)).get<mapnik::geometry::point<double> >();
+    CHECK(pt1.x == Approx(1.5));
+    CHECK(pt1.y == Approx(-2.5));
+
+    // multi byte varint
+    auto pt2 = decode(std::string("\x01\x00\xc8\x01\x00", 5)).get<mapnik::geometry::point<double> >();
+    CHECK(pt2.x == 100);
+    CHECK(pt2.y == 0);
+
+    // size and bounding box are skipped
+    auto pt3 = decode(std::string("\x01\x03\x06\x02\x00\x04\x00\x02\x04", 9)).get<mapnik::geometry::point<double> >();
+    CHECK(pt3.x == 1);
+    CHECK(pt3.y == 2);
+
+    CHECK(decode(std::string("\x01\x10", 2)).is<mapnik::geometry::geometry_empty>());
+}
+
+SECTION("coordinates are deltas from the previous one") {
+    auto geom = decode(std::string("\x02\x00\x02\x02\x02\x08\x08", 7));
+    REQUIRE(geom.is<mapnik::geometry::line_string<double> >());
+    auto const& line = geom.get<mapnik::geometry::line_string<double> >();
+    REQUIRE(line.size() == 2);
+    CHECK(line[1].x == 5);
+    CHECK(line[1].y == 5);
+
+    auto poly_geom = decode(std::string("\x03\x00\x02"
+                                        "\x05\x00\x00\x14\x00\x00\x14\x13\x00\x00\x13"
+                                        "\x05\x04\x04\x00\x04\x04\x00\x00\x03\x03\x00", 25));
+    REQUIRE(poly_geom.is<mapnik::geometry::polygon<double> >());
+    auto const& poly = poly_geom.get<mapnik::geometry::polygon<double> >();
+    CHECK(poly.exterior_ring.size() == 5);
+    REQUIRE(poly.interior_rings.size() == 1);
+    CHECK(poly.interior_rings[0].size() == 5);
+    for (auto const& pt : poly.interior_rings[0])
+    {
+        CHECK(pt.x >= 2);
+        CHECK(pt.y <= 4);
+    }
+}
+
+SECTION("multi geometries and collections") {
+    // id list is skipped
+    auto geom = decode(std::string("\x04\x04\x02\x02\x04\x02\x04\x04\x02", 9));
+    REQUIRE(geom.is<mapnik::geometry::multi_point<double> >());
+    auto const& multi_point = geom.get<mapnik::geometry::multi_point<double> >();
+    REQUIRE(multi_point.size() == 2);
+    CHECK(multi_point[1].x == 3);
+    CHECK(multi_point[1].y == 3);
+
+    auto collection_geom = decode(std::string("\x07\x00\x02\x01\x00\x02\x04\x02\x00\x02\x02\x02\x08\x08", 14));
+    using collection_type = mapnik::util::recursive_wrapper<mapnik::geometry::geometry_collection<double> >;
+    REQUIRE(collection_geom.is<collection_type>());
+    mapnik::geometry::geometry_collection<double> const& collection = collection_geom.get<collection_type>();
+    REQUIRE(collection.size() == 2);
+    CHECK(collection[0].is<mapnik::geometry::point<double> >());
+    CHECK(collection[1].is<mapnik::geometry::line_string<double> >());
+}
+
+SECTION("malformed input yields an empty geometry") {
+    CHECK(decode(std::string("\x02\x00\x02\x02\x02\x08", 6)).is<mapnik::geometry::geometry_empty>());
+    CHECK(decode(std::string("\x02\x00\xff\xff\xff\x0f", 6)).is<mapnik::geometry::geometry_empty>());
+    CHECK(decode(std::string("\x0e\x00\x00", 3)).is<mapnik::geometry::geometry_empty>());
+    CHECK(decode(std::string()).is<mapnik::geometry::geometry_empty>());
+}
+
+}
@@ -0,0 +1,76 @@
+#include "catch.hpp"
+
+#include <mapnik/metatile.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/color.hpp>
+
+TEST_CASE("metatile") {
+
+SECTION("render and slice") {
+#if defined(HAVE_PNG)
+    mapnik::Map m(256, 256);
+    mapnik::feature_type_style style;
+    mapnik::rule r;
+    mapnik::polygon_symbolizer sym;
+    mapnik::put(sym, mapnik::keys::fill, mapnik::color(0, 128, 0));
+    r.append(std::move(sym));
+    style.add_rule(std::move(r));
+    m.insert_style("style", std::move(style));
+
+    // covers the upper left quarter of the metatile only
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::linear_ring<double> ring;
+    ring.add_coord(-10, 110);
+    ring.add_coord(50, 110);
+    ring.add_coord(50, 50);
+    ring.add_coord(-10, 50);
+    ring.add_coord(-10, 110);
+    mapnik::geometry::polygon<double> poly;
+    poly.set_exterior_ring(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    ds->push(feature);
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("style");
+    m.add_layer(lyr);
+
+    mapnik::box2d<double> extent(0, 0, 100, 100);
+    mapnik::metatile_tiles tiles = mapnik::render_metatile(m, extent, 2, 64, "png32");
+    REQUIRE(tiles.size() == 4);
+    // map is not resized
+    REQUIRE(m.width() == 256);
+
+    REQUIRE(tiles[0].x == 0);
+    REQUIRE(tiles[0].y == 0);
+    CHECK(tiles[0].solid);
+    CHECK(!tiles[0].empty);
+    for (std::size_t i = 1; i < tiles.size(); ++i)
+    {
+        CHECK(tiles[i].solid);
+        CHECK(tiles[i].empty);
+    }
+    for (auto const& tile : tiles)
+    {
+        REQUIRE(tile.data.size() > 8);
+        CHECK(tile.data.substr(1, 3) == "PNG");
+    }
+
+    mapnik::image_rgba8 small(100, 100);
+    REQUIRE_THROWS(mapnik::slice_metatile(small, 2, 64, "png32"));
+    REQUIRE_THROWS(mapnik::slice_metatile(small, 0, 64, "png32"));
+#endif
+}
+
+}
@@ -25,9 +25,11 @@
 #include <vector>
 #include <string>
 #include <mapnik/util/fs.hpp>
+#include <mapnik/packed_rtree.hpp>
 #include "quadtree.hpp"
 #include "shapefile.hpp"
 #include "shape_io.hpp"
+#include "shp_packed_index.hpp"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -38,6 +40,7 @@
 
 const int DEFAULT_DEPTH = 8;
 const double DEFAULT_RATIO=0.55;
+const unsigned int DEFAULT_NODE_SIZE = 16;
 
 int main (int argc,char** argv)
 {
@@ -51,6 +54,8 @@ int main (int argc,char** argv)
     bool verbose=false;
     unsigned int depth=DEFAULT_DEPTH;
     double ratio=DEFAULT_RATIO;
+    bool rtree=false;
+    unsigned int node_size=DEFAULT_NODE_SIZE;
     vector<string> shape_files;
 
     try
@@ -62,6 +67,8 @@ int main (int argc,char** argv)
             ("verbose,v","verbose output")
             ("depth,d", po::value<unsigned int>(), "max tree depth\n(default 8)")
             ("ratio,r",po::value<double>(),"split ratio (default 0.55)")
+            ("rtree","write a packed r-tree index (version 2, needs a mapnik that reads it)")
+            ("node-size,n",po::value<unsigned int>(),"r-tree node size (default 16)")
             ("shape_files",po::value<vector<string> >(),"shape files to index: file1 file2 ...fileN")
             ;
 
@@ -94,6 +101,14 @@ int main (int argc,char** argv)
         {
             ratio = vm["ratio"].as<double>();
         }
+        if (vm.count("rtree"))
+        {
+            rtree = true;
+        }
+        if (vm.count("node-size"))
+        {
+            node_size = vm["node-size"].as<unsigned int>();
+        }
 
         if (vm.count("shape_files"))
         {
@@ -106,8 +121,15 @@ int main (int argc,char** argv)
         return -1;
     }
 
-    clog << "max tree depth:" << depth << endl;
-    clog << "split ratio:" << ratio << endl;
+    if (rtree)
+    {
+        clog << "r-tree node size:" << node_size << endl;
+    }
+    else
+    {
+        clog << "max tree depth:" << depth << endl;
+        clog << "split ratio:" << ratio << endl;
+    }
 
     //vector<string>::const_iterator itr = shape_files.begin();
     if (shape_files.size() == 0)
@@ -154,6 +176,7 @@ int main (int argc,char** argv)
         int pos=50;
         shp.seek(pos*2);
         quadtree<int> tree(extent,depth,ratio);
+        std::vector<std::pair<box2d<double>, shp_packed_index::item_type> > items;
         int count=0;
         while (true) {
 
@@ -219,7 +242,14 @@ int main (int argc,char** argv)
                 shp.read_envelope(item_ext);
                 shp.skip(2*content_length-4*8-4);
             }
-            tree.insert(offset,item_ext);
+            if (rtree)
+            {
+                items.emplace_back(item_ext, shp_packed_index::item_type(offset, record_number));
+            }
+            else
+            {
+                tree.insert(offset,item_ext);
+            }
             if (verbose)
             {
                 clog << "record number " << record_number << " box=" << item_ext << endl;
@@ -238,6 +268,16 @@ int main (int argc,char** argv)
         if (!file) {
             clog << "cannot open index file for writing file \""
                  << (shapename+".index") << "\"" << endl;
+        } else if (rtree) {
+            mapnik::packed_rtree<shp_packed_index::item_type> packed(std::move(items), node_size);
+            std::clog<<" number nodes="<<packed.boxes().size()<<std::endl;
+            file.exceptions(std::ios::failbit | std::ios::badbit);
+            shp_packed_index::write(file, packed,
+                                    mapnik::util::file_size(shapename_full),
+                                    mapnik::util::last_write_time(shapename_full),
+                                    mapnik::util::file_fingerprint(shapename_full));
+            file.flush();
+            file.close();
         } else {
             tree.trim();
             std::clog<<" number nodes="<<tree.count()<<std::endl;